@@ -0,0 +1,237 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * bufferPool.cpp - Implementación de los pools de buffers
+ */
+
+#include "bufferPool.h"
+
+BufferPool::Pool BufferPool::pools[POOL_COUNT];
+bool BufferPool::psram = false;
+
+static portMUX_TYPE poolLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Bloques como máximo y bloques libres conservados: [0] con PSRAM,
+// [1] sin PSRAM (la RAM interna no puede quedarse con 64 KB parados)
+struct PoolLayout {
+    const char* name;
+    size_t blockSize;
+    bool dma;
+    uint8_t capacity[2];
+    uint8_t keep[2];
+};
+
+static const PoolLayout layout[POOL_COUNT] = {
+    { "io-4k",   4096,  false, {8, 2}, {8, 1} },
+    { "io-8k",   8192,  false, {4, 1}, {4, 0} },
+    { "io-16k",  16384, false, {4, 1}, {4, 0} },
+    { "io-64k",  65536, false, {2, 0}, {2, 0} },
+    { "dma-4k",  4096,  true,  {2, 2}, {1, 1} },
+    { "dma-16k", 16384, true,  {1, 1}, {0, 0} },
+    { "spill",   0,     false, {POOL_MAX_BLOCKS, POOL_MAX_BLOCKS}, {0, 0} }
+};
+
+static const uint32_t DMA_CAPS = MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+
+void BufferPool::begin() {
+    psram = psramFound();
+    int mode = psram ? 0 : 1;
+    uint32_t ioCaps = psram ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+                            : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+    for(int i = 0; i < POOL_COUNT; i++) {
+        Pool* pool = &pools[i];
+        pool->name = layout[i].name;
+        pool->blockSize = layout[i].blockSize;
+        pool->dma = layout[i].dma;
+        pool->caps = pool->dma ? DMA_CAPS : ioCaps;
+        pool->capacity = layout[i].capacity[mode];
+        pool->keep = layout[i].keep[mode];
+    }
+}
+
+bool BufferPool::usable(int index, uint8_t flags) {
+    const Pool* pool = &pools[index];
+    if(pool->capacity == 0) return false;
+    if(pool->dma) return flags & POOL_DMA;
+    if(flags & POOL_DMA) return false;
+    return !(flags & POOL_PSRAM) || psram;
+}
+
+void* BufferPool::take(int index, size_t size, uint32_t caps, size_t* got) {
+    Pool* pool = &pools[index];
+    size_t blockSize = pool->blockSize ? pool->blockSize : size;
+    int cached = -1;
+    int empty = -1;
+
+    portENTER_CRITICAL(&poolLock);
+    for(int i = 0; i < pool->capacity; i++) {
+        Slot* slot = &pool->slots[i];
+        if(slot->used) continue;
+        if(slot->data) {
+            cached = i;
+            break;
+        }
+        if(empty < 0) empty = i;
+    }
+    int chosen = cached >= 0 ? cached : empty;
+    if(chosen >= 0) {
+        pool->slots[chosen].used = true;
+        if(cached >= 0) pool->hits++;
+        uint8_t inUse = 0;
+        for(int i = 0; i < pool->capacity; i++) {
+            if(pool->slots[i].used) inUse++;
+        }
+        if(inUse > pool->peakInUse) pool->peakInUse = inUse;
+    } else {
+        pool->failures++;
+    }
+    portEXIT_CRITICAL(&poolLock);
+
+    if(chosen < 0) {
+        return nullptr;
+    }
+
+    Slot* slot = &pool->slots[chosen];
+    if(cached < 0) {
+        // Reservar fuera de la sección crítica; el hueco ya está marcado
+        uint8_t* data = (uint8_t*)heap_caps_malloc(blockSize, caps);
+        portENTER_CRITICAL(&poolLock);
+        if(data) {
+            slot->data = data;
+            slot->size = blockSize;
+            pool->misses++;
+        } else {
+            slot->used = false;
+            pool->failures++;
+        }
+        portEXIT_CRITICAL(&poolLock);
+        if(!data) return nullptr;
+    }
+
+    if(got) *got = slot->size;
+    return slot->data;
+}
+
+void* BufferPool::acquire(size_t wanted, size_t minimum, uint8_t flags, size_t* got) {
+    if(minimum > wanted) wanted = minimum;
+
+    // Pools candidatos, de menor a mayor (el orden de PoolId)
+    int candidates[POOL_SPILL];
+    int count = 0;
+    for(int i = 0; i < POOL_SPILL; i++) {
+        if(usable(i, flags)) candidates[count++] = i;
+    }
+
+    // El justo es el menor en el que cabe 'wanted' (o el mayor)
+    int fit = count - 1;
+    for(int k = 0; k < count; k++) {
+        if(pools[candidates[k]].blockSize >= wanted) {
+            fit = k;
+            break;
+        }
+    }
+
+    for(int k = fit; k >= 0 && k < count; k++) {
+        int index = candidates[k];
+        // Si ninguno llega a 'wanted', 'fit' es el mayor y puede no llegar
+        // ni a 'minimum': entonces solo queda la reserva suelta
+        if(pools[index].blockSize < minimum) continue;
+        void* buffer = take(index, 0, pools[index].caps, got);
+        if(buffer) return buffer;
+    }
+    for(int k = fit - 1; k >= 0; k--) {
+        int index = candidates[k];
+        if(pools[index].blockSize < minimum) break;
+        void* buffer = take(index, 0, pools[index].caps, got);
+        if(buffer) return buffer;
+    }
+
+    // Sin bloques libres: reserva suelta, que se libera al devolverla
+    if((flags & POOL_PSRAM) && !psram) {
+        return nullptr;
+    }
+    uint32_t caps = (flags & POOL_DMA) ? DMA_CAPS
+                  : psram ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+                          : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    void* buffer = take(POOL_SPILL, wanted, caps, got);
+    if(!buffer && minimum < wanted) {
+        buffer = take(POOL_SPILL, minimum, caps, got);
+    }
+    return buffer;
+}
+
+bool BufferPool::release(void* buffer) {
+    if(!buffer) return false;
+    void* toFree = nullptr;
+    bool found = false;
+
+    portENTER_CRITICAL(&poolLock);
+    for(int p = 0; p < POOL_COUNT && !found; p++) {
+        Pool* pool = &pools[p];
+        for(int i = 0; i < pool->capacity; i++) {
+            Slot* slot = &pool->slots[i];
+            if(slot->data != buffer || !slot->used) continue;
+
+            found = true;
+            slot->used = false;
+            uint8_t idle = 0;
+            for(int k = 0; k < pool->capacity; k++) {
+                if(pool->slots[k].data && !pool->slots[k].used) idle++;
+            }
+            if(idle > pool->keep) {
+                toFree = slot->data;
+                slot->data = nullptr;
+                slot->size = 0;
+            }
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&poolLock);
+
+    if(toFree) {
+        heap_caps_free(toFree);
+    }
+    return found;
+}
+
+bool BufferPool::owns(const void* buffer) {
+    bool found = false;
+    portENTER_CRITICAL(&poolLock);
+    for(int p = 0; p < POOL_COUNT && !found; p++) {
+        for(int i = 0; i < pools[p].capacity; i++) {
+            if(pools[p].slots[i].data == buffer && pools[p].slots[i].used) {
+                found = true;
+                break;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&poolLock);
+    return found;
+}
+
+bool BufferPool::getStats(int index, PoolStats* out) {
+    if(index < 0 || index >= POOL_COUNT) return false;
+    const Pool* pool = &pools[index];
+
+    out->name = pool->name;
+    if(index == POOL_SPILL) out->memory = "heap";
+    else if(pool->dma) out->memory = "DMA";
+    else out->memory = (pool->caps & MALLOC_CAP_SPIRAM) ? "PSRAM" : "DRAM";
+    out->blockSize = pool->blockSize;
+    out->capacity = pool->capacity;
+    out->keep = pool->keep;
+
+    portENTER_CRITICAL(&poolLock);
+    out->allocated = 0;
+    out->inUse = 0;
+    for(int i = 0; i < pool->capacity; i++) {
+        if(pool->slots[i].data) out->allocated++;
+        if(pool->slots[i].used) out->inUse++;
+    }
+    out->peakInUse = pool->peakInUse;
+    out->hits = pool->hits;
+    out->misses = pool->misses;
+    out->failures = pool->failures;
+    portEXIT_CRITICAL(&poolLock);
+    return true;
+}
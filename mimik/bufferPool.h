@@ -0,0 +1,100 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * bufferPool.h - Buffers grandes reutilizables por clases de tamaño
+ */
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+// Bloques por pool como máximo
+#define POOL_MAX_BLOCKS 8
+
+// Origen de la memoria
+#define POOL_ANY   0x00     // PSRAM si la hay; si no, RAM interna
+#define POOL_DMA   0x01     // RAM interna apta para DMA (transferencias de la SD)
+#define POOL_PSRAM 0x02     // Solo PSRAM (nullptr si no hay)
+
+// Pools
+enum PoolId {
+    POOL_IO_4K = 0,
+    POOL_IO_8K,
+    POOL_IO_16K,
+    POOL_IO_64K,
+    POOL_DMA_4K,
+    POOL_DMA_16K,
+    POOL_SPILL,             // Reservas sueltas cuando no queda bloque
+    POOL_COUNT
+};
+
+struct PoolStats {
+    const char* name;
+    const char* memory;     // "PSRAM", "DRAM" o "DMA"
+    size_t blockSize;       // 0: tamaño variable (spill)
+    uint8_t capacity;       // Bloques como máximo
+    uint8_t keep;           // Bloques libres que se conservan
+    uint8_t allocated;      // Bloques reservados ahora
+    uint8_t inUse;
+    uint8_t peakInUse;
+    uint32_t hits;          // Entregas con un bloque ya reservado
+    uint32_t misses;        // Entregas que reservaron memoria
+    uint32_t failures;      // Sin bloque ni memoria
+};
+
+// Los comandos piden aquí sus buffers de E/S en lugar de ponerlos en
+// el stack de la tarea (4-8 KB). Cada pool guarda bloques de un tamaño
+// fijo: se reservan al primer uso y los libres se conservan (hasta
+// 'keep') para no fragmentar el heap. Con PSRAM los pools de E/S viven
+// allí y conservan todos sus bloques; sin PSRAM son pequeños y
+// devuelven al heap casi todo lo que se libera. Los bloques de
+// heap_caps_malloc están alineados a palabra, que es lo que necesita el
+// DMA de la SD con memoria interna.
+class BufferPool {
+public:
+    static void begin();
+
+    // Buffer de al menos 'minimum' bytes y, si se puede, 'wanted'.
+    // Prueba primero el pool justo, después los mayores y por último
+    // los menores. 'got' recibe la capacidad real del bloque.
+    static void* acquire(size_t wanted, size_t minimum, uint8_t flags, size_t* got);
+    static void* acquire(size_t size, uint8_t flags = POOL_ANY) {
+        return acquire(size, size, flags, nullptr);
+    }
+
+    // false si el puntero no es del pool
+    static bool release(void* buffer);
+    static bool owns(const void* buffer);
+
+    static bool getStats(int pool, PoolStats* out);
+
+private:
+    struct Slot {
+        uint8_t* data;
+        size_t size;
+        bool used;          // used && !data: reservando
+    };
+
+    struct Pool {
+        const char* name;
+        size_t blockSize;
+        bool dma;
+        uint32_t caps;
+        uint8_t capacity;
+        uint8_t keep;
+        uint8_t peakInUse;
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t failures;
+        Slot slots[POOL_MAX_BLOCKS];
+    };
+
+    static Pool pools[POOL_COUNT];
+    static bool psram;
+
+    static void* take(int pool, size_t size, uint32_t caps, size_t* got);
+    static bool usable(int pool, uint8_t flags);
+};
+
+#endif
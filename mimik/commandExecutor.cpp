@@ -0,0 +1,186 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * commandExecutor.cpp - Implementación del reparto de recursos
+ */
+
+#include "commandExecutor.h"
+#include "tracer.h"
+
+CommandExecutor::Waiter CommandExecutor::waiters[EXECUTOR_MAX_WAITERS];
+uint32_t CommandExecutor::nextSeq = 0;
+int CommandExecutor::sdReaders = 0;
+bool CommandExecutor::sdWriter = false;
+bool CommandExecutor::netBusy = false;
+unsigned long CommandExecutor::contentions = 0;
+unsigned long CommandExecutor::totalWaitMs = 0;
+
+static portMUX_TYPE executorLock = portMUX_INITIALIZER_UNLOCKED;
+
+bool CommandExecutor::begin() {
+    for(int i = 0; i < EXECUTOR_MAX_WAITERS; i++) {
+        if(!waiters[i].wake) {
+            waiters[i].wake = xSemaphoreCreateBinary();
+            if(!waiters[i].wake) {
+                return false;
+            }
+        }
+        waiters[i].active = false;
+    }
+    return true;
+}
+
+// Dos peticiones chocan si ambas usan la red o si una escribe en la SD
+// y la otra la usa de cualquier forma
+bool CommandExecutor::conflicts(uint8_t a, uint8_t b) {
+    if((a & CMD_RES_NET) && (b & CMD_RES_NET)) return true;
+    const uint8_t sd = CMD_RES_SD_READ | CMD_RES_SD_WRITE;
+    if((a & CMD_RES_SD_WRITE) && (b & sd)) return true;
+    if((b & CMD_RES_SD_WRITE) && (a & sd)) return true;
+    return false;
+}
+
+// Con executorLock tomado. Además de no chocar con lo que está en uso,
+// no puede adelantar a nadie con más prioridad (o igual y anterior)
+// que choque con ella: así una escritura no espera indefinidamente
+// detrás de lecturas que se solapan.
+bool CommandExecutor::canRun(uint8_t resources, uint8_t priority, uint32_t seq) {
+    uint8_t held = (sdReaders > 0 ? CMD_RES_SD_READ : 0) |
+                   (sdWriter ? CMD_RES_SD_WRITE : 0) |
+                   (netBusy ? CMD_RES_NET : 0);
+    if(conflicts(resources, held)) {
+        return false;
+    }
+
+    for(int i = 0; i < EXECUTOR_MAX_WAITERS; i++) {
+        const Waiter* w = &waiters[i];
+        if(!w->active || w->seq == seq) continue;
+        bool ahead = w->priority > priority ||
+                     (w->priority == priority && (int32_t)(w->seq - seq) < 0);
+        if(ahead && conflicts(resources, w->resources)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CommandExecutor::take(uint8_t resources) {
+    if(resources & CMD_RES_SD_READ) sdReaders++;
+    if(resources & CMD_RES_SD_WRITE) sdWriter = true;
+    if(resources & CMD_RES_NET) netBusy = true;
+}
+
+// Fuera de executorLock: cada espera vuelve a evaluar su turno
+void CommandExecutor::wakeAll() {
+    for(int i = 0; i < EXECUTOR_MAX_WAITERS; i++) {
+        if(waiters[i].active && waiters[i].wake) {
+            xSemaphoreGive(waiters[i].wake);
+        }
+    }
+}
+
+uint8_t CommandExecutor::priorityOf(ShellSession* session) {
+    if(!session) {
+        return EXEC_PRIO_BACKGROUND;
+    }
+    switch(session->type) {
+        case ShellSession::SESSION_SERIAL: return EXEC_PRIO_CONSOLE;
+        case ShellSession::SESSION_TELNET: return EXEC_PRIO_REMOTE;
+        default:                           return EXEC_PRIO_BACKGROUND;
+    }
+}
+
+bool CommandExecutor::acquire(uint8_t resources, ShellSession* session) {
+    if(resources == CMD_RES_NONE) {
+        return true;
+    }
+
+    uint8_t priority = priorityOf(session);
+
+    // Camino rápido: nada en uso que choque y nadie esperando delante
+    portENTER_CRITICAL(&executorLock);
+    uint32_t seq = nextSeq++;
+    if(canRun(resources, priority, seq)) {
+        take(resources);
+        portEXIT_CRITICAL(&executorLock);
+        return true;
+    }
+
+    // Ponerse en la cola
+    Waiter* slot = nullptr;
+    for(int i = 0; i < EXECUTOR_MAX_WAITERS; i++) {
+        if(!waiters[i].active && waiters[i].wake) {
+            slot = &waiters[i];
+            slot->active = true;
+            slot->resources = resources;
+            slot->priority = priority;
+            slot->seq = seq;
+            break;
+        }
+    }
+    contentions++;
+    portEXIT_CRITICAL(&executorLock);
+
+    TraceScope trace("wait.resources", resources);
+    unsigned long start = millis();
+    bool granted = false;
+    while(true) {
+        if(slot) {
+            xSemaphoreTake(slot->wake, pdMS_TO_TICKS(EXECUTOR_POLL_MS));
+        } else {
+            // Sin hueco en la cola: sondear sin reservar turno
+            vTaskDelay(pdMS_TO_TICKS(EXECUTOR_POLL_MS));
+        }
+
+        bool stop = session && session->interrupted();
+        portENTER_CRITICAL(&executorLock);
+        if(canRun(resources, priority, seq)) {
+            take(resources);
+            granted = true;
+        }
+        if(granted || stop) {
+            if(slot) slot->active = false;
+            totalWaitMs += millis() - start;
+            portEXIT_CRITICAL(&executorLock);
+            break;
+        }
+        portEXIT_CRITICAL(&executorLock);
+    }
+
+    // Salir de la cola puede desbloquear a los que esperaban detrás
+    wakeAll();
+    return granted;
+}
+
+bool CommandExecutor::tryAcquire(uint8_t resources) {
+    portENTER_CRITICAL(&executorLock);
+    bool granted = canRun(resources, EXEC_PRIO_BACKGROUND, nextSeq++);
+    if(granted) {
+        take(resources);
+    }
+    portEXIT_CRITICAL(&executorLock);
+    return granted;
+}
+
+void CommandExecutor::release(uint8_t resources) {
+    if(resources == CMD_RES_NONE) {
+        return;
+    }
+
+    portENTER_CRITICAL(&executorLock);
+    if((resources & CMD_RES_SD_READ) && sdReaders > 0) sdReaders--;
+    if(resources & CMD_RES_SD_WRITE) sdWriter = false;
+    if(resources & CMD_RES_NET) netBusy = false;
+    portEXIT_CRITICAL(&executorLock);
+
+    wakeAll();
+}
+
+int CommandExecutor::waiting() {
+    int n = 0;
+    portENTER_CRITICAL(&executorLock);
+    for(int i = 0; i < EXECUTOR_MAX_WAITERS; i++) {
+        if(waiters[i].active) n++;
+    }
+    portEXIT_CRITICAL(&executorLock);
+    return n;
+}
@@ -0,0 +1,79 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * commandExecutor.h - Reparto de recursos (SD, red) entre comandos
+ */
+
+#ifndef COMMAND_EXECUTOR_H
+#define COMMAND_EXECUTOR_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "shell.h"
+#include "shellSession.h"
+
+// Un comando espera como mucho a un comando de cada sesión
+#define EXECUTOR_MAX_WAITERS MAX_SESSIONS
+// Cada cuánto revisa Ctrl+C un comando en espera
+#define EXECUTOR_POLL_MS 50
+
+// Prioridad de la cola de espera: la consola serial primero, después
+// las sesiones Telnet y por último los trabajos y scripts de arranque
+enum ExecutorPriority {
+    EXEC_PRIO_BACKGROUND = 0,
+    EXEC_PRIO_REMOTE,
+    EXEC_PRIO_CONSOLE
+};
+
+// Cada front end (serial, workers Telnet, workers de trabajos) sigue
+// ejecutando sus comandos en su propia tarea; aquí solo se decide
+// cuándo pueden empezar. Los comandos que no chocan corren en paralelo
+// y los que chocan esperan en una cola ordenada por prioridad y llegada:
+//   - CMD_RES_SD_READ: compartido con otros lectores
+//   - CMD_RES_SD_WRITE: exclusivo sobre toda la SD
+//   - CMD_RES_NET: exclusivo sobre la radio WiFi y la configuración IP
+// Las sondas que solo abren sus propios sockets (ping...) no lo piden.
+class CommandExecutor {
+public:
+    static bool begin();
+
+    // Bloquea hasta poder usar 'resources'. Devuelve false si la
+    // sesión se interrumpe (Ctrl+C, timeout, kill) mientras espera.
+    // Sin sesión (nullptr) espera con la prioridad más baja.
+    static bool acquire(uint8_t resources, ShellSession* session);
+    static void release(uint8_t resources);
+
+    // Para tareas de mantenimiento: reserva solo si está libre ahora,
+    // sin ponerse en la cola
+    static bool tryAcquire(uint8_t resources);
+
+    // Estadísticas
+    static int waiting();
+    static unsigned long contended() { return contentions; }
+    static unsigned long waitedMs() { return totalWaitMs; }
+
+private:
+    struct Waiter {
+        bool active;
+        uint8_t resources;
+        uint8_t priority;
+        uint32_t seq;
+        SemaphoreHandle_t wake;
+    };
+
+    static Waiter waiters[EXECUTOR_MAX_WAITERS];
+    static uint32_t nextSeq;
+    static int sdReaders;
+    static bool sdWriter;
+    static bool netBusy;
+    static unsigned long contentions;
+    static unsigned long totalWaitMs;
+
+    static bool conflicts(uint8_t a, uint8_t b);
+    static bool canRun(uint8_t resources, uint8_t priority, uint32_t seq);
+    static void take(uint8_t resources);
+    static void wakeAll();
+    static uint8_t priorityOf(ShellSession* session);
+};
+
+#endif
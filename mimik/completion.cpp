@@ -0,0 +1,181 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * completion.cpp - Implementación del autocompletado
+ */
+
+#include "completion.h"
+#include "commandExecutor.h"
+
+DirCache::Slot DirCache::slots[DIRCACHE_SLOTS];
+SemaphoreHandle_t DirCache::mutex = NULL;
+
+// Añadir <tipo><nombre>'\0' al buffer de candidatos
+static bool appendCandidate(char* out, size_t outSize, size_t* used, char type, const char* name) {
+    size_t len = strlen(name);
+    if(*used + len + 2 > outSize) return false;
+    out[(*used)++] = type;
+    memcpy(out + *used, name, len + 1);
+    *used += len + 1;
+    return true;
+}
+
+void DirCache::begin() {
+    if(!mutex) {
+        mutex = xSemaphoreCreateMutex();
+    }
+    invalidateAll();
+}
+
+// Lee el directorio una sola vez y lo guarda en el slot más antiguo
+DirCache::Slot* DirCache::load(const char* dir) {
+    unsigned long now = millis();
+    Slot* victim = &slots[0];
+
+    for(int i = 0; i < DIRCACHE_SLOTS; i++) {
+        Slot* slot = &slots[i];
+        if(slot->valid && strcmp(slot->path, dir) == 0) {
+            if(now - slot->loadedAt < DIRCACHE_TTL_MS) {
+                return slot;
+            }
+            victim = slot;
+            break;
+        }
+        if(!slot->valid || slot->loadedAt < victim->loadedAt) {
+            victim = slot;
+        }
+    }
+
+    // Sin esperar: si un comando escribe en la SD, el Tab se conforma
+    // con el listado caducado (si lo hay)
+    if(!CommandExecutor::tryAcquire(CMD_RES_SD_READ)) {
+        return victim->valid && strcmp(victim->path, dir) == 0 ? victim : nullptr;
+    }
+
+    File root = SD_MMC.open(dir);
+    if(!root || !root.isDirectory()) {
+        if(root) root.close();
+        CommandExecutor::release(CMD_RES_SD_READ);
+        return nullptr;
+    }
+
+    victim->valid = false;
+    victim->used = 0;
+    size_t used = 0;
+
+    File entry = root.openNextFile();
+    while(entry) {
+        const char* name = entry.name();
+        if(!MiniShell::isSystemEntry(name)) {
+            // Si no cabe, el listado queda truncado (solo afecta al Tab)
+            appendCandidate(victim->names, sizeof(victim->names), &used,
+                            entry.isDirectory() ? COMPLETE_DIR : COMPLETE_FILE, name);
+        }
+        entry.close();
+        entry = root.openNextFile();
+    }
+    root.close();
+    CommandExecutor::release(CMD_RES_SD_READ);
+
+    strncpy(victim->path, dir, MAX_PATH_LENGTH - 1);
+    victim->path[MAX_PATH_LENGTH - 1] = '\0';
+    victim->used = used;
+    victim->loadedAt = now;
+    victim->valid = true;
+    return victim;
+}
+
+int DirCache::collect(const char* dir, const char* prefix, char* out, size_t outSize) {
+    if(!mutex) return 0;
+
+    size_t prefixLen = strlen(prefix);
+    size_t used = 0;
+    int count = 0;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Slot* slot = load(dir);
+    if(slot) {
+        size_t pos = 0;
+        while(pos < slot->used && count < COMPLETION_MAX_ITEMS) {
+            char type = slot->names[pos];
+            const char* name = slot->names + pos + 1;
+            pos += strlen(name) + 2;
+
+            // Los ocultos solo si se pide explícitamente un '.'
+            if(name[0] == '.' && prefix[0] != '.') continue;
+            if(strncmp(name, prefix, prefixLen) != 0) continue;
+            if(!appendCandidate(out, outSize, &used, type, name)) break;
+            count++;
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    return count;
+}
+
+void DirCache::invalidate(const char* path) {
+    if(!mutex) return;
+
+    // Directorio padre de 'path'
+    char parent[MAX_PATH_LENGTH];
+    strncpy(parent, path, sizeof(parent) - 1);
+    parent[sizeof(parent) - 1] = '\0';
+    size_t length = strlen(parent);
+    while(length > 1 && parent[length - 1] == '/') parent[--length] = '\0';
+    char* slash = strrchr(parent, '/');
+    if(slash == parent) parent[1] = '\0';
+    else if(slash) *slash = '\0';
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for(int i = 0; i < DIRCACHE_SLOTS; i++) {
+        if(slots[i].valid && strcmp(slots[i].path, parent) == 0) {
+            slots[i].valid = false;
+        }
+    }
+    xSemaphoreGive(mutex);
+}
+
+void DirCache::invalidateAll() {
+    if(mutex) xSemaphoreTake(mutex, portMAX_DELAY);
+    for(int i = 0; i < DIRCACHE_SLOTS; i++) {
+        slots[i].valid = false;
+    }
+    if(mutex) xSemaphoreGive(mutex);
+}
+
+int completeCommands(const char* prefix, char* out, size_t outSize) {
+    size_t prefixLen = strlen(prefix);
+    size_t used = 0;
+    int count = 0;
+
+    for(int i = 0; i < shell.getCommandCount() && count < COMPLETION_MAX_ITEMS; i++) {
+        const Command* cmd = shell.getCommand(i);
+        if(strncmp(cmd->name, prefix, prefixLen) != 0) continue;
+        if(!appendCandidate(out, outSize, &used, COMPLETE_COMMAND, cmd->name)) break;
+        count++;
+    }
+    return count;
+}
+
+int completePath(const char* cwd, const char* word, char* out, size_t outSize) {
+    char dir[MAX_PATH_LENGTH];
+    const char* slash = strrchr(word, '/');
+    const char* prefix = slash ? slash + 1 : word;
+
+    // Directorio a listar: la parte de 'word' hasta el último '/'
+    if(word[0] == '/') {
+        size_t length = min((size_t)(slash - word), sizeof(dir) - 1);
+        if(length == 0) length = 1;  // "/xxx" se completa en la raíz
+        memcpy(dir, word, length);
+        dir[length] = '\0';
+    } else {
+        int length = snprintf(dir, sizeof(dir), "%s", cwd);
+        if(slash) {
+            if(length > 0 && dir[length - 1] != '/') {
+                length += snprintf(dir + length, sizeof(dir) - length, "/");
+            }
+            snprintf(dir + length, sizeof(dir) - length, "%.*s", (int)(slash - word), word);
+        }
+    }
+
+    return DirCache::collect(dir, prefix, out, outSize);
+}
@@ -0,0 +1,64 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * completion.h - Autocompletado (Tab) de comandos y rutas
+ */
+
+#ifndef COMPLETION_H
+#define COMPLETION_H
+
+#include <Arduino.h>
+#include <SD_MMC.h>
+#include "shell.h"
+
+// Directorios recordados y su tiempo de vida
+#define DIRCACHE_SLOTS 3
+#define DIRCACHE_NAMES_BYTES 768
+#define DIRCACHE_TTL_MS 5000
+
+// Tamaño del buffer de candidatos de una completación
+#define COMPLETION_BUFFER 512
+#define COMPLETION_MAX_ITEMS 64
+
+// Los candidatos se empaquetan como <tipo><nombre>'\0', con tipo
+// 'c' (comando), 'd' (directorio) o 'f' (archivo).
+#define COMPLETE_COMMAND 'c'
+#define COMPLETE_DIR     'd'
+#define COMPLETE_FILE    'f'
+
+// Cache de listados de directorio de vida corta, compartida por todas
+// las sesiones. Evita recorrer la SD con openNextFile en cada Tab.
+class DirCache {
+public:
+    static void begin();
+
+    // Copia en 'out' las entradas de 'dir' que empiezan por 'prefix'.
+    // Devuelve el número de candidatos.
+    static int collect(const char* dir, const char* prefix, char* out, size_t outSize);
+
+    // Olvidar el directorio que contiene 'path' (tras modificarlo)
+    static void invalidate(const char* path);
+    static void invalidateAll();
+
+private:
+    struct Slot {
+        char path[MAX_PATH_LENGTH];
+        unsigned long loadedAt;
+        uint16_t used;
+        bool valid;
+        char names[DIRCACHE_NAMES_BYTES];
+    };
+
+    static Slot slots[DIRCACHE_SLOTS];
+    static SemaphoreHandle_t mutex;
+
+    static Slot* load(const char* dir);
+};
+
+// Candidatos entre los comandos registrados
+int completeCommands(const char* prefix, char* out, size_t outSize);
+
+// Candidatos para una ruta (absoluta o relativa a 'cwd'). Solo se
+// compara lo que sigue al último '/' de 'word'.
+int completePath(const char* cwd, const char* word, char* out, size_t outSize);
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * deflateStream.cpp - Implementación del compresor zlib en streaming
+ */
+
+#include "deflateStream.h"
+#include "tracer.h"
+
+#define WINDOW_MASK (DEFLATE_WINDOW - 1)
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+
+// Tablas de longitudes (códigos 257..285) y distancias (RFC 1951, 3.2.5)
+static const uint16_t lengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t lengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+static const uint8_t distExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static inline uint32_t hash3(const uint8_t* p) {
+    return ((p[0] << 6) ^ (p[1] << 3) ^ p[2]) & (DEFLATE_HASH_SIZE - 1);
+}
+
+DeflateStream::DeflateStream(Print* output) {
+    sink = output;
+    bytesIn = 0;
+    bytesOut = 0;
+}
+
+void DeflateStream::begin() {
+    memset(head, 0, sizeof(head));
+    memset(prev, 0, sizeof(prev));
+    pos = 0;
+    adlerA = 1;
+    adlerB = 0;
+    bitBuffer = 0;
+    bitCount = 0;
+    outLength = 0;
+    blockOpen = false;
+    dirty = false;
+
+    // Cabecera zlib: CM=8 (deflate), CINFO = log2(ventana) - 8
+    int windowBits = 0;
+    while((1 << windowBits) < DEFLATE_WINDOW) windowBits++;
+    uint8_t cmf = ((windowBits - 8) << 4) | 8;
+    uint8_t flg = 31 - ((cmf << 8) % 31);
+    putByte(cmf);
+    putByte(flg);
+    sendOutput();
+}
+
+void DeflateStream::write(const uint8_t* data, size_t len) {
+    if(len == 0) return;
+    bytesIn += len;
+    dirty = true;
+
+    size_t i = 0;
+    while(i < len) {
+        if(!blockOpen) {
+            putBits(2, 3);  // BFINAL=0, BTYPE=01 (Huffman fijo)
+            blockOpen = true;
+        }
+
+        // Buscar la coincidencia más larga en la ventana
+        int bestLength = 0;
+        int bestDistance = 0;
+        size_t remaining = len - i;
+
+        if(remaining >= MIN_MATCH) {
+            uint16_t candidate = head[hash3(data + i)];
+            for(int chain = 0; chain < DEFLATE_MAX_CHAIN; chain++) {
+                uint32_t distance = (uint16_t)((uint16_t)pos - candidate);
+                if(distance == 0 || distance > DEFLATE_WINDOW || distance > pos) break;
+
+                size_t maxLength = min(min(remaining, (size_t)MAX_MATCH), (size_t)distance);
+                size_t k = 0;
+                while(k < maxLength && window[(pos - distance + k) & WINDOW_MASK] == data[i + k]) {
+                    k++;
+                }
+                if((int)k > bestLength) {
+                    bestLength = k;
+                    bestDistance = distance;
+                    if(k == maxLength) break;
+                }
+
+                // La cadena solo puede ir hacia atrás
+                uint16_t next = prev[(pos - distance) & WINDOW_MASK];
+                if((uint16_t)((uint16_t)pos - next) <= distance) break;
+                candidate = next;
+            }
+        }
+
+        if(bestLength >= MIN_MATCH) {
+            emitMatch(bestLength, bestDistance);
+            advance(data + i, bestLength, remaining);
+            i += bestLength;
+        } else {
+            emitLiteral(data[i]);
+            advance(data + i, 1, remaining);
+            i++;
+        }
+    }
+}
+
+// Añadir bytes a la ventana, al índice hash y al Adler-32
+void DeflateStream::advance(const uint8_t* data, size_t count, size_t available) {
+    for(size_t k = 0; k < count; k++) {
+        if(available - k >= MIN_MATCH) {
+            uint32_t h = hash3(data + k);
+            prev[pos & WINDOW_MASK] = head[h];
+            head[h] = (uint16_t)pos;
+        }
+        window[pos & WINDOW_MASK] = data[k];
+        pos++;
+
+        adlerA = (adlerA + data[k]) % 65521;
+        adlerB = (adlerB + adlerA) % 65521;
+    }
+}
+
+void DeflateStream::flush() {
+    if(!dirty) return;
+
+    if(blockOpen) {
+        emitSymbol(256);  // Fin de bloque
+        blockOpen = false;
+    }
+    // Bloque almacenado vacío: alinea y permite descomprimir hasta aquí
+    putBits(0, 3);
+    alignToByte();
+    putByte(0x00);
+    putByte(0x00);
+    putByte(0xFF);
+    putByte(0xFF);
+    sendOutput();
+    dirty = false;
+}
+
+void DeflateStream::finish() {
+    if(blockOpen) {
+        emitSymbol(256);
+        blockOpen = false;
+    }
+    // Último bloque (vacío) y checksum
+    putBits(3, 3);  // BFINAL=1, BTYPE=01
+    emitSymbol(256);
+    alignToByte();
+    putByte(adlerB >> 8);
+    putByte(adlerB & 0xFF);
+    putByte(adlerA >> 8);
+    putByte(adlerA & 0xFF);
+    sendOutput();
+    dirty = false;
+}
+
+void DeflateStream::emitLiteral(uint8_t value) {
+    emitSymbol(value);
+}
+
+void DeflateStream::emitMatch(int length, int distance) {
+    int li = 28;
+    while(lengthBase[li] > length) li--;
+    emitSymbol(257 + li);
+    putBits(length - lengthBase[li], lengthExtra[li]);
+
+    int di = 29;
+    while(distBase[di] > distance) di--;
+    putHuffman(di, 5);
+    putBits(distance - distBase[di], distExtra[di]);
+}
+
+// Códigos Huffman fijos de literales/longitudes (RFC 1951, 3.2.6)
+void DeflateStream::emitSymbol(int symbol) {
+    if(symbol < 144) {
+        putHuffman(0x30 + symbol, 8);
+    } else if(symbol < 256) {
+        putHuffman(0x190 + (symbol - 144), 9);
+    } else if(symbol < 280) {
+        putHuffman(symbol - 256, 7);
+    } else {
+        putHuffman(0xC0 + (symbol - 280), 8);
+    }
+}
+
+// Los códigos Huffman se empaquetan empezando por el bit más significativo
+void DeflateStream::putHuffman(uint32_t code, int length) {
+    uint32_t reversed = 0;
+    for(int i = 0; i < length; i++) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    putBits(reversed, length);
+}
+
+void DeflateStream::putBits(uint32_t value, int count) {
+    bitBuffer |= value << bitCount;
+    bitCount += count;
+    while(bitCount >= 8) {
+        putByte(bitBuffer & 0xFF);
+        bitBuffer >>= 8;
+        bitCount -= 8;
+    }
+}
+
+void DeflateStream::alignToByte() {
+    if(bitCount > 0) {
+        putByte(bitBuffer & 0xFF);
+        bitBuffer = 0;
+        bitCount = 0;
+    }
+}
+
+void DeflateStream::putByte(uint8_t b) {
+    outBuffer[outLength++] = b;
+    if(outLength == sizeof(outBuffer)) {
+        sendOutput();
+    }
+}
+
+void DeflateStream::sendOutput() {
+    if(outLength == 0) return;
+    if(sink) {
+        TraceScope trace("net.send", outLength);
+        sink->write(outBuffer, outLength);
+    }
+    bytesOut += outLength;
+    outLength = 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * deflateStream.h - Compresor zlib en streaming (ventana pequeña fija)
+ */
+
+#ifndef DEFLATE_STREAM_H
+#define DEFLATE_STREAM_H
+
+#include <Arduino.h>
+
+// Ventana LZ77 (potencia de 2, máximo 32768). 1 KB basta para texto
+// repetitivo de la shell y deja el compresor en ~4 KB por sesión.
+#define DEFLATE_WINDOW 1024
+#define DEFLATE_HASH_BITS 9
+#define DEFLATE_HASH_SIZE (1 << DEFLATE_HASH_BITS)
+#define DEFLATE_MAX_CHAIN 8
+
+// Flujo zlib (RFC 1950/1951) con bloques Huffman fijos. Cada flush()
+// cierra el bloque actual con un bloque vacío sincronizado
+// (00 00 FF FF), de modo que el cliente puede descomprimir todo lo
+// enviado hasta ese punto.
+class DeflateStream {
+public:
+    DeflateStream(Print* output);
+
+    void begin();
+    void write(const uint8_t* data, size_t len);
+    void flush();
+    void finish();
+
+    unsigned long bytesIn;   // Datos sin comprimir recibidos
+    unsigned long bytesOut;  // Datos comprimidos enviados
+
+private:
+    Print* sink;
+
+    uint8_t window[DEFLATE_WINDOW];
+    uint16_t head[DEFLATE_HASH_SIZE];
+    uint16_t prev[DEFLATE_WINDOW];
+    uint32_t pos;
+
+    uint32_t adlerA;
+    uint32_t adlerB;
+
+    uint32_t bitBuffer;
+    int bitCount;
+    uint8_t outBuffer[128];
+    size_t outLength;
+
+    bool blockOpen;
+    bool dirty;
+
+    void advance(const uint8_t* data, size_t count, size_t available);
+    void emitLiteral(uint8_t value);
+    void emitMatch(int length, int distance);
+    void emitSymbol(int symbol);
+    void putHuffman(uint32_t code, int length);
+    void putBits(uint32_t value, int count);
+    void alignToByte();
+    void putByte(uint8_t b);
+    void sendOutput();
+};
+
+#endif
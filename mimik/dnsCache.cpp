@@ -0,0 +1,277 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * dnsCache.cpp - Implementación de la caché de nombres
+ */
+
+#include "dnsCache.h"
+#include "sysLog.h"
+#include "tracer.h"
+#include <WiFi.h>
+#include <lwip/sockets.h>
+
+DnsEntry DnsCache::entries[DNS_CACHE_SLOTS];
+uint32_t DnsCache::hits = 0;
+uint32_t DnsCache::misses = 0;
+uint16_t DnsCache::nextQueryId = 0;
+
+static portMUX_TYPE dnsLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Con dnsLock tomado
+int DnsCache::find(const char* name) {
+    for(int i = 0; i < DNS_CACHE_SLOTS; i++) {
+        if(entries[i].used && strcasecmp(entries[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+void DnsCache::store(const char* name, uint32_t addr, uint32_t ttlSeconds, bool negative) {
+    if(strlen(name) >= DNS_NAME_MAX) return;
+    ttlSeconds = constrain(ttlSeconds, (uint32_t)DNS_MIN_TTL_S, (uint32_t)DNS_MAX_TTL_S);
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&dnsLock);
+    int slot = find(name);
+    if(slot < 0) {
+        // Libre, caducada o la usada hace más tiempo
+        uint32_t oldest = 0;
+        for(int i = 0; i < DNS_CACHE_SLOTS; i++) {
+            DnsEntry* entry = &entries[i];
+            if(!entry->used || now - entry->storedMs >= entry->ttlMs) {
+                slot = i;
+                break;
+            }
+            if(now - entry->lastUsedMs >= oldest) {
+                oldest = now - entry->lastUsedMs;
+                slot = i;
+            }
+        }
+    }
+    DnsEntry* entry = &entries[slot];
+    strcpy(entry->name, name);
+    entry->addr = addr;
+    entry->storedMs = now;
+    entry->ttlMs = ttlSeconds * 1000;
+    entry->lastUsedMs = now;
+    entry->hits = 0;
+    entry->negative = negative;
+    entry->used = true;
+    portEXIT_CRITICAL(&dnsLock);
+}
+
+bool DnsCache::resolve(const char* host, uint32_t* addr, bool* cached) {
+    if(cached) *cached = true;
+
+    // IP literal: nada que consultar
+    IPAddress literal;
+    if(literal.fromString(host)) {
+        *addr = htonl(((uint32_t)literal[0] << 24) | ((uint32_t)literal[1] << 16) |
+                      ((uint32_t)literal[2] << 8) | literal[3]);
+        return true;
+    }
+
+    uint32_t now = millis();
+    portENTER_CRITICAL(&dnsLock);
+    int slot = find(host);
+    bool fresh = slot >= 0 && now - entries[slot].storedMs < entries[slot].ttlMs;
+    bool negative = false;
+    if(fresh) {
+        entries[slot].hits++;
+        entries[slot].lastUsedMs = now;
+        negative = entries[slot].negative;
+        *addr = entries[slot].addr;
+        hits++;
+    } else {
+        misses++;
+    }
+    portEXIT_CRITICAL(&dnsLock);
+    if(fresh) return !negative;
+
+    if(cached) *cached = false;
+    TraceScope trace("dns.query", 0);
+
+    // Servidores de la conexión actual
+    uint32_t servers[2];
+    int serverCount = 0;
+    for(int n = 0; n < 2; n++) {
+        IPAddress dns = WiFi.dnsIP(n);
+        uint32_t server = htonl(((uint32_t)dns[0] << 24) | ((uint32_t)dns[1] << 16) |
+                                ((uint32_t)dns[2] << 8) | dns[3]);
+        if(server != 0) servers[serverCount++] = server;
+    }
+
+    // Una sola ronda a todos los servidores a la vez: una búsqueda en frío
+    // no tarda más que hostByName, que es lo que había antes
+    uint32_t ttl = 0;
+    int result = serverCount > 0 ? query(servers, serverCount, host, addr, &ttl) : -2;
+    if(result > 0) {
+        store(host, *addr, ttl, false);
+        return true;
+    }
+    if(result == 0) {
+        store(host, 0, DNS_NEGATIVE_TTL_S, true);
+        return false;
+    }
+    if(result == -1) {
+        // Sin respuesta (o nombre que no se puede preguntar): sin caché
+        return false;
+    }
+
+    // No se pudo preguntar por UDP: que lo intente la pila (sin TTL conocido)
+    SysLog::debug("dns", "Cannot query %s over UDP, using hostByName", host);
+    IPAddress ip;
+    if(!WiFi.hostByName(host, ip)) {
+        return false;
+    }
+    *addr = htonl(((uint32_t)ip[0] << 24) | ((uint32_t)ip[1] << 16) | ((uint32_t)ip[2] << 8) | ip[3]);
+    store(host, *addr, DNS_FALLBACK_TTL_S, false);
+    return true;
+}
+
+int DnsCache::query(const uint32_t* servers, int serverCount, const char* name, uint32_t* addr, uint32_t* ttl) {
+    uint8_t packet[DNS_PACKET_SIZE];
+
+    // Cabecera: id, recursión deseada, una pregunta
+    if(nextQueryId == 0) nextQueryId = (uint16_t)micros() | 1;
+    uint16_t id = nextQueryId++;
+    memset(packet, 0, 12);
+    packet[0] = id >> 8;
+    packet[1] = id & 0xFF;
+    packet[2] = 0x01;
+    packet[5] = 1;
+
+    // Nombre en etiquetas: "www.example.com" -> 3www7example3com0.
+    // Un nombre que no se puede codificar no es un "no existe".
+    int length = 12;
+    const char* label = name;
+    while(*label) {
+        const char* dot = strchr(label, '.');
+        int size = dot ? dot - label : strlen(label);
+        if(size == 0 || size > 63 || length + size + 6 > DNS_PACKET_SIZE) return -1;
+        packet[length++] = size;
+        memcpy(packet + length, label, size);
+        length += size;
+        label += size;
+        if(*label == '.') label++;
+    }
+    packet[length++] = 0;
+    packet[length++] = 0;       // Tipo A
+    packet[length++] = 1;
+    packet[length++] = 0;       // Clase IN
+    packet[length++] = 1;
+
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if(fd < 0) return -2;
+    int sent = 0;
+    for(int i = 0; i < serverCount; i++) {
+        struct sockaddr_in to;
+        memset(&to, 0, sizeof(to));
+        to.sin_family = AF_INET;
+        to.sin_addr.s_addr = servers[i];
+        to.sin_port = htons(53);
+        if(sendto(fd, packet, length, 0, (struct sockaddr*)&to, sizeof(to)) == length) sent++;
+    }
+    if(sent == 0) {
+        close(fd);
+        return -2;
+    }
+
+    // La primera respuesta válida de cualquiera; un error (SERVFAIL...)
+    // de uno deja esperar al otro
+    int result = -1;
+    int failed = 0;
+    unsigned long start = millis();
+    while(millis() - start < DNS_QUERY_TIMEOUT_MS && failed < sent) {
+        uint32_t left = DNS_QUERY_TIMEOUT_MS - (millis() - start);
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(fd, &readSet);
+        struct timeval wait;
+        wait.tv_sec = left / 1000;
+        wait.tv_usec = (left % 1000) * 1000;
+        if(select(fd + 1, &readSet, NULL, NULL, &wait) <= 0) break;
+
+        struct sockaddr_in from;
+        socklen_t fromLength = sizeof(from);
+        int received = recvfrom(fd, packet, sizeof(packet), 0, (struct sockaddr*)&from, &fromLength);
+        bool known = false;
+        for(int i = 0; i < serverCount; i++) {
+            if(from.sin_addr.s_addr == servers[i]) known = true;
+        }
+        if(received <= 0 || !known) continue;
+        result = parse(packet, received, id, addr, ttl);
+        if(result != -1) break;
+        // -1: respuesta ajena o rota, o error del servidor
+        if(received >= 4 && ((packet[0] << 8) | packet[1]) == id) failed++;
+    }
+    close(fd);
+    return result;
+}
+
+// Salta un nombre (etiquetas o puntero de compresión); -1 si se sale
+static int skipName(const uint8_t* packet, int length, int offset) {
+    while(offset < length) {
+        uint8_t size = packet[offset];
+        if(size == 0) return offset + 1;
+        if((size & 0xC0) == 0xC0) return offset + 2;
+        offset += size + 1;
+    }
+    return -1;
+}
+
+int DnsCache::parse(const uint8_t* packet, int length, uint16_t id, uint32_t* addr, uint32_t* ttl) {
+    if(length < 12) return -1;
+    if(((packet[0] << 8) | packet[1]) != id || !(packet[2] & 0x80)) return -1;
+    bool truncated = packet[2] & 0x02;
+    int rcode = packet[3] & 0x0F;
+    if(rcode == 3) return 0;            // NXDOMAIN
+    if(rcode != 0) return -1;           // SERVFAIL, REFUSED...: probar el otro
+
+    int questions = (packet[4] << 8) | packet[5];
+    int answers = (packet[6] << 8) | packet[7];
+    int offset = 12;
+    for(int i = 0; i < questions; i++) {
+        offset = skipName(packet, length, offset);
+        if(offset < 0 || offset + 4 > length) return -1;
+        offset += 4;
+    }
+
+    // Cadena de CNAME hasta el A: vale el menor de los TTL
+    uint32_t shortest = 0xFFFFFFFF;
+    for(int i = 0; i < answers; i++) {
+        offset = skipName(packet, length, offset);
+        if(offset < 0 || offset + 10 > length) return -1;
+        uint16_t type = (packet[offset] << 8) | packet[offset + 1];
+        uint16_t klass = (packet[offset + 2] << 8) | packet[offset + 3];
+        uint32_t recordTtl = ((uint32_t)packet[offset + 4] << 24) | ((uint32_t)packet[offset + 5] << 16) |
+                             ((uint32_t)packet[offset + 6] << 8) | packet[offset + 7];
+        uint16_t size = (packet[offset + 8] << 8) | packet[offset + 9];
+        offset += 10;
+        if(offset + size > length) return -1;
+        if(recordTtl < shortest) shortest = recordTtl;
+        if(type == 1 && klass == 1 && size == 4) {
+            memcpy(addr, packet + offset, 4);
+            *ttl = shortest;
+            return 1;
+        }
+        offset += size;
+    }
+    // Existe pero sin registro A (si no vino recortada: TC)
+    return truncated ? -1 : 0;
+}
+
+void DnsCache::flush() {
+    portENTER_CRITICAL(&dnsLock);
+    for(int i = 0; i < DNS_CACHE_SLOTS; i++) {
+        entries[i].used = false;
+    }
+    portEXIT_CRITICAL(&dnsLock);
+}
+
+bool DnsCache::getEntry(int slot, DnsEntry* out) {
+    if(slot < 0 || slot >= DNS_CACHE_SLOTS) return false;
+    portENTER_CRITICAL(&dnsLock);
+    bool used = entries[slot].used;
+    if(used) *out = entries[slot];
+    portEXIT_CRITICAL(&dnsLock);
+    return used;
+}
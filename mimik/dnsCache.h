@@ -0,0 +1,64 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * dnsCache.h - Caché de nombres con TTL (ping, tcping, netbench...)
+ */
+
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include <Arduino.h>
+
+#define DNS_CACHE_SLOTS 16
+#define DNS_NAME_MAX 64                 // Nombres más largos no se guardan
+#define DNS_PACKET_SIZE 512             // Respuesta UDP sin EDNS
+#define DNS_QUERY_TIMEOUT_MS 1500       // Una sola ronda, a todos los servidores
+#define DNS_MIN_TTL_S 5
+#define DNS_MAX_TTL_S 3600              // Aunque el registro diga más
+#define DNS_NEGATIVE_TTL_S 60           // NXDOMAIN / sin registro A
+#define DNS_FALLBACK_TTL_S 300          // Resuelto por hostByName (sin TTL)
+
+struct DnsEntry {
+    char name[DNS_NAME_MAX];
+    uint32_t addr;          // Orden de red (0 en las negativas)
+    uint32_t storedMs;
+    uint32_t ttlMs;
+    uint32_t lastUsedMs;
+    uint32_t hits;
+    bool negative;          // El nombre no existe
+    bool used;
+};
+
+// Resolver con caché: las IP literales se devuelven sin consultar
+// nada; los nombres se buscan primero aquí y, si no están o caducaron,
+// se preguntan por UDP al DNS de la conexión WiFi para conocer el TTL
+// del registro (WiFi.hostByName no lo da). Las respuestas "no existe"
+// también se guardan un rato, así que repetir un nombre mal escrito
+// no vuelve a esperar al servidor. Si no se puede preguntar por UDP se
+// recurre a hostByName.
+class DnsCache {
+public:
+    // Nombre o IP -> dirección (orden de red). 'cached' (opcional):
+    // true si no hizo falta consultar.
+    static bool resolve(const char* host, uint32_t* addr, bool* cached = nullptr);
+    static void flush();
+
+    // Copia de la entrada 'slot' (false si está libre)
+    static bool getEntry(int slot, DnsEntry* out);
+    static uint32_t hitCount() { return hits; }
+    static uint32_t missCount() { return misses; }
+
+private:
+    static DnsEntry entries[DNS_CACHE_SLOTS];
+    static uint32_t hits;
+    static uint32_t misses;
+    static uint16_t nextQueryId;
+
+    static int find(const char* name);
+    static void store(const char* name, uint32_t addr, uint32_t ttlSeconds, bool negative);
+
+    // 1: resuelto, 0: no existe, -1: sin respuesta, -2: no se pudo enviar
+    static int query(const uint32_t* servers, int serverCount, const char* name, uint32_t* addr, uint32_t* ttl);
+    static int parse(const uint8_t* packet, int length, uint16_t id, uint32_t* addr, uint32_t* ttl);
+};
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * fixedString.h - Cadenas de capacidad fija (sin heap)
+ */
+
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// Sustituto de String para el camino de los comandos: el texto vive
+// en el propio objeto (pila o estructura), así que construir rutas o
+// líneas no reserva memoria ni fragmenta el heap. Lo que no cabe se
+// recorta y queda marcado en overflowed().
+template <size_t N>
+class FixedString {
+public:
+    FixedString() : len(0), overflow(false) { text[0] = '\0'; }
+    FixedString(const char* value) : len(0), overflow(false) {
+        text[0] = '\0';
+        append(value);
+    }
+
+    void clear() {
+        len = 0;
+        overflow = false;
+        text[0] = '\0';
+    }
+
+    bool set(const char* value) {
+        clear();
+        return append(value);
+    }
+
+    bool append(const char* value) {
+        while(*value) {
+            if(!append(*value++)) return false;
+        }
+        return true;
+    }
+
+    bool append(char c) {
+        if(len >= N - 1) {
+            overflow = true;
+            return false;
+        }
+        text[len++] = c;
+        text[len] = '\0';
+        return true;
+    }
+
+    bool appendf(const char* format, ...) {
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(text + len, N - len, format, args);
+        va_end(args);
+        if(written < 0) {
+            text[len] = '\0';
+            return false;
+        }
+        if((size_t)written >= N - len) {
+            len = N - 1;
+            overflow = true;
+            return false;
+        }
+        len += written;
+        return true;
+    }
+
+    // Deja solo los primeros 'length' caracteres
+    void truncate(size_t length) {
+        if(length < len) {
+            len = length;
+            text[len] = '\0';
+        }
+    }
+
+    int lastIndexOf(char c) const {
+        for(int i = (int)len - 1; i >= 0; i--) {
+            if(text[i] == c) return i;
+        }
+        return -1;
+    }
+
+    bool equals(const char* value) const { return strcmp(text, value) == 0; }
+
+    const char* c_str() const { return text; }
+    operator const char*() const { return text; }
+    size_t length() const { return len; }
+    bool isEmpty() const { return len == 0; }
+    bool overflowed() const { return overflow; }
+    static size_t capacity() { return N - 1; }
+
+private:
+    char text[N];
+    uint16_t len;
+    bool overflow;
+};
+
+#endif
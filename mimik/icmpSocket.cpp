@@ -0,0 +1,178 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * icmpSocket.cpp - Implementación del socket ICMP
+ */
+
+#include "icmpSocket.h"
+#include <lwip/sockets.h>
+
+uint16_t IcmpSocket::nextIdent = 0;
+
+static portMUX_TYPE identLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Cabecera ICMP de echo (RFC 792)
+struct EchoHeader {
+    uint8_t type;
+    uint8_t code;
+    uint16_t checksum;
+    uint16_t id;
+    uint16_t seq;
+};
+
+IcmpSocket::IcmpSocket() : fd(-1), ident(0) {
+}
+
+IcmpSocket::~IcmpSocket() {
+    close();
+}
+
+bool IcmpSocket::open() {
+    if(fd >= 0) return true;
+    fd = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+    if(fd < 0) {
+        return false;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    // Identificador distinto por socket (el primero, al azar); varias
+    // sesiones pueden abrir a la vez
+    uint16_t seed = (uint16_t)(micros() ^ (micros() >> 16)) | 1;
+    portENTER_CRITICAL(&identLock);
+    if(nextIdent == 0) {
+        nextIdent = seed;
+    }
+    ident = nextIdent++;
+    portEXIT_CRITICAL(&identLock);
+    return true;
+}
+
+void IcmpSocket::close() {
+    if(fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+uint16_t IcmpSocket::checksum(const uint8_t* data, size_t length) {
+    uint32_t sum = 0;
+    for(size_t i = 0; i + 1 < length; i += 2) {
+        sum += (uint16_t)((data[i] << 8) | data[i + 1]);
+    }
+    if(length & 1) {
+        sum += (uint16_t)(data[length - 1] << 8);
+    }
+    while(sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return htons((uint16_t)~sum);
+}
+
+bool IcmpSocket::send(uint32_t addr, uint16_t seq) {
+    if(fd < 0) return false;
+
+    uint8_t packet[sizeof(EchoHeader) + ICMP_PAYLOAD];
+    EchoHeader* header = (EchoHeader*)packet;
+    header->type = ICMP_ECHO_REQUEST;
+    header->code = 0;
+    header->checksum = 0;
+    header->id = htons(ident);
+    header->seq = htons(seq);
+
+    uint8_t* data = packet + sizeof(EchoHeader);
+    uint32_t stamp = micros();
+    memcpy(data, &stamp, sizeof(stamp));
+    for(int i = sizeof(stamp); i < ICMP_PAYLOAD; i++) {
+        data[i] = (uint8_t)i;
+    }
+    header->checksum = checksum(packet, sizeof(packet));
+
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = addr;
+    int sent = sendto(fd, packet, sizeof(packet), 0, (struct sockaddr*)&to, sizeof(to));
+    return sent == (int)sizeof(packet);
+}
+
+// Los sockets raw entregan el datagrama con su cabecera IP
+bool IcmpSocket::parse(const uint8_t* packet, int length, uint32_t from, IcmpReply* reply) {
+    if(length < 20) return false;
+    int ipHeader = (packet[0] & 0x0F) * 4;
+    if(length < ipHeader + (int)sizeof(EchoHeader)) return false;
+
+    const uint8_t* icmp = packet + ipHeader;
+    const EchoHeader* header = (const EchoHeader*)icmp;
+    int icmpLength = length - ipHeader;
+
+    if(header->type == ICMP_ECHO_REPLY) {
+        if(ntohs(header->id) != ident) return false;
+        reply->seq = ntohs(header->seq);
+        reply->rttUs = 0;
+        if(icmpLength >= (int)(sizeof(EchoHeader) + sizeof(uint32_t))) {
+            uint32_t stamp;
+            memcpy(&stamp, icmp + sizeof(EchoHeader), sizeof(stamp));
+            reply->rttUs = micros() - stamp;
+        }
+    } else if(header->type == ICMP_DEST_UNREACHABLE || header->type == ICMP_TIME_EXCEEDED) {
+        // Dentro va la cabecera IP original y los 8 primeros bytes del echo
+        const uint8_t* inner = icmp + sizeof(EchoHeader);
+        int innerLength = icmpLength - (int)sizeof(EchoHeader);
+        if(innerLength < 20) return false;
+        int innerHeader = (inner[0] & 0x0F) * 4;
+        if(innerLength < innerHeader + (int)sizeof(EchoHeader)) return false;
+        const EchoHeader* original = (const EchoHeader*)(inner + innerHeader);
+        if(inner[9] != IPPROTO_ICMP || original->type != ICMP_ECHO_REQUEST) return false;
+        if(ntohs(original->id) != ident) return false;
+        reply->seq = ntohs(original->seq);
+        reply->rttUs = 0;
+    } else {
+        return false;
+    }
+
+    reply->addr = from;
+    reply->type = header->type;
+    reply->code = header->code;
+    reply->ttl = packet[8];
+    reply->bytes = (uint16_t)icmpLength;
+    return true;
+}
+
+bool IcmpSocket::receive(IcmpReply* reply, uint32_t timeoutMs) {
+    if(fd < 0) return false;
+    uint8_t packet[ICMP_RECV_BUFFER];
+    unsigned long start = millis();
+
+    while(true) {
+        struct sockaddr_in from;
+        socklen_t fromLength = sizeof(from);
+        int length = recvfrom(fd, packet, sizeof(packet), 0, (struct sockaddr*)&from, &fromLength);
+        if(length > 0) {
+            // El socket recibe todo el ICMP del equipo: descartar lo ajeno
+            if(parse(packet, length, from.sin_addr.s_addr, reply)) return true;
+            continue;
+        }
+        if(length < 0 && errno != EWOULDBLOCK && errno != EAGAIN) {
+            return false;
+        }
+
+        unsigned long elapsed = millis() - start;
+        if(elapsed >= timeoutMs) return false;
+        uint32_t left = timeoutMs - elapsed;
+
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(fd, &readSet);
+        struct timeval wait;
+        wait.tv_sec = left / 1000;
+        wait.tv_usec = (left % 1000) * 1000;
+        if(select(fd + 1, &readSet, NULL, NULL, &wait) <= 0) {
+            return false;
+        }
+    }
+}
+
+void IcmpSocket::formatAddr(uint32_t addr, char* buffer, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)&addr;
+    snprintf(buffer, size, "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+}
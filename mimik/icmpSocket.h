@@ -0,0 +1,85 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * icmpSocket.h - Socket ICMP propio (echo) para ping y pingsweep
+ */
+
+#ifndef ICMP_SOCKET_H
+#define ICMP_SOCKET_H
+
+#include <Arduino.h>
+
+// Datos de cada echo: marca de tiempo + relleno
+#define ICMP_PAYLOAD 32
+#define ICMP_RECV_BUFFER 128        // Cabecera IP (hasta 60) + ICMP + datos
+
+// Tipos ICMP que interesan
+#define ICMP_ECHO_REPLY       0
+#define ICMP_DEST_UNREACHABLE 3
+#define ICMP_ECHO_REQUEST     8
+#define ICMP_TIME_EXCEEDED    11
+
+// ping
+#define PING_COUNT 4
+#define PING_MAX_COUNT 10000
+#define PING_INTERVAL_MS 1000
+#define PING_MIN_INTERVAL_MS 20
+#define PING_TIMEOUT_MS 2000
+#define PING_MAX_PENDING 32         // Echos esperando respuesta
+
+// pingsweep
+#define SWEEP_MAX_HOSTS 1024        // Hasta un /22
+#define SWEEP_MAX_WINDOW 32         // Echos en vuelo como máximo
+#define SWEEP_WINDOW 16
+#define SWEEP_TIMEOUT_MS 1000
+#define SWEEP_RETRIES 1
+
+struct IcmpReply {
+    uint32_t addr;          // Quien responde (orden de red)
+    uint16_t seq;
+    uint8_t type;           // ICMP_ECHO_REPLY o el error que lo sustituye
+    uint8_t code;
+    uint8_t ttl;
+    uint16_t bytes;         // Bytes ICMP recibidos
+    uint32_t rttUs;         // Solo en ICMP_ECHO_REPLY
+};
+
+// Socket raw no bloqueante: se pueden tener muchas peticiones en vuelo
+// y casar las respuestas por identificador y secuencia. La marca de
+// tiempo viaja en los datos del echo, así que el RTT sale de la propia
+// respuesta sin guardar nada por paquete. Cada objeto usa su propio
+// identificador, de modo que varios (ping en un job y pingsweep en la
+// sesión) no se quitan las respuestas. Solo usa la API de sockets de
+// lwIP, que es la BSD, así que también funciona en un PC (con permiso
+// para sockets raw) contra loopback.
+class IcmpSocket {
+public:
+    IcmpSocket();
+    ~IcmpSocket();
+
+    bool open();
+    void close();
+    bool isOpen() const { return fd >= 0; }
+    uint16_t id() const { return ident; }
+
+    // addr en orden de red. false si la pila no tiene hueco (reintentar)
+    // o el socket falla.
+    bool send(uint32_t addr, uint16_t seq);
+
+    // Espera como mucho timeoutMs a una respuesta a este socket (echo
+    // reply o error ICMP con un echo nuestro dentro). false al agotarse.
+    bool receive(IcmpReply* reply, uint32_t timeoutMs);
+
+    // a.b.c.d (orden de red) sin String
+    static void formatAddr(uint32_t addr, char* buffer, size_t size);
+
+private:
+    int fd;
+    uint16_t ident;
+
+    static uint16_t nextIdent;
+
+    static uint16_t checksum(const uint8_t* data, size_t length);
+    bool parse(const uint8_t* packet, int length, uint32_t from, IcmpReply* reply);
+};
+
+#endif
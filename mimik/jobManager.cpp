@@ -0,0 +1,323 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * jobManager.cpp - Implementación de los trabajos en segundo plano
+ */
+
+#include "jobManager.h"
+#include "sshServer.h"
+#include "metrics.h"
+#include "sysLog.h"
+
+Job JobManager::jobs[MAX_JOBS];
+int JobManager::nextId = 1;
+QueueHandle_t JobManager::queue = NULL;
+ShellSession JobManager::workerSessions[JOB_WORKERS];
+StaticTask_t JobManager::workerTcbs[JOB_WORKERS];
+StackType_t JobManager::workerStacks[JOB_WORKERS][JOB_STACK_SIZE];
+
+static portMUX_TYPE jobLock = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE outputLock = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================================
+// Salida de un trabajo
+// ============================================
+
+JobOutput::JobOutput() {
+    buffer = nullptr;
+    head = 0;
+    length = 0;
+    lost = 0;
+}
+
+bool JobOutput::begin() {
+    if(!buffer) {
+        buffer = (uint8_t*)malloc(JOB_OUTPUT_BYTES);
+    }
+    head = 0;
+    length = 0;
+    lost = 0;
+    return buffer != nullptr;
+}
+
+void JobOutput::end() {
+    portENTER_CRITICAL(&outputLock);
+    uint8_t* old = buffer;
+    buffer = nullptr;
+    length = 0;
+    portEXIT_CRITICAL(&outputLock);
+    free(old);
+}
+
+size_t JobOutput::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t JobOutput::write(const uint8_t* data, size_t len) {
+    portENTER_CRITICAL(&outputLock);
+    if(!buffer) {
+        portEXIT_CRITICAL(&outputLock);
+        return len;
+    }
+
+    // Solo cabe el final de un bloque mayor que el buffer
+    if(len > JOB_OUTPUT_BYTES) {
+        lost += len - JOB_OUTPUT_BYTES;
+        data += len - JOB_OUTPUT_BYTES;
+        len = JOB_OUTPUT_BYTES;
+    }
+
+    // Descartar lo más antiguo para hacer sitio
+    size_t space = JOB_OUTPUT_BYTES - length;
+    if(len > space) {
+        size_t drop = len - space;
+        head = (head + drop) % JOB_OUTPUT_BYTES;
+        length -= drop;
+        lost += drop;
+    }
+
+    size_t tail = (head + length) % JOB_OUTPUT_BYTES;
+    size_t first = min(len, (size_t)JOB_OUTPUT_BYTES - tail);
+    memcpy(buffer + tail, data, first);
+    memcpy(buffer, data + first, len - first);
+    length += len;
+    portEXIT_CRITICAL(&outputLock);
+    return len;
+}
+
+size_t JobOutput::read(uint8_t* data, size_t len) {
+    portENTER_CRITICAL(&outputLock);
+    len = min(len, length);
+    size_t first = min(len, (size_t)JOB_OUTPUT_BYTES - head);
+    if(buffer) {
+        memcpy(data, buffer + head, first);
+        memcpy(data + first, buffer, len - first);
+    }
+    head = (head + len) % JOB_OUTPUT_BYTES;
+    length -= len;
+    portEXIT_CRITICAL(&outputLock);
+    return len;
+}
+
+size_t JobOutput::available() {
+    return length;
+}
+
+// ============================================
+// Pool de workers
+// ============================================
+
+bool JobManager::begin() {
+    queue = xQueueCreate(MAX_JOBS, sizeof(int));
+    if(!queue) {
+        return false;
+    }
+
+    for(int i = 0; i < JOB_WORKERS; i++) {
+        // El nombre se conserva: lo usa 'stats'
+        static char names[JOB_WORKERS][16];
+        char* name = names[i];
+        snprintf(name, sizeof(names[i]), "JobWorker%d", i);
+        TaskHandle_t handle = xTaskCreateStaticPinnedToCore(
+            workerTask,
+            name,
+            JOB_STACK_SIZE,
+            &workerSessions[i],
+            JOB_TASK_PRIORITY,
+            workerStacks[i],
+            &workerTcbs[i],
+            i % 2  // Repartir entre los dos cores
+        );
+        if(!handle) {
+            SysLog::warn("jobs", "Cannot create job worker %d", i);
+        } else {
+            Metrics::watchTask(name, handle, JOB_STACK_SIZE * sizeof(StackType_t));
+        }
+    }
+    return true;
+}
+
+void JobManager::workerTask(void* parameter) {
+    ShellSession* session = (ShellSession*)parameter;
+    ShellSession::setCurrent(session);
+
+    while(true) {
+        int index;
+        if(xQueueReceive(queue, &index, portMAX_DELAY) == pdTRUE) {
+            run(&jobs[index], session);
+        }
+    }
+}
+
+void JobManager::run(Job* job, ShellSession* session) {
+    portENTER_CRITICAL(&jobLock);
+    if(job->cancel) {
+        // Cancelado mientras esperaba en la cola
+        job->state = JOB_DONE;
+        job->result = SHELL_ERR_CANCELLED;
+        job->endedAt = millis();
+        portEXIT_CRITICAL(&jobLock);
+        return;
+    }
+    job->state = JOB_RUNNING;
+    job->startedAt = millis();
+    job->session = session;
+    portEXIT_CRITICAL(&jobLock);
+
+    char peer[24];
+    snprintf(peer, sizeof(peer), "job %d", job->id);
+    session->open(ShellSession::SESSION_JOB, nullptr, &job->output, peer);
+    strncpy(session->currentPath, job->cwd, MAX_PATH_LENGTH - 1);
+    session->currentPath[MAX_PATH_LENGTH - 1] = '\0';
+    session->cancelled = job->cancel;  // 'kill' llegado antes de abrir la sesión
+
+    // executeLine modifica la línea: trabajar sobre una copia
+    char line[MAX_CMD_LENGTH];
+    strcpy(line, job->line);
+    ShellError result = shell.executeLine(line);
+    session->close();
+
+    portENTER_CRITICAL(&jobLock);
+    job->session = nullptr;
+    job->result = job->cancel && result != SHELL_OK ? SHELL_ERR_CANCELLED : result;
+    job->endedAt = millis();
+    job->state = JOB_DONE;
+    portEXIT_CRITICAL(&jobLock);
+}
+
+// ============================================
+// Tabla de trabajos
+// ============================================
+
+int JobManager::submit(const char* line) {
+    if(!queue) {
+        return -1;
+    }
+
+    // Hueco libre o, si no hay, el trabajo terminado más antiguo
+    portENTER_CRITICAL(&jobLock);
+    Job* slot = nullptr;
+    for(int i = 0; i < MAX_JOBS; i++) {
+        Job* job = &jobs[i];
+        if(job->state == JOB_FREE) {
+            slot = job;
+            break;
+        }
+        if(job->state == JOB_DONE && !job->attached &&
+           (!slot || job->endedAt < slot->endedAt)) {
+            slot = job;
+        }
+    }
+    if(!slot) {
+        portEXIT_CRITICAL(&jobLock);
+        return -1;
+    }
+    slot->state = JOB_QUEUED;
+    slot->id = nextId++;
+    portEXIT_CRITICAL(&jobLock);
+
+    if(!slot->output.begin()) {
+        slot->state = JOB_FREE;
+        return -1;
+    }
+
+    ShellSession* owner = ShellSession::current();
+    strncpy(slot->line, line, MAX_CMD_LENGTH - 1);
+    slot->line[MAX_CMD_LENGTH - 1] = '\0';
+    strncpy(slot->cwd, owner->currentPath, MAX_PATH_LENGTH - 1);
+    slot->cwd[MAX_PATH_LENGTH - 1] = '\0';
+    slot->owner = owner->id;
+    slot->queuedAt = millis();
+    slot->startedAt = 0;
+    slot->endedAt = 0;
+    slot->result = SHELL_OK;
+    slot->cancel = false;
+    slot->attached = false;
+    slot->session = nullptr;
+
+    int index = slot - jobs;
+    if(xQueueSend(queue, &index, 0) != pdTRUE) {
+        slot->output.end();
+        slot->state = JOB_FREE;
+        return -1;
+    }
+    return slot->id;
+}
+
+// Cancelación cooperativa: el comando la comprueba en sus bucles
+bool JobManager::kill(int id) {
+    bool found = false;
+    portENTER_CRITICAL(&jobLock);
+    for(int i = 0; i < MAX_JOBS; i++) {
+        Job* job = &jobs[i];
+        if(job->state != JOB_FREE && job->id == id) {
+            if(job->state != JOB_DONE) {
+                job->cancel = true;
+                if(job->session) job->session->cancelled = true;
+            }
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&jobLock);
+    return found;
+}
+
+Job* JobManager::find(int id) {
+    for(int i = 0; i < MAX_JOBS; i++) {
+        if(jobs[i].state != JOB_FREE && jobs[i].id == id) {
+            return &jobs[i];
+        }
+    }
+    return nullptr;
+}
+
+// Trabajo más reciente (por defecto para 'fg')
+Job* JobManager::latest() {
+    Job* result = nullptr;
+    for(int i = 0; i < MAX_JOBS; i++) {
+        if(jobs[i].state != JOB_FREE && (!result || jobs[i].id > result->id)) {
+            result = &jobs[i];
+        }
+    }
+    return result;
+}
+
+// Libera un trabajo terminado cuya salida ya se leyó
+void JobManager::release(Job* job) {
+    if(job->state != JOB_DONE) return;
+    job->output.end();
+    portENTER_CRITICAL(&jobLock);
+    job->attached = false;
+    job->state = JOB_FREE;
+    portEXIT_CRITICAL(&jobLock);
+}
+
+int JobManager::count() {
+    int n = 0;
+    for(int i = 0; i < MAX_JOBS; i++) {
+        if(jobs[i].state != JOB_FREE) n++;
+    }
+    return n;
+}
+
+Job* JobManager::get(int index) {
+    int n = 0;
+    for(int i = 0; i < MAX_JOBS; i++) {
+        if(jobs[i].state != JOB_FREE) {
+            if(n == index) return &jobs[i];
+            n++;
+        }
+    }
+    return nullptr;
+}
+
+const char* JobManager::stateName(const Job* job) {
+    switch(job->state) {
+        case JOB_QUEUED:  return "Queued";
+        case JOB_RUNNING: return job->cancel ? "Killing" : "Running";
+        case JOB_DONE:
+            if(job->result == SHELL_ERR_CANCELLED) return "Killed";
+            return job->result == SHELL_OK ? "Done" : "Exit";
+        default:          return "-";
+    }
+}
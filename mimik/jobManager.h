@@ -0,0 +1,101 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * jobManager.h - Trabajos en segundo plano (cmd &, jobs, fg, kill)
+ */
+
+#ifndef JOB_MANAGER_H
+#define JOB_MANAGER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include "shell.h"
+#include "shellSession.h"
+
+// Pool fijo de workers con stack preasignado
+#define JOB_WORKERS 2
+#define JOB_STACK_SIZE 6144
+#define JOB_TASK_PRIORITY 1
+
+// Trabajos recordados (en cola, en ejecución o terminados)
+#define MAX_JOBS 8
+// Salida guardada por trabajo hasta que 'fg' la lea
+#define JOB_OUTPUT_BYTES 2048
+
+enum JobState {
+    JOB_FREE = 0,
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE
+};
+
+// Buffer circular de salida de un trabajo. Si se llena se descarta
+// lo más antiguo: al hacer 'fg' interesa el final.
+class JobOutput : public Print {
+public:
+    JobOutput();
+
+    bool begin();
+    void end();
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t len) override;
+    size_t read(uint8_t* data, size_t len);
+    size_t available();
+    unsigned long dropped() { return lost; }
+
+private:
+    uint8_t* buffer;
+    size_t head;
+    size_t length;
+    unsigned long lost;
+};
+
+struct Job {
+    int id;
+    volatile JobState state;
+    char line[MAX_CMD_LENGTH];
+    char cwd[MAX_PATH_LENGTH];
+    int owner;                  // Sesión que lo lanzó
+    JobOutput output;
+    unsigned long queuedAt;
+    unsigned long startedAt;
+    unsigned long endedAt;
+    ShellError result;
+    volatile bool cancel;       // 'kill' pedido
+    volatile bool attached;     // 'fg' leyendo la salida
+    ShellSession* session;      // Sesión del worker mientras corre
+};
+
+class JobManager {
+public:
+    static bool begin();
+    static bool available() { return queue != NULL; }
+
+    // Encola 'line' y devuelve el id del trabajo (o -1)
+    static int submit(const char* line);
+
+    static bool kill(int id);
+    static Job* find(int id);
+    static Job* latest();
+    static void release(Job* job);
+
+    static int count();
+    static Job* get(int index);
+    static const char* stateName(const Job* job);
+
+private:
+    static Job jobs[MAX_JOBS];
+    static int nextId;
+    static QueueHandle_t queue;
+
+    static ShellSession workerSessions[JOB_WORKERS];
+    static StaticTask_t workerTcbs[JOB_WORKERS];
+    static StackType_t workerStacks[JOB_WORKERS][JOB_STACK_SIZE];
+
+    static void workerTask(void* parameter);
+    static void run(Job* job, ShellSession* session);
+};
+
+#endif
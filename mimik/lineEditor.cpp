@@ -0,0 +1,642 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * lineEditor.cpp - Implementación de la edición de línea y el historial
+ */
+
+#include "lineEditor.h"
+#include "completion.h"
+#include "shellSession.h"
+
+// ============================================
+// Historial de comandos
+// ============================================
+
+CommandHistory::CommandHistory() {
+    clear();
+}
+
+void CommandHistory::clear() {
+    used = 0;
+    entries = 0;
+    unsaved = 0;
+}
+
+void CommandHistory::add(const char* line) {
+    size_t len = strlen(line) + 1;
+    if(len <= 1 || len > HISTORY_BYTES) return;
+
+    // No repetir el último comando
+    if(entries > 0 && strcmp(get(0), line) == 0) return;
+
+    // Descartar las entradas más antiguas hasta que quepa
+    while(used + len > HISTORY_BYTES && entries > 0) {
+        size_t oldest = strlen(pool) + 1;
+        memmove(pool, pool + oldest, used - oldest);
+        used -= oldest;
+        entries--;
+    }
+
+    memcpy(pool + used, line, len);
+    used += len;
+    entries++;
+    if(unsaved < entries) unsaved++;
+}
+
+const char* CommandHistory::get(int index) {
+    if(index < 0 || index >= entries) return "";
+
+    int target = entries - 1 - index;
+    const char* p = pool;
+    for(int i = 0; i < target; i++) {
+        p += strlen(p) + 1;
+    }
+    return p;
+}
+
+// Busca hacia atrás (más antiguo) empezando en 'from'
+int CommandHistory::search(const char* query, int from) {
+    for(int i = max(from, 0); i < entries; i++) {
+        if(strstr(get(i), query)) return i;
+    }
+    return -1;
+}
+
+bool CommandHistory::load(const char* path) {
+    File file = SD_MMC.open(path, FILE_READ);
+    if(!file) return false;
+
+    char chunk[64];
+    char line[MAX_CMD_LENGTH];
+    size_t lineLen = 0;
+
+    while(file.available()) {
+        size_t n = file.read((uint8_t*)chunk, sizeof(chunk));
+        for(size_t i = 0; i < n; i++) {
+            if(chunk[i] == '\n' || chunk[i] == '\r') {
+                line[lineLen] = '\0';
+                if(lineLen > 0) add(line);
+                lineLen = 0;
+            } else if(lineLen < sizeof(line) - 1) {
+                line[lineLen++] = chunk[i];
+            }
+        }
+    }
+    file.close();
+
+    unsaved = 0;
+    return true;
+}
+
+// Añade las entradas nuevas en una sola escritura. Si el archivo crece
+// demasiado se reescribe con el contenido actual del anillo.
+bool CommandHistory::save(const char* path) {
+    if(unsaved == 0) return true;
+
+    File file = SD_MMC.open(path, FILE_APPEND);
+    if(!file) return false;
+
+    char batch[512];
+    size_t batchLen = 0;
+    for(int i = unsaved - 1; i >= 0; i--) {
+        const char* entry = get(i);
+        size_t len = strlen(entry);
+        if(batchLen + len + 1 > sizeof(batch)) {
+            file.write((const uint8_t*)batch, batchLen);
+            batchLen = 0;
+        }
+        memcpy(batch + batchLen, entry, len);
+        batchLen += len;
+        batch[batchLen++] = '\n';
+    }
+    if(batchLen > 0) file.write((const uint8_t*)batch, batchLen);
+
+    bool rewrite = file.size() > HISTORY_FILE_MAX;
+    file.close();
+    unsaved = 0;
+
+    if(rewrite) {
+        file = SD_MMC.open(path, FILE_WRITE);
+        if(!file) return false;
+        for(int i = entries - 1; i >= 0; i--) {
+            file.println(get(i));
+        }
+        file.close();
+    }
+    return true;
+}
+
+// ============================================
+// Editor de línea
+// ============================================
+
+LineEditor::LineEditor() {
+    session = nullptr;
+    reset();
+}
+
+void LineEditor::attach(ShellSession* owner) {
+    session = owner;
+    reset();
+}
+
+void LineEditor::reset() {
+    len = 0;
+    cursor = 0;
+    buffer[0] = '\0';
+    lastChar = 0;
+    escState = ESC_NONE;
+    escParamLen = 0;
+    historyIndex = -1;
+    saved[0] = '\0';
+    searching = false;
+    queryLen = 0;
+    query[0] = '\0';
+    searchIndex = -1;
+}
+
+InputResult LineEditor::feed(char c) {
+    char prev = lastChar;
+    lastChar = c;
+
+    int key = (uint8_t)c;
+    if(escState != ESC_NONE || c == 27) {
+        key = decodeEscape(c);
+        if(key == KEY_NONE) return INPUT_NONE;
+    }
+
+    // "\r\n" de algunos terminales: ignorar el '\n'
+    if(c == '\n' && prev == '\r') return INPUT_NONE;
+
+    if(searching) return searchKey(key);
+    return handleKey(key);
+}
+
+// Secuencias ANSI/VT100: ESC [ A..D, ESC [ H/F, ESC [ n ~, ESC O A..D/H/F
+int LineEditor::decodeEscape(char c) {
+    switch(escState) {
+        case ESC_NONE:
+            escState = ESC_START;
+            return KEY_NONE;
+
+        case ESC_START:
+            if(c == '[') {
+                escState = ESC_CSI;
+                escParamLen = 0;
+            } else if(c == 'O') {
+                escState = ESC_SS3;
+            } else {
+                escState = ESC_NONE;  // Alt+tecla: ignorar
+            }
+            return KEY_NONE;
+
+        case ESC_SS3:
+            escState = ESC_NONE;
+            switch(c) {
+                case 'A': return KEY_UP;
+                case 'B': return KEY_DOWN;
+                case 'C': return KEY_RIGHT;
+                case 'D': return KEY_LEFT;
+                case 'H': return KEY_HOME;
+                case 'F': return KEY_END;
+            }
+            return KEY_NONE;
+
+        case ESC_CSI:
+            if((c >= '0' && c <= '9') || c == ';') {
+                if(escParamLen < (int)sizeof(escParam) - 1) escParam[escParamLen++] = c;
+                return KEY_NONE;
+            }
+            escState = ESC_NONE;
+            escParam[escParamLen] = '\0';
+            switch(c) {
+                case 'A': return KEY_UP;
+                case 'B': return KEY_DOWN;
+                case 'C': return KEY_RIGHT;
+                case 'D': return KEY_LEFT;
+                case 'H': return KEY_HOME;
+                case 'F': return KEY_END;
+                case '~':
+                    switch(atoi(escParam)) {
+                        case 1: case 7: return KEY_HOME;
+                        case 4: case 8: return KEY_END;
+                        case 3: return KEY_DELETE;
+                    }
+            }
+            return KEY_NONE;
+    }
+    return KEY_NONE;
+}
+
+InputResult LineEditor::handleKey(int key) {
+    switch(key) {
+        case '\r':
+        case '\n':
+            return finishLine();
+        case 127:
+        case 8:
+            backspace();
+            break;
+        case 3:   // Ctrl+C
+            return INPUT_CANCEL;
+        case 4:   // Ctrl+D
+            if(len == 0) return INPUT_EOF;
+            deleteAtCursor();
+            break;
+        case 1:   // Ctrl+A
+        case KEY_HOME:
+            moveTo(0);
+            break;
+        case 5:   // Ctrl+E
+        case KEY_END:
+            moveTo(len);
+            break;
+        case 2:   // Ctrl+B
+        case KEY_LEFT:
+            if(cursor > 0) moveTo(cursor - 1);
+            break;
+        case 6:   // Ctrl+F
+        case KEY_RIGHT:
+            if(cursor < len) moveTo(cursor + 1);
+            break;
+        case 16:  // Ctrl+P
+        case KEY_UP:
+            historyUp();
+            break;
+        case 14:  // Ctrl+N
+        case KEY_DOWN:
+            historyDown();
+            break;
+        case KEY_DELETE:
+            deleteAtCursor();
+            break;
+        case 11:  // Ctrl+K
+            killToEnd();
+            break;
+        case 21:  // Ctrl+U
+            killLine();
+            break;
+        case 23:  // Ctrl+W
+            killWord();
+            break;
+        case 12:  // Ctrl+L
+            emit("\x1b[2J\x1b[H");
+            redrawLine();
+            break;
+        case 18:  // Ctrl+R
+            startSearch();
+            break;
+        case '\t':
+            complete();
+            break;
+        default:
+            if(key >= 32 && key < 127) insertChar((char)key);
+            break;
+    }
+    return INPUT_NONE;
+}
+
+InputResult LineEditor::finishLine() {
+    buffer[len] = '\0';
+    emit("\r\n", 2);
+    if(len > 0) history.add(buffer);
+    historyIndex = -1;
+    return INPUT_LINE;
+}
+
+// ============================================
+// Edición con redibujado mínimo
+// ============================================
+
+void LineEditor::insertChar(char c) {
+    if(len >= MAX_CMD_LENGTH - 1) return;
+
+    memmove(buffer + cursor + 1, buffer + cursor, len - cursor);
+    buffer[cursor] = c;
+    len++;
+    // Escribir desde el cursor y volver: al final es solo el carácter
+    emit(buffer + cursor, len - cursor);
+    cursor++;
+    cursorLeft(len - cursor);
+}
+
+void LineEditor::backspace() {
+    if(cursor == 0) return;
+
+    memmove(buffer + cursor - 1, buffer + cursor, len - cursor);
+    cursor--;
+    len--;
+    emit("\b", 1);
+    emit(buffer + cursor, len - cursor);
+    emit(" ", 1);
+    cursorLeft(len - cursor + 1);
+}
+
+void LineEditor::deleteAtCursor() {
+    if(cursor >= len) return;
+
+    memmove(buffer + cursor, buffer + cursor + 1, len - cursor - 1);
+    len--;
+    emit(buffer + cursor, len - cursor);
+    emit(" ", 1);
+    cursorLeft(len - cursor + 1);
+}
+
+void LineEditor::killToEnd() {
+    if(cursor >= len) return;
+    len = cursor;
+    emit("\x1b[K");
+}
+
+void LineEditor::killLine() {
+    moveTo(0);
+    len = 0;
+    emit("\x1b[K");
+}
+
+void LineEditor::killWord() {
+    int start = cursor;
+    while(start > 0 && buffer[start - 1] == ' ') start--;
+    while(start > 0 && buffer[start - 1] != ' ') start--;
+    int removed = cursor - start;
+    if(removed == 0) return;
+
+    memmove(buffer + start, buffer + cursor, len - cursor);
+    len -= removed;
+    cursorLeft(removed);
+    cursor = start;
+    emit(buffer + cursor, len - cursor);
+    emit("\x1b[K");
+    cursorLeft(len - cursor);
+}
+
+void LineEditor::moveTo(int position) {
+    if(position < cursor) {
+        cursorLeft(cursor - position);
+    } else if(position > cursor) {
+        int n = position - cursor;
+        // Reescribir pocos caracteres cuesta menos que ESC [ n C
+        if(n <= 3) emit(buffer + cursor, n);
+        else cursorRight(n);
+    }
+    cursor = position;
+}
+
+// Sustituye la línea reescribiendo solo lo que cambia
+void LineEditor::replaceLine(const char* text) {
+    int newLen = min((int)strlen(text), MAX_CMD_LENGTH - 1);
+
+    int common = 0;
+    while(common < len && common < newLen && buffer[common] == text[common]) common++;
+
+    moveTo(common);
+    emit(text + common, newLen - common);
+    if(len > newLen) emit("\x1b[K");
+
+    memcpy(buffer, text, newLen);
+    buffer[newLen] = '\0';
+    len = newLen;
+    cursor = newLen;
+}
+
+void LineEditor::historyUp() {
+    if(historyIndex + 1 >= history.count()) return;
+
+    if(historyIndex < 0) {
+        memcpy(saved, buffer, len);
+        saved[len] = '\0';
+    }
+    historyIndex++;
+    replaceLine(history.get(historyIndex));
+}
+
+void LineEditor::historyDown() {
+    if(historyIndex < 0) return;
+
+    historyIndex--;
+    replaceLine(historyIndex < 0 ? saved : history.get(historyIndex));
+}
+
+// ============================================
+// Autocompletado (Tab)
+// ============================================
+
+void LineEditor::complete() {
+    // Palabra que termina en el cursor
+    int start = cursor;
+    while(start > 0 && buffer[start - 1] != ' ') start--;
+    bool firstWord = true;
+    for(int i = 0; i < start; i++) {
+        if(buffer[i] != ' ') {
+            firstWord = false;
+            break;
+        }
+    }
+
+    char word[MAX_PATH_LENGTH];
+    int wordLen = min(cursor - start, (int)sizeof(word) - 1);
+    memcpy(word, buffer + start, wordLen);
+    word[wordLen] = '\0';
+
+    char candidates[COMPLETION_BUFFER];
+    int count;
+    const char* prefix;
+    if(firstWord) {
+        count = completeCommands(word, candidates, sizeof(candidates));
+        prefix = word;
+    } else {
+        const char* cwd = session ? session->currentPath : "/";
+        count = completePath(cwd, word, candidates, sizeof(candidates));
+        const char* slash = strrchr(word, '/');
+        prefix = slash ? slash + 1 : word;
+    }
+    if(count == 0) return;
+
+    // Prefijo común a todos los candidatos
+    const char* first = candidates + 1;
+    int common = strlen(first);
+    const char* entry = first + common + 1;
+    for(int i = 1; i < count; i++) {
+        const char* name = entry + 1;
+        int k = 0;
+        while(k < common && name[k] == first[k]) k++;
+        common = k;
+        entry = name + strlen(name) + 1;
+    }
+
+    int prefixLen = strlen(prefix);
+    for(int i = prefixLen; i < common; i++) {
+        insertChar(first[i]);
+    }
+
+    if(count == 1) {
+        // Coincidencia única: cerrar la palabra
+        if(candidates[0] == COMPLETE_DIR) insertChar('/');
+        else if(cursor == len) insertChar(' ');
+    } else if(common == prefixLen) {
+        // Ambiguo y sin nada que añadir: mostrar las opciones
+        listCandidates(candidates, count);
+        redrawLine();
+    }
+}
+
+static int compareNames(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+// Lista los candidatos ordenados, en columnas según el ancho del terminal
+void LineEditor::listCandidates(const char* packed, int count) {
+    const char* names[COMPLETION_MAX_ITEMS];
+    char types[COMPLETION_MAX_ITEMS];
+    int width = 0;
+
+    const char* entry = packed;
+    for(int i = 0; i < count; i++) {
+        names[i] = entry + 1;
+        int nameLen = strlen(names[i]);
+        width = max(width, nameLen + 1);
+        entry = names[i] + nameLen + 1;
+    }
+    qsort(names, count, sizeof(names[0]), compareNames);
+    for(int i = 0; i < count; i++) {
+        types[i] = names[i][-1];
+    }
+
+    width += 2;
+    int termCols = session ? session->termCols : 80;
+    int columns = max(1, termCols / width);
+    int rows = (count + columns - 1) / columns;
+
+    emit("\r\n", 2);
+    for(int r = 0; r < rows; r++) {
+        for(int c = 0; c < columns; c++) {
+            int i = c * rows + r;
+            if(i >= count) break;
+            int nameLen = strlen(names[i]);
+            emit(names[i], nameLen);
+            if(types[i] == COMPLETE_DIR) {
+                emit("/", 1);
+                nameLen++;
+            }
+            if(c < columns - 1 && i + rows < count) {
+                for(int pad = nameLen; pad < width; pad++) emit(" ", 1);
+            }
+        }
+        emit("\r\n", 2);
+    }
+}
+
+// ============================================
+// Búsqueda incremental inversa (Ctrl-R)
+// ============================================
+
+void LineEditor::startSearch() {
+    searching = true;
+    queryLen = 0;
+    query[0] = '\0';
+    searchIndex = -1;
+    drawSearch();
+}
+
+InputResult LineEditor::searchKey(int key) {
+    switch(key) {
+        case 18:  // Ctrl+R: siguiente coincidencia más antigua
+            if(queryLen > 0) runSearch(searchIndex + 1);
+            break;
+        case 127:
+        case 8:
+            if(queryLen > 0) {
+                query[--queryLen] = '\0';
+                searchIndex = -1;
+                if(queryLen > 0) runSearch(0);
+            }
+            break;
+        case 3:   // Ctrl+C
+        case 7:   // Ctrl+G
+            endSearch(false);
+            return INPUT_NONE;
+        case '\r':
+        case '\n':
+            endSearch(true);
+            return finishLine();
+        default:
+            if(key >= 32 && key < 127) {
+                if(queryLen < HISTORY_SEARCH_MAX - 1) {
+                    query[queryLen++] = (char)key;
+                    query[queryLen] = '\0';
+                }
+                runSearch(searchIndex);
+                break;
+            }
+            // Cualquier otra tecla acepta la coincidencia y se procesa
+            endSearch(true);
+            return handleKey(key);
+    }
+    drawSearch();
+    return INPUT_NONE;
+}
+
+void LineEditor::runSearch(int from) {
+    int found = history.search(query, from);
+    if(found >= 0) searchIndex = found;
+}
+
+void LineEditor::drawSearch() {
+    const char* match = searchIndex >= 0 ? history.get(searchIndex) : "";
+    emit("\r(reverse-i-search)`");
+    emit(query, queryLen);
+    emit("': ");
+    emit(match);
+    emit("\x1b[K");
+}
+
+void LineEditor::endSearch(bool accept) {
+    searching = false;
+    if(accept && searchIndex >= 0) {
+        const char* match = history.get(searchIndex);
+        len = min((int)strlen(match), MAX_CMD_LENGTH - 1);
+        memcpy(buffer, match, len);
+        buffer[len] = '\0';
+        cursor = len;
+    }
+    redrawLine();
+}
+
+// Redibujado completo (solo tras Ctrl-L o la búsqueda)
+void LineEditor::redrawLine() {
+    char prompt[MAX_PATH_LENGTH + 20];
+    int promptLen = session ? session->formatPrompt(prompt, sizeof(prompt)) : 0;
+
+    emit("\r", 1);
+    emit(prompt, promptLen);
+    emit(buffer, len);
+    emit("\x1b[K");
+    cursorLeft(len - cursor);
+}
+
+// ============================================
+// Salida
+// ============================================
+
+void LineEditor::emit(const char* data, size_t n) {
+    if(n > 0 && session && session->echo) {
+        session->echoBytes(data, n);
+    }
+}
+
+void LineEditor::cursorLeft(int n) {
+    if(n <= 0) return;
+    if(n <= 3) {
+        emit("\b\b\b", n);
+        return;
+    }
+    char seq[12];
+    int seqLen = snprintf(seq, sizeof(seq), "\x1b[%dD", n);
+    emit(seq, seqLen);
+}
+
+void LineEditor::cursorRight(int n) {
+    if(n <= 0) return;
+    char seq[12];
+    int seqLen = snprintf(seq, sizeof(seq), "\x1b[%dC", n);
+    emit(seq, seqLen);
+}
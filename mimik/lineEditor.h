@@ -0,0 +1,138 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * lineEditor.h - Edición de línea (ANSI) e historial de comandos
+ */
+
+#ifndef LINE_EDITOR_H
+#define LINE_EDITOR_H
+
+#include <Arduino.h>
+#include "shell.h"
+
+// Historial: anillo de bytes con entradas terminadas en '\0'
+#define HISTORY_BYTES 1024
+// Entradas nuevas antes de escribirlas a la SD
+#define HISTORY_SAVE_BATCH 8
+// Tamaño a partir del cual el archivo se reescribe desde el anillo
+#define HISTORY_FILE_MAX 4096
+#define HISTORY_FILE_SERIAL "/.history_serial"
+#define HISTORY_FILE_TELNET "/.history_telnet"
+#define HISTORY_SEARCH_MAX 32
+
+// Resultado de alimentar un carácter al editor de línea
+enum InputResult {
+    INPUT_NONE = 0,   // Carácter consumido, línea incompleta
+    INPUT_LINE,       // Línea completa disponible
+    INPUT_CANCEL,     // Ctrl+C
+    INPUT_EOF         // Ctrl+D con la línea vacía
+};
+
+class ShellSession;
+
+class CommandHistory {
+public:
+    CommandHistory();
+
+    void clear();
+    void add(const char* line);
+    int count() { return entries; }
+    const char* get(int index);   // 0 = más reciente
+    int search(const char* query, int from);
+
+    bool load(const char* path);
+    bool save(const char* path);
+    int pending() { return unsaved; }
+
+private:
+    char pool[HISTORY_BYTES];
+    size_t used;
+    int entries;
+    int unsaved;
+};
+
+// Editor de línea: cursor, historial (flechas, Ctrl-P/N), búsqueda
+// incremental inversa (Ctrl-R), autocompletado (Tab) y redibujado con
+// movimientos mínimos
+class LineEditor {
+public:
+    LineEditor();
+
+    void attach(ShellSession* owner);
+    void reset();
+    InputResult feed(char c);
+
+    char* line() { buffer[len] = '\0'; return buffer; }
+    int length() { return len; }
+
+    CommandHistory history;
+
+private:
+    enum Key {
+        KEY_NONE = 0,
+        KEY_UP = 1000,
+        KEY_DOWN,
+        KEY_RIGHT,
+        KEY_LEFT,
+        KEY_HOME,
+        KEY_END,
+        KEY_DELETE
+    };
+
+    enum EscapeState {
+        ESC_NONE,
+        ESC_START,   // ESC
+        ESC_CSI,     // ESC [
+        ESC_SS3      // ESC O
+    };
+
+    ShellSession* session;
+
+    char buffer[MAX_CMD_LENGTH];
+    int len;
+    int cursor;
+    char lastChar;
+
+    EscapeState escState;
+    char escParam[4];
+    int escParamLen;
+
+    int historyIndex;              // -1 = línea nueva
+    char saved[MAX_CMD_LENGTH];    // Línea en edición al navegar el historial
+
+    bool searching;
+    char query[HISTORY_SEARCH_MAX];
+    int queryLen;
+    int searchIndex;
+
+    InputResult handleKey(int key);
+    InputResult finishLine();
+    int decodeEscape(char c);
+
+    void insertChar(char c);
+    void backspace();
+    void deleteAtCursor();
+    void killToEnd();
+    void killLine();
+    void killWord();
+    void moveTo(int position);
+    void replaceLine(const char* text);
+    void historyUp();
+    void historyDown();
+
+    void complete();
+    void listCandidates(const char* packed, int count);
+
+    void startSearch();
+    InputResult searchKey(int key);
+    void runSearch(int from);
+    void drawSearch();
+    void endSearch(bool accept);
+    void redrawLine();
+
+    void emit(const char* data, size_t n);
+    void emit(const char* str) { emit(str, strlen(str)); }
+    void cursorLeft(int n);
+    void cursorRight(int n);
+};
+
+#endif
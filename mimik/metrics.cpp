@@ -0,0 +1,277 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * metrics.cpp - Implementación del recolector de métricas
+ */
+
+#include "metrics.h"
+#include "sysLog.h"
+#include <WiFi.h>
+
+Metrics::Ring Metrics::rings[METRICS_LEVELS][METRIC_SERIES];
+Metrics::Accumulator Metrics::accumulators[METRICS_LEVELS][METRIC_SERIES];
+WatchedTask Metrics::tasks[METRICS_MAX_TASKS];
+int Metrics::watchedCount = 0;
+unsigned long Metrics::samples = 0;
+
+static portMUX_TYPE metricsLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Resolución de cada nivel
+struct MetricLevel {
+    unsigned long seconds;
+    uint16_t capacity;
+    uint16_t factor;        // Muestras del nivel anterior por muestra
+};
+
+static const MetricLevel levels[METRICS_LEVELS] = {
+    { 10,  60,  1 },
+    { 60,  60,  6 },
+    { 600, 144, 10 }
+};
+
+static const MetricInfo metricInfo[METRIC_COUNT] = {
+    { "heap_free",  "KB",    1024 },
+    { "heap_min",   "KB",    1024 },
+    { "heap_large", "KB",    1024 },
+    { "psram_free", "KB",    1024 },
+    { "sd_used",    "MB",    1 },
+    { "wifi_rssi",  "dBm",   1 },
+    { "tasks",      "",      1 },
+    { "stack_min",  "B",     1 }
+};
+
+// Bloque para 'series' series en todos los niveles
+int32_t* Metrics::allocate(size_t series) {
+    size_t total = 0;
+    for(int l = 0; l < METRICS_LEVELS; l++) {
+        total += levels[l].capacity * series;
+    }
+    return psramFound() ? (int32_t*)ps_malloc(total * sizeof(int32_t))
+                        : (int32_t*)malloc(total * sizeof(int32_t));
+}
+
+bool Metrics::begin() {
+    // Un único bloque para todos los buffers (los de cada tarea se
+    // reservan al vigilarla)
+    int32_t* block = allocate(METRIC_COUNT);
+    if(!block) {
+        return false;
+    }
+
+    for(int l = 0; l < METRICS_LEVELS; l++) {
+        for(int m = 0; m < METRIC_COUNT; m++) {
+            rings[l][m].data = block;
+            rings[l][m].head = 0;
+            rings[l][m].count = 0;
+            accumulators[l][m] = { 0, 0, 0 };
+            block += levels[l].capacity;
+        }
+    }
+    return true;
+}
+
+// Con metricsLock tomado
+void Metrics::push(int level, int series, int32_t value) {
+    Ring* ring = &rings[level][series];
+    if(!ring->data) return;
+
+    uint16_t capacity = levels[level].capacity;
+    ring->data[ring->head] = value;
+    ring->head = (ring->head + 1) % capacity;
+    if(ring->count < capacity) ring->count++;
+
+    // Acumular hacia el nivel siguiente
+    if(level + 1 >= METRICS_LEVELS) return;
+    Accumulator* acc = &accumulators[level + 1][series];
+    if(value != METRIC_NONE) {
+        acc->sum += value;
+        acc->valid++;
+    }
+    if(++acc->ticks >= levels[level + 1].factor) {
+        int32_t average = acc->valid ? (int32_t)(acc->sum / acc->valid) : METRIC_NONE;
+        *acc = { 0, 0, 0 };
+        push(level + 1, series, average);
+    }
+}
+
+void Metrics::sample(int32_t sdUsedMB) {
+    int32_t values[METRIC_COUNT];
+    values[METRIC_HEAP_FREE] = ESP.getFreeHeap();
+    values[METRIC_HEAP_MIN] = ESP.getMinFreeHeap();
+    values[METRIC_HEAP_LARGEST] = ESP.getMaxAllocHeap();
+    values[METRIC_PSRAM_FREE] = psramFound() ? (int32_t)ESP.getFreePsram() : METRIC_NONE;
+    values[METRIC_SD_USED] = sdUsedMB >= 0 ? sdUsedMB : METRIC_NONE;
+    values[METRIC_WIFI_RSSI] = WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : METRIC_NONE;
+    values[METRIC_TASKS] = uxTaskGetNumberOfTasks();
+
+    values[METRIC_STACK_MIN] = sampleStacks();
+
+    portENTER_CRITICAL(&metricsLock);
+    for(int m = 0; m < METRIC_COUNT; m++) {
+        push(0, m, values[m]);
+    }
+    for(int i = 0; i < watchedCount; i++) {
+        push(0, METRIC_COUNT + i, tasks[i].freeNow);
+    }
+    samples++;
+    portEXIT_CRITICAL(&metricsLock);
+}
+
+void Metrics::watchTask(const char* name, TaskHandle_t handle, uint32_t stackSize) {
+    if(!handle) return;
+    // Sin memoria para su serie la tarea se vigila igual (sin historia)
+    int32_t* block = watchedCount < METRICS_MAX_TASKS ? allocate(1) : nullptr;
+    portENTER_CRITICAL(&metricsLock);
+    if(watchedCount < METRICS_MAX_TASKS) {
+        tasks[watchedCount] = { name, handle, stackSize, 0, UINT32_MAX, nullptr, nullptr, false };
+        int series = METRIC_COUNT + watchedCount;
+        for(int l = 0; l < METRICS_LEVELS; l++) {
+            rings[l][series].data = block;
+            rings[l][series].head = 0;
+            rings[l][series].count = 0;
+            accumulators[l][series] = { 0, 0, 0 };
+            if(block) block += levels[l].capacity;
+        }
+        block = nullptr;
+        watchedCount++;
+    }
+    portEXIT_CRITICAL(&metricsLock);
+    free(block);
+}
+
+bool Metrics::stackLow(const WatchedTask* task) {
+    uint32_t threshold = max((uint32_t)STACK_WARN_BYTES, task->stackSize * STACK_WARN_PERCENT / 100);
+    return task->freeMin < threshold;
+}
+
+// Actualiza el mínimo de una tarea. El high-water mark de FreeRTOS no
+// baja nunca, así que el comando en curso cuando baja es el más profundo
+// visto en esa tarea. Sin 'command' (muestreo periódico) se atribuye al
+// que esté ejecutando la tarea. Avisa (una vez por mínimo) si el margen
+// es escaso.
+bool Metrics::noteStack(WatchedTask* task, uint32_t free, const char* command) {
+    bool warn = false;
+    portENTER_CRITICAL(&metricsLock);
+    task->freeNow = free;
+    if(free < task->freeMin) {
+        task->freeMin = free;
+        task->deepest = command ? command : task->running;
+        task->warned = false;
+    }
+    if(!task->warned && stackLow(task)) {
+        task->warned = true;
+        warn = true;
+    }
+    portEXIT_CRITICAL(&metricsLock);
+
+    if(warn) {
+        SysLog::warn("stack", "%s margin %u of %u bytes (deepest: %s)",
+                     task->name, (unsigned)free, (unsigned)task->stackSize,
+                     task->deepest ? task->deepest : "-");
+    }
+    return warn;
+}
+
+// Stack libre de las tareas vigiladas (en el ESP32, en bytes).
+// Devuelve el menor o METRIC_NONE.
+int32_t Metrics::sampleStacks() {
+    int32_t stackMin = METRIC_NONE;
+    int count = watchedCount;
+    for(int i = 0; i < count; i++) {
+        WatchedTask* task = &tasks[i];
+        uint32_t free = uxTaskGetStackHighWaterMark(task->handle);
+        noteStack(task, free, nullptr);
+        if(stackMin == METRIC_NONE || (int32_t)free < stackMin) stackMin = free;
+    }
+    return stackMin;
+}
+
+WatchedTask* Metrics::currentTask() {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int count = watchedCount;
+    for(int i = 0; i < count; i++) {
+        if(tasks[i].handle == self) return &tasks[i];
+    }
+    return nullptr;
+}
+
+const char* Metrics::commandStarted(const char* command) {
+    WatchedTask* task = currentTask();
+    if(!task) return nullptr;
+    portENTER_CRITICAL(&metricsLock);
+    const char* outer = task->running;
+    task->running = command;
+    portEXIT_CRITICAL(&metricsLock);
+    return outer;
+}
+
+void Metrics::commandFinished(const char* outer) {
+    WatchedTask* task = currentTask();
+    if(!task) return;
+    portENTER_CRITICAL(&metricsLock);
+    task->running = outer;
+    portEXIT_CRITICAL(&metricsLock);
+}
+
+bool Metrics::checkStack(const char* command) {
+    WatchedTask* task = currentTask();
+    if(!task) return false;
+    return noteStack(task, uxTaskGetStackHighWaterMark(NULL), command);
+}
+
+uint32_t Metrics::recommendStack(const WatchedTask* task) {
+    if(task->freeMin == UINT32_MAX || task->freeMin > task->stackSize) return 0;
+    uint32_t used = task->stackSize - task->freeMin;
+    uint32_t size = used + max((uint32_t)STACK_HEADROOM_MIN, used / 4);
+    return (size + STACK_ROUND - 1) / STACK_ROUND * STACK_ROUND;
+}
+
+int Metrics::read(int level, MetricId metric, int32_t* out, int maxCount) {
+    if(metric >= METRIC_COUNT) return 0;
+    return readSeries(level, metric, out, maxCount);
+}
+
+int Metrics::readTask(int level, int task, int32_t* out, int maxCount) {
+    if(task < 0 || task >= watchedCount) return 0;
+    return readSeries(level, METRIC_COUNT + task, out, maxCount);
+}
+
+int Metrics::readSeries(int level, int series, int32_t* out, int maxCount) {
+    if(level < 0 || level >= METRICS_LEVELS) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&metricsLock);
+    const Ring* ring = &rings[level][series];
+    uint16_t capacity = levels[level].capacity;
+    int n = min((int)ring->count, maxCount);
+    int start = (ring->head + capacity - n) % capacity;
+    for(int i = 0; i < n; i++) {
+        out[i] = ring->data[(start + i) % capacity];
+    }
+    portEXIT_CRITICAL(&metricsLock);
+    return n;
+}
+
+const MetricInfo* Metrics::info(MetricId metric) {
+    return &metricInfo[metric];
+}
+
+unsigned long Metrics::levelSeconds(int level) {
+    return levels[level].seconds;
+}
+
+int Metrics::levelCapacity(int level) {
+    return levels[level].capacity;
+}
+
+int Metrics::taskCount() {
+    return watchedCount;
+}
+
+bool Metrics::getTask(int index, WatchedTask* out) {
+    if(index < 0 || index >= watchedCount) return false;
+    portENTER_CRITICAL(&metricsLock);
+    *out = tasks[index];
+    portEXIT_CRITICAL(&metricsLock);
+    return true;
+}
@@ -0,0 +1,143 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * metrics.h - Series temporales de recursos (stats)
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Periodo de muestreo de sdMonitorTask
+#define METRICS_INTERVAL_MS 10000
+
+// Resoluciones: cada nivel guarda la media de N muestras del anterior
+//   0: 10 s  x 60  = 10 minutos
+//   1: 1 min x 60  = 1 hora
+//   2: 10 min x 144 = 24 horas
+#define METRICS_LEVELS 3
+
+// Tareas cuyo stack libre se vigila (cada una con su propia serie)
+#define METRICS_MAX_TASKS 12
+
+// Aviso de stack: margen libre por debajo de STACK_WARN_BYTES o de
+// STACK_WARN_PERCENT del tamaño (lo mayor)
+#define STACK_WARN_BYTES 512
+#define STACK_WARN_PERCENT 10
+// Holgura de las recomendaciones de 'stacks': max(1 KB, 25% de lo usado),
+// redondeado a 512 bytes
+#define STACK_HEADROOM_MIN 1024
+#define STACK_ROUND 512
+
+// Marca de "sin dato" (p. ej. RSSI sin WiFi)
+#define METRIC_NONE INT32_MIN
+
+enum MetricId {
+    METRIC_HEAP_FREE = 0,   // bytes
+    METRIC_HEAP_MIN,        // bytes (mínimo histórico de heap libre)
+    METRIC_HEAP_LARGEST,    // bytes (mayor bloque libre: fragmentación)
+    METRIC_PSRAM_FREE,      // bytes
+    METRIC_SD_USED,         // MB
+    METRIC_WIFI_RSSI,       // dBm
+    METRIC_TASKS,           // tareas de FreeRTOS
+    METRIC_STACK_MIN,       // bytes (menor stack libre de las vigiladas)
+    METRIC_COUNT
+};
+
+// Series guardadas: las de MetricId y, detrás, el stack libre de cada
+// tarea vigilada
+#define METRIC_SERIES (METRIC_COUNT + METRICS_MAX_TASKS)
+
+struct MetricInfo {
+    const char* name;
+    const char* unit;
+    int32_t divisor;        // Para mostrar (bytes -> KB)
+};
+
+struct WatchedTask {
+    const char* name;
+    TaskHandle_t handle;
+    uint32_t stackSize;     // Bytes con los que se creó la tarea
+    uint32_t freeNow;       // Stack libre en la última muestra
+    uint32_t freeMin;       // Mínimo visto
+    const char* deepest;    // Comando durante el que bajó el mínimo
+    const char* running;    // Comando en curso en la tarea (o nullptr)
+    bool warned;            // Ya se avisó de este mínimo
+};
+
+// Las muestras se guardan en buffers circulares de tamaño fijo
+// reservados una sola vez (en PSRAM si la hay); nada se escribe en la
+// SD. Los niveles gruesos permiten ver tendencias (fugas de memoria)
+// en equipos que llevan días encendidos.
+class Metrics {
+public:
+    static bool begin();
+
+    // Llamado por sdMonitorTask cada METRICS_INTERVAL_MS.
+    // sdUsedMB < 0 si la SD no está disponible.
+    static void sample(int32_t sdUsedMB);
+
+    // Registrar una tarea para vigilar su stack
+    static void watchTask(const char* name, TaskHandle_t handle, uint32_t stackSize);
+
+    // Alrededor de cada comando (executeLine): el muestreo periódico
+    // atribuye una bajada del mínimo al comando en curso en esa tarea.
+    // commandStarted devuelve el anterior (los scripts anidan comandos)
+    // para restaurarlo con commandFinished.
+    static const char* commandStarted(const char* command);
+    static void commandFinished(const char* outer);
+
+    // Tras cada comando (executeLine): mínimo de stack de la tarea actual
+    // y comando responsable. Devuelve true si el margen acaba de caer por
+    // debajo del umbral de aviso.
+    static bool checkStack(const char* command);
+    static int32_t sampleStacks();
+
+    // Tamaño recomendado para una tarea vigilada (0 si no hay datos)
+    static uint32_t recommendStack(const WatchedTask* task);
+    static bool stackLow(const WatchedTask* task);
+
+    // Copia las últimas muestras del nivel (más antigua primero).
+    // Devuelve cuántas se copiaron.
+    static int read(int level, MetricId metric, int32_t* out, int maxCount);
+    // Lo mismo para el stack libre (bytes) de la tarea vigilada 'task'
+    static int readTask(int level, int task, int32_t* out, int maxCount);
+
+    static const MetricInfo* info(MetricId metric);
+    static unsigned long levelSeconds(int level);
+    static int levelCapacity(int level);
+    static unsigned long sampleCount() { return samples; }
+
+    static int taskCount();
+    static bool getTask(int index, WatchedTask* out);
+
+private:
+    struct Ring {
+        int32_t* data;
+        uint16_t head;      // Próxima posición a escribir
+        uint16_t count;
+    };
+
+    // Acumulador para pasar de un nivel al siguiente
+    struct Accumulator {
+        int64_t sum;
+        uint16_t valid;
+        uint16_t ticks;
+    };
+
+    static Ring rings[METRICS_LEVELS][METRIC_SERIES];
+    static Accumulator accumulators[METRICS_LEVELS][METRIC_SERIES];
+    static WatchedTask tasks[METRICS_MAX_TASKS];
+    static int watchedCount;
+    static unsigned long samples;
+
+    static void push(int level, int series, int32_t value);
+    static int readSeries(int level, int series, int32_t* out, int maxCount);
+    static int32_t* allocate(size_t series);
+    static bool noteStack(WatchedTask* task, uint32_t free, const char* command);
+    static WatchedTask* currentTask();
+};
+
+#endif
@@ -22,15 +22,21 @@
  */
 
 #include "shell.h"
+#include "sysLog.h"
 
 // Declaraciones externas
 extern bool initShellTasks();
+extern void startShell();
 
 void setup() {
-    // Inicializar Serial
+    // Inicializar Serial (el buffer de recepción se fija antes de begin)
+    Serial.setRxBufferSize(SERIAL_RX_BUFFER);
     Serial.begin(115200);
     delay(1000);
     
+    // Registro del sistema antes que nada (dmesg)
+    SysLog::begin();
+    
     Serial.println("\n\n");
     Serial.println("====================================");
     Serial.println("  ███╗   ███╗██╗███╗   ███╗██╗██╗  ██╗");
@@ -68,8 +74,11 @@ void setup() {
     Serial.println("╚═══════════════════════════════════════╝");
     Serial.println();
     
-    // Mostrar prompt inicial
-    shell.printPrompt();
+    // A partir de aquí la consola solo muestra errores; el resto, con dmesg
+    SysLog::setConsoleLevel(SYSLOG_ERROR);
+    
+    // Script de arranque (si existe) y prompt inicial
+    startShell();
 }
 
 void loop() {
@@ -5,9 +5,308 @@
 
 #include "shell.h"
 #include "sshServer.h"
+#include "shellSession.h"
+#include "telnetProtocol.h"
+#include "jobManager.h"
+#include "metrics.h"
+#include "sdSpace.h"
+#include "profiler.h"
+#include "tracer.h"
+#include "commandExecutor.h"
+#include "bufferPool.h"
+#include "sysLog.h"
+#include "completion.h"
+#include <esp_heap_caps.h>
+
+// ============================================
+// top -d: vista en vivo con redibujado diferencial
+// ============================================
+
+#define TOP_MAX_COLS 100
+#define TOP_MAX_ROWS 40
+#define TOP_MAX_TASKS 32
+
+#ifdef configRUN_TIME_COUNTER_TYPE
+typedef configRUN_TIME_COUNTER_TYPE RunTimeCounter;
+#else
+typedef uint32_t RunTimeCounter;
+#endif
+
+// CPU% sale de ulRunTimeCounter: sin contadores de run-time vale 0 en
+// todas las tareas y la carga saldría al 100%
+#if configGENERATE_RUN_TIME_STATS == 1
+#define TOP_CPU_STATS 1
+#else
+#define TOP_CPU_STATS 0
+#endif
+
+// Frame actual y el último enviado, como texto de ancho fijo
+struct TopScreen {
+    int cols;
+    int rows;
+    char* current;
+    char* previous;
+};
+
+// Escribe la fila 'row' del frame rellenando con espacios
+static void topLine(TopScreen* screen, int row, const char* format, ...) {
+    if(row >= screen->rows) return;
+    char text[TOP_MAX_COLS + 1];
+    va_list ap;
+    va_start(ap, format);
+    int len = vsnprintf(text, sizeof(text), format, ap);
+    va_end(ap);
+    if(len < 0) len = 0;
+    if(len > screen->cols) len = screen->cols;
+    
+    char* line = screen->current + row * screen->cols;
+    memcpy(line, text, len);
+    memset(line + len, ' ', screen->cols - len);
+}
+
+// Envía solo los tramos que cambiaron respecto al frame anterior.
+// Tramos separados por menos de 8 caracteres iguales se juntan: el
+// salto de cursor cuesta casi lo mismo que reescribirlos.
+static void topFlush(TopScreen* screen) {
+    char escape[16];
+    for(int row = 0; row < screen->rows; row++) {
+        const char* cur = screen->current + row * screen->cols;
+        const char* prev = screen->previous + row * screen->cols;
+        int col = 0;
+        while(col < screen->cols) {
+            if(cur[col] == prev[col]) {
+                col++;
+                continue;
+            }
+            int start = col, end = col, same = 0;
+            for(col++; col < screen->cols; col++) {
+                if(cur[col] != prev[col]) {
+                    end = col;
+                    same = 0;
+                } else if(++same >= 8) {
+                    break;
+                }
+            }
+            int n = snprintf(escape, sizeof(escape), "\x1b[%d;%dH", row + 1, start + 1);
+            ShellOutput::write((const uint8_t*)escape, n);
+            ShellOutput::write((const uint8_t*)cur + start, end - start + 1);
+        }
+    }
+    memcpy(screen->previous, screen->current, screen->rows * screen->cols);
+    ShellOutput::flush();
+}
+
+static void topBar(char* bar, int width, int permille) {
+    int filled = constrain(permille, 0, 1000) * width / 1000;
+    for(int i = 0; i < width; i++) {
+        bar[i] = i < filled ? '#' : '-';
+    }
+    bar[width] = '\0';
+}
+
+static const char* topState(eTaskState state) {
+    switch(state) {
+        case eRunning:   return "run";
+        case eReady:     return "ready";
+        case eBlocked:   return "block";
+        case eSuspended: return "susp";
+        default:         return "-";
+    }
+}
+
+// Espera 'ms' atendiendo a 'q' y Ctrl+C. Devuelve false para salir.
+static bool topWait(ShellSession* session, unsigned long ms) {
+    unsigned long start = millis();
+    while(millis() - start < ms) {
+        int input;
+        while((input = session->readInput()) >= 0) {
+            if(input == 'q' || input == 'Q' || input == 3) return false;
+        }
+        if(!session->sleep(min(ms - (millis() - start), 100UL))) return false;
+    }
+    return true;
+}
+
+static ShellError liveTop(unsigned long interval) {
+#if configUSE_TRACE_FACILITY == 1
+    ShellSession* session = ShellSession::current();
+    TopScreen screen;
+    screen.cols = constrain(session->termCols, 40, TOP_MAX_COLS);
+    screen.rows = constrain(session->termRows - 1, 10, TOP_MAX_ROWS);
+    
+    size_t frameBytes = screen.rows * screen.cols;
+    screen.current = (char*)malloc(frameBytes);
+    screen.previous = (char*)malloc(frameBytes);
+    TaskStatus_t* tasks = (TaskStatus_t*)malloc(TOP_MAX_TASKS * sizeof(TaskStatus_t));
+    TaskHandle_t* lastHandles = (TaskHandle_t*)malloc(TOP_MAX_TASKS * sizeof(TaskHandle_t));
+    RunTimeCounter* lastRuntime = (RunTimeCounter*)malloc(TOP_MAX_TASKS * sizeof(RunTimeCounter));
+    if(!screen.current || !screen.previous || !tasks || !lastHandles || !lastRuntime) {
+        free(screen.current);
+        free(screen.previous);
+        free(tasks);
+        free(lastHandles);
+        free(lastRuntime);
+        ShellOutput::println("ERROR: Not enough memory");
+        return SHELL_ERR_NO_SPACE;
+    }
+    
+    // Pantalla limpia = frame anterior en blanco
+    memset(screen.previous, ' ', frameBytes);
+    ShellOutput::print("\x1b[?25l\x1b[2J");
+    
+    // Muestra inicial: el primer frame llega enseguida
+    RunTimeCounter lastTotal = 0;
+    int lastCount = uxTaskGetSystemState(tasks, TOP_MAX_TASKS, &lastTotal);
+    for(int i = 0; i < lastCount; i++) {
+        lastHandles[i] = tasks[i].xHandle;
+        lastRuntime[i] = tasks[i].ulRunTimeCounter;
+    }
+    unsigned long wait = min(interval, 500UL);
+    
+    uint16_t cpu[TOP_MAX_TASKS];
+    uint8_t order[TOP_MAX_TASKS];
+    
+    while(topWait(session, wait)) {
+        wait = interval;
+        
+        RunTimeCounter total = 0;
+        int count = uxTaskGetSystemState(tasks, TOP_MAX_TASKS, &total);
+        RunTimeCounter elapsed = TOP_CPU_STATS ? total - lastTotal : 0;
+        
+        // CPU% (en décimas) de cada tarea desde el frame anterior. La
+        // carga de cada core es lo que no consumió su tarea IDLE.
+        int idle[portNUM_PROCESSORS];
+        for(int c = 0; c < portNUM_PROCESSORS; c++) idle[c] = -1;
+        for(int i = 0; i < count; i++) {
+            RunTimeCounter previous = tasks[i].ulRunTimeCounter;
+            for(int j = 0; j < lastCount; j++) {
+                if(lastHandles[j] == tasks[i].xHandle) {
+                    previous = lastRuntime[j];
+                    break;
+                }
+            }
+            RunTimeCounter used = tasks[i].ulRunTimeCounter - previous;
+            cpu[i] = elapsed ? min((uint64_t)used * 1000 / elapsed, (uint64_t)1000) : 0;
+            order[i] = i;
+            
+            const char* name = tasks[i].pcTaskName;
+            if(strncmp(name, "IDLE", 4) == 0) {
+                int core = name[4] >= '0' && name[4] < '0' + portNUM_PROCESSORS ? name[4] - '0' : 0;
+                idle[core] = cpu[i];
+            }
+        }
+        for(int i = 0; i < count; i++) {
+            lastHandles[i] = tasks[i].xHandle;
+            lastRuntime[i] = tasks[i].ulRunTimeCounter;
+        }
+        lastCount = count;
+        lastTotal = total;
+        
+        // Ordenar por CPU% descendente
+        for(int i = 1; i < count; i++) {
+            uint8_t key = order[i];
+            int j = i - 1;
+            while(j >= 0 && cpu[order[j]] < cpu[key]) {
+                order[j + 1] = order[j];
+                j--;
+            }
+            order[j + 1] = key;
+        }
+        
+        // Componer el frame
+        unsigned long seconds = millis() / 1000;
+        int row = 0;
+        topLine(&screen, row++, "mimik top - up %02lu:%02lu:%02lu, every %lu s, %d tasks    (q or Ctrl-C to quit)",
+                seconds / 3600, (seconds / 60) % 60, seconds % 60, interval / 1000, count);
+        
+        char line[TOP_MAX_COLS + 1];
+        int pos = 0;
+        if(!TOP_CPU_STATS) {
+            snprintf(line, sizeof(line), "CPU%%   unavailable (FreeRTOS run-time stats disabled)");
+        }
+        for(int c = 0; c < portNUM_PROCESSORS && TOP_CPU_STATS; c++) {
+            char bar[11];
+            if(elapsed && idle[c] >= 0) {
+                int load = 1000 - idle[c];
+                topBar(bar, 10, load);
+                pos += snprintf(line + pos, sizeof(line) - pos, "CPU%d %3d.%d%% [%s]   ",
+                                c, load / 10, load % 10, bar);
+            } else {
+                pos += snprintf(line + pos, sizeof(line) - pos, "CPU%d    -   [----------]   ", c);
+            }
+            if(pos >= (int)sizeof(line)) break;
+        }
+        topLine(&screen, row++, "%s", line);
+        
+        uint32_t freeHeap = ESP.getFreeHeap();
+        uint32_t largest = ESP.getMaxAllocHeap();
+        topLine(&screen, row++, "Heap   free %6u KB  min %6u KB  largest %6u KB  frag %3u%%",
+                freeHeap / 1024, ESP.getMinFreeHeap() / 1024, largest / 1024,
+                freeHeap ? 100 - (uint32_t)((uint64_t)largest * 100 / freeHeap) : 0);
+        if(psramFound()) {
+            uint32_t freePsram = ESP.getFreePsram();
+            uint32_t largestPsram = ESP.getMaxAllocPsram();
+            topLine(&screen, row++, "PSRAM  free %6u KB  min %6u KB  largest %6u KB  frag %3u%%",
+                    freePsram / 1024, ESP.getMinFreePsram() / 1024, largestPsram / 1024,
+                    freePsram ? 100 - (uint32_t)((uint64_t)largestPsram * 100 / freePsram) : 0);
+        } else {
+            topLine(&screen, row++, "PSRAM  not available");
+        }
+        topLine(&screen, row++, "");
+        topLine(&screen, row++, "TASK              CORE  PRI  STATE    CPU%%  STACK FREE");
+        
+        for(int k = 0; k < count && row < screen.rows; k++) {
+            const TaskStatus_t* task = &tasks[order[k]];
+            char core[4] = "-";
+#ifdef CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+            if(task->xCoreID == tskNO_AFFINITY) strcpy(core, "*");
+            else snprintf(core, sizeof(core), "%d", (int)task->xCoreID);
+#endif
+            int value = cpu[order[k]];
+            if(elapsed) {
+                topLine(&screen, row++, "%-16s  %4s  %3u  %-5s  %3d.%d  %10u",
+                        task->pcTaskName, core, (unsigned)task->uxCurrentPriority,
+                        topState(task->eCurrentState), value / 10, value % 10,
+                        (unsigned)task->usStackHighWaterMark);
+            } else {
+                topLine(&screen, row++, "%-16s  %4s  %3u  %-5s      -  %10u",
+                        task->pcTaskName, core, (unsigned)task->uxCurrentPriority,
+                        topState(task->eCurrentState), (unsigned)task->usStackHighWaterMark);
+            }
+        }
+        while(row < screen.rows) {
+            topLine(&screen, row++, "");
+        }
+        
+        topFlush(&screen);
+    }
+    
+    // Dejar el cursor debajo del frame
+    ShellOutput::printf("\x1b[%d;1H\x1b[?25h\n", screen.rows + 1);
+    free(screen.current);
+    free(screen.previous);
+    free(tasks);
+    free(lastHandles);
+    free(lastRuntime);
+    return SHELL_OK;
+#else
+    ShellOutput::println("ERROR: Live mode needs the FreeRTOS trace facility");
+    return SHELL_ERR_PERMISSION;
+#endif
+}
 
 // Comando: top - Mostrar uso de recursos del sistema
+// 'top -d <seg>' refresca en vivo hasta pulsar q o Ctrl+C
 ShellError MiniShell::cmd_top(CommandArgs args) {
+    if(args.argc > 1) {
+        long seconds = args.argc > 2 ? atol(args.argv[2]) : 0;
+        if(strcmp(args.argv[1], "-d") != 0 || seconds <= 0) {
+            ShellOutput::println("Usage: top [-d <seconds>]");
+            return SHELL_ERR_INVALID_ARGS;
+        }
+        return liveTop(seconds * 1000UL);
+    }
+    
     ShellOutput::println("\n=== System Resources Monitor ===\n");
     
     // Información de CPU
@@ -96,12 +395,13 @@ ShellError MiniShell::cmd_top(CommandArgs args) {
     ShellOutput::println("Storage (SD Card):");
     ShellOutput::println("-------------------------------");
     
-    if(SD_MMC.cardType() != CARD_NONE) {
+    // Contador incremental: no recorre la FAT (ver SdSpace)
+    if(SD_MMC.cardType() != CARD_NONE && SdSpace::known()) {
         uint64_t cardSize = SD_MMC.cardSize();
-        uint64_t totalBytes = SD_MMC.totalBytes();
-        uint64_t usedBytes = SD_MMC.usedBytes();
-        uint64_t freeBytes = totalBytes - usedBytes;
-        uint32_t sdPercent = (usedBytes * 100) / totalBytes;
+        uint64_t totalBytes = SdSpace::total();
+        uint64_t usedBytes = SdSpace::used();
+        uint64_t freeBytes = SdSpace::available();
+        uint32_t sdPercent = totalBytes ? (usedBytes * 100) / totalBytes : 0;
         
         ShellOutput::printf("  Total:      %llu MB\n", cardSize / (1024 * 1024));
         ShellOutput::printf("  Used:       %llu MB\n", usedBytes / (1024 * 1024));
@@ -116,12 +416,41 @@ ShellError MiniShell::cmd_top(CommandArgs args) {
             else ShellOutput::print("-");
         }
         ShellOutput::println("]");
+        ShellOutput::printf("  Counted:    %lu s ago (scan %lu ms, drift %lld KB)\n",
+                            SdSpace::age() / 1000, SdSpace::lastScanMs(),
+                            (long long)(SdSpace::lastDrift() / 1024));
+    } else if(SD_MMC.cardType() != CARD_NONE) {
+        ShellOutput::println("  Status:     Counting (first scan pending)");
     } else {
         ShellOutput::println("  Status:     Not available");
     }
     
     ShellOutput::println();
     
+    // Pools de buffers (solo los que se han usado o tienen bloques)
+    ShellOutput::println("Buffer Pools:");
+    ShellOutput::println("-------------------------------");
+    ShellOutput::println("  POOL     MEMORY  BLOCK  ALLOC/MAX  USED  PEAK    HITS  MISSES  FAILS");
+    PoolStats pool;
+    int poolsShown = 0;
+    for(int i = 0; i < POOL_COUNT; i++) {
+        if(!BufferPool::getStats(i, &pool) || pool.capacity == 0) continue;
+        if(pool.hits + pool.misses + pool.failures == 0) continue;
+        char block[8];
+        if(pool.blockSize) snprintf(block, sizeof(block), "%uK", (unsigned)(pool.blockSize / 1024));
+        else strcpy(block, "-");
+        ShellOutput::printf("  %-8s %-6s %6s  %4u/%-4u %5u %5u %7lu %7lu %6lu\n",
+                            pool.name, pool.memory, block, pool.allocated, pool.capacity,
+                            pool.inUse, pool.peakInUse, (unsigned long)pool.hits,
+                            (unsigned long)pool.misses, (unsigned long)pool.failures);
+        poolsShown++;
+    }
+    if(poolsShown == 0) {
+        ShellOutput::println("  (no buffers requested yet)");
+    }
+    
+    ShellOutput::println();
+    
     // Información de tareas (opcional)
     ShellOutput::println("Tasks:");
     ShellOutput::println("-------------------------------");
@@ -132,4 +461,541 @@ ShellError MiniShell::cmd_top(CommandArgs args) {
     ShellOutput::println();
     
     return SHELL_OK;
-}
\ No newline at end of file
+}
+
+// Comando: who - Listar sesiones activas
+ShellError MiniShell::cmd_who(CommandArgs args) {
+    ShellSession* self = ShellSession::current();
+    unsigned long now = millis();
+    
+    ShellOutput::println("\n=== Shell Sessions ===\n");
+    ShellOutput::println("  ID  TYPE    FROM              CWD                  IDLE  ZIP    COMMAND");
+    ShellOutput::println("-------------------------------------------------------------------------------");
+    
+    int n = ShellSession::count();
+    for(int i = 0; i < n; i++) {
+        ShellSession* s = ShellSession::get(i);
+        if(!s) continue;
+        
+        // Ratio de compresión MCCP2 de la sesión
+        char zip[8] = "-";
+        TelnetProtocol* telnet = s->telnet;
+        if(telnet && telnet->zipOut() > 0) {
+            snprintf(zip, sizeof(zip), "%.1fx", (float)telnet->zipIn() / telnet->zipOut());
+        }
+        
+        const Command* running = s->runningCommand;
+        ShellOutput::printf("%c%3d  %-6s  %-16s  %-20s %4lus  %-5s  %s\n",
+                            s == self ? '*' : ' ',
+                            s->id,
+                            s->type == ShellSession::SESSION_TELNET ? "telnet" :
+                            s->type == ShellSession::SESSION_JOB ? "job" : "serial",
+                            s->peer,
+                            s->currentPath,
+                            (now - s->lastActivity) / 1000,
+                            zip,
+                            running ? running->name : "-");
+    }
+    
+    ShellOutput::printf("\nTelnet sessions: %d/%d\n", sshServer.activeSessions(), MAX_CLIENTS);
+    ShellOutput::println();
+    return SHELL_OK;
+}
+
+// Comando: jobs - Listar trabajos en segundo plano
+ShellError MiniShell::cmd_jobs(CommandArgs args) {
+    unsigned long now = millis();
+    int n = JobManager::count();
+    if(n == 0) {
+        ShellOutput::println("No background jobs");
+        return SHELL_OK;
+    }
+    
+    ShellOutput::println("  ID  STATE     TIME      OUTPUT  COMMAND");
+    ShellOutput::println("-------------------------------------------------------");
+    for(int i = 0; i < n; i++) {
+        Job* job = JobManager::get(i);
+        if(!job) continue;
+        
+        unsigned long elapsed = 0;
+        if(job->state == JOB_RUNNING) elapsed = now - job->startedAt;
+        else if(job->state == JOB_DONE && job->startedAt) elapsed = job->endedAt - job->startedAt;
+        
+        ShellOutput::printf("%4d  %-8s  %5lu.%lus  %5uB  %s\n",
+                            job->id,
+                            JobManager::stateName(job),
+                            elapsed / 1000, (elapsed % 1000) / 100,
+                            (unsigned)job->output.available(),
+                            job->line);
+    }
+    return SHELL_OK;
+}
+
+// Comando: fg - Mostrar la salida de un trabajo y seguirlo hasta que termine
+// Ctrl+C lo cancela, Ctrl+Z vuelve al prompt dejándolo en segundo plano
+ShellError MiniShell::cmd_fg(CommandArgs args) {
+    Job* job = args.argc > 1 ? JobManager::find(atoi(args.argv[1])) : JobManager::latest();
+    if(!job) {
+        ShellOutput::println("ERROR: No such job");
+        return SHELL_ERR_NOT_FOUND;
+    }
+    
+    if(job->attached) {
+        ShellOutput::println("ERROR: Job is attached to another session");
+        return SHELL_ERR_PERMISSION;
+    }
+    
+    ShellSession* session = ShellSession::current();
+    job->attached = true;
+    ShellOutput::printf("[%d] %s\n", job->id, job->line);
+    
+    uint8_t buffer[128];
+    while(true) {
+        size_t len = job->output.read(buffer, sizeof(buffer));
+        if(len > 0) {
+            ShellOutput::write(buffer, len);
+            continue;
+        }
+        if(job->state == JOB_DONE && job->output.available() == 0) {
+            break;
+        }
+        ShellOutput::flush();
+        
+        int input;
+        while((input = session->readInput()) >= 0) {
+            if(input == 3) {
+                JobManager::kill(job->id);
+                ShellOutput::println("^C");
+            } else if(input == 26) {
+                job->attached = false;
+                ShellOutput::printf("\n[%d] %s (still in background)\n", job->id, JobManager::stateName(job));
+                return SHELL_OK;
+            }
+        }
+        // Ctrl+C visto por el vigilante o plazo de 'timeout' vencido
+        if(session->interrupted() && !job->cancel) {
+            JobManager::kill(job->id);
+            ShellOutput::println("^C");
+        }
+        delay(20);
+    }
+    
+    if(job->output.dropped() > 0) {
+        ShellOutput::printf("[%d] %lu bytes of earlier output were dropped\n", job->id, job->output.dropped());
+    }
+    ShellOutput::printf("[%d] %s (code %d)\n", job->id, JobManager::stateName(job), job->result);
+    
+    ShellError result = job->result;
+    JobManager::release(job);
+    return result;
+}
+
+// Comando: kill - Cancelar un trabajo en segundo plano
+ShellError MiniShell::cmd_kill(CommandArgs args) {
+    int id = atoi(args.argv[1][0] == '%' ? args.argv[1] + 1 : args.argv[1]);
+    if(!JobManager::kill(id)) {
+        ShellOutput::println("ERROR: No such job");
+        return SHELL_ERR_NOT_FOUND;
+    }
+    ShellOutput::printf("[%d] cancel requested\n", id);
+    return SHELL_OK;
+}
+
+// Rampa de la sparkline (ASCII para cualquier terminal)
+static const char sparkRamp[] = "_.,-=+*#";
+
+// Sparkline de las últimas 'width' muestras entre minValue y maxValue
+static void printSpark(const int32_t* values, int n, int width, int32_t minValue, int32_t maxValue) {
+    int first = n > width ? n - width : 0;
+    int32_t range = maxValue - minValue;
+    for(int i = first; i < n; i++) {
+        if(values[i] == METRIC_NONE) {
+            ShellOutput::print(' ');
+            continue;
+        }
+        int index = range > 0 ? (int)((int64_t)(values[i] - minValue) * 7 / range) : 3;
+        ShellOutput::print(sparkRamp[index]);
+    }
+    ShellOutput::println();
+}
+
+// Comando: stats - Series de métricas (min/avg/max y tendencia)
+ShellError MiniShell::cmd_stats(CommandArgs args) {
+    int level = 0;
+    if(args.argc > 1) {
+        if(strcmp(args.argv[1], "10s") == 0) level = 0;
+        else if(strcmp(args.argv[1], "1m") == 0) level = 1;
+        else if(strcmp(args.argv[1], "10m") == 0) level = 2;
+        else {
+            ShellOutput::println("Usage: stats [10s|1m|10m]");
+            return SHELL_ERR_INVALID_ARGS;
+        }
+    }
+    
+    unsigned long step = Metrics::levelSeconds(level);
+    unsigned long span = step * Metrics::levelCapacity(level);
+    ShellOutput::printf("\n=== Metrics (every %lu s, last %lu min) ===\n\n", step, span / 60);
+    
+    if(Metrics::sampleCount() == 0) {
+        ShellOutput::printf("No samples yet (first one after %d s)\n\n", METRICS_INTERVAL_MS / 1000);
+        return SHELL_OK;
+    }
+    
+    // La tendencia ocupa lo que queda de la línea
+    ShellSession* session = ShellSession::current();
+    int width = session->termCols - 52;
+    if(width < 10) width = 10;
+    if(width > 60) width = 60;
+    
+    ShellOutput::println("METRIC            NOW      MIN      AVG      MAX       TREND");
+    ShellOutput::println("-------------------------------------------------------------------------------");
+    
+    int32_t values[144];
+    for(int m = 0; m < METRIC_COUNT; m++) {
+        const MetricInfo* info = Metrics::info((MetricId)m);
+        int n = Metrics::read(level, (MetricId)m, values, 144);
+        
+        int32_t minValue = 0, maxValue = 0, now = METRIC_NONE;
+        int64_t sum = 0;
+        int valid = 0;
+        for(int i = 0; i < n; i++) {
+            if(values[i] == METRIC_NONE) continue;
+            if(valid == 0 || values[i] < minValue) minValue = values[i];
+            if(valid == 0 || values[i] > maxValue) maxValue = values[i];
+            sum += values[i];
+            valid++;
+        }
+        if(n > 0) now = values[n - 1];
+        
+        ShellOutput::printf("%-12s", info->name);
+        if(valid == 0) {
+            ShellOutput::println("       -        -        -        -");
+            continue;
+        }
+        
+        int32_t d = info->divisor;
+        if(now == METRIC_NONE) ShellOutput::print("       -");
+        else ShellOutput::printf(" %7ld", (long)(now / d));
+        ShellOutput::printf("  %7ld  %7ld  %7ld %-4s ",
+                            (long)(minValue / d), (long)(sum / valid / d),
+                            (long)(maxValue / d), info->unit);
+        
+        printSpark(values, n, width, minValue, maxValue);
+    }
+    
+    // Stack libre por tarea: mínimo desde el arranque y tendencia de su
+    // propia serie, para ver qué margen se está estrechando
+    ShellOutput::println("\nTASK            STACK FREE   MIN     TREND");
+    ShellOutput::println("-------------------------------------------------------------------------------");
+    WatchedTask task;
+    for(int i = 0; Metrics::getTask(i, &task); i++) {
+        if(task.freeMin == UINT32_MAX) {
+            ShellOutput::printf("%-14s         -        -\n", task.name);
+            continue;
+        }
+        ShellOutput::printf("%-14s  %8u B  %5u B  ", task.name, task.freeNow, task.freeMin);
+        int n = Metrics::readTask(level, i, values, 144);
+        int32_t minValue = 0, maxValue = 0;
+        for(int k = 0; k < n; k++) {
+            if(k == 0 || values[k] < minValue) minValue = values[k];
+            if(k == 0 || values[k] > maxValue) maxValue = values[k];
+        }
+        printSpark(values, n, width, minValue, maxValue);
+    }
+    ShellOutput::println();
+    return SHELL_OK;
+}
+
+// Comando: stacks - Uso de stack por tarea y tamaños recomendados
+ShellError MiniShell::cmd_stacks(CommandArgs args) {
+    Metrics::sampleStacks();
+    
+    ShellOutput::println("\nTASK             SIZE  PEAK USED  FREE MIN  MARGIN  DEEPEST COMMAND   RECOMMEND");
+    ShellOutput::println("-------------------------------------------------------------------------------");
+    
+    WatchedTask task;
+    long balance = 0;
+    for(int i = 0; Metrics::getTask(i, &task); i++) {
+        uint32_t recommended = Metrics::recommendStack(&task);
+        if(recommended == 0) {
+            ShellOutput::printf("%-14s  %5u          -         -       -  -                 -\n",
+                                task.name, (unsigned)task.stackSize);
+            continue;
+        }
+        
+        const char* verdict = "ok";
+        if(recommended > task.stackSize) verdict = "grow";
+        else if(recommended < task.stackSize) verdict = "shrink";
+        balance += (long)task.stackSize - (long)recommended;
+        
+        ShellOutput::printf("%-14s  %5u  %9u  %8u  %5u%%%s %-16s  %5u (%s)\n",
+                            task.name, (unsigned)task.stackSize,
+                            (unsigned)(task.stackSize - task.freeMin), (unsigned)task.freeMin,
+                            (unsigned)(task.freeMin * 100 / task.stackSize),
+                            Metrics::stackLow(&task) ? "!" : " ",
+                            task.deepest ? task.deepest : "-",
+                            (unsigned)recommended, verdict);
+    }
+    
+    ShellOutput::println();
+    if(balance >= 0) {
+        ShellOutput::printf("Reclaimable: %ld bytes", balance);
+    } else {
+        ShellOutput::printf("Missing: %ld bytes", -balance);
+    }
+    ShellOutput::printf(" (headroom max(%d B, 25%%), '!' = margin under max(%d B, %d%%))\n",
+                        STACK_HEADROOM_MIN, STACK_WARN_BYTES, STACK_WARN_PERCENT);
+    ShellOutput::println("Peaks are since boot: run the heaviest commands before shrinking a stack.\n");
+    return SHELL_OK;
+}
+
+// Comando: prof - Percentiles de latencia por comando ('prof -r' reinicia)
+ShellError MiniShell::cmd_prof(CommandArgs args) {
+    if(args.argc > 1) {
+        if(strcmp(args.argv[1], "-r") != 0) {
+            ShellOutput::println("Usage: prof [-r]");
+            return SHELL_ERR_INVALID_ARGS;
+        }
+        Profiler::reset();
+        ShellOutput::println("Profiles cleared");
+        return SHELL_OK;
+    }
+    
+    ShellOutput::println("COMMAND       CALLS       P50       P95       P99       MAX   AVG CPU  HEAP/CALL  SD R/W KB");
+    ShellOutput::println("----------------------------------------------------------------------------------------------");
+    
+    CommandProfile profile;
+    int shown = 0;
+    for(int i = 0; i < shell.getCommandCount(); i++) {
+        if(!Profiler::get(i, &profile)) continue;
+        
+        char p50[16], p95[16], p99[16], maxWall[16], cpu[16];
+        Profiler::formatUs(p50, sizeof(p50), Profiler::percentile(&profile, 50));
+        Profiler::formatUs(p95, sizeof(p95), Profiler::percentile(&profile, 95));
+        Profiler::formatUs(p99, sizeof(p99), Profiler::percentile(&profile, 99));
+        Profiler::formatUs(maxWall, sizeof(maxWall), profile.maxWallUs);
+        Profiler::formatUs(cpu, sizeof(cpu), profile.totalCpuUs / profile.calls);
+        
+        ShellOutput::printf("%-12s %6u %9s %9s %9s %9s %9s %+10ld  %llu/%llu\n",
+                            shell.getCommand(i)->name, (unsigned)profile.calls,
+                            p50, p95, p99, maxWall,
+                            profile.totalCpuUs ? cpu : "-",
+                            (long)(profile.totalHeapDelta / profile.calls),
+                            profile.sdRead / 1024, profile.sdWritten / 1024);
+        shown++;
+    }
+    
+    if(shown == 0) {
+        ShellOutput::println("No commands measured yet");
+    }
+    return SHELL_OK;
+}
+
+// Comando: heap - Estado del heap y reservas por comando
+// Comandos que no deben reservar heap (sin String ni archivos): 'heap'
+// lo comprueba con el contador por comando
+static const char* const heapFreeCommands[] = {
+    "pwd", "echo", "help", "ifconfig", "dnscache"
+};
+
+static bool expectsHeapFree(const char* name) {
+    for(size_t i = 0; i < sizeof(heapFreeCommands) / sizeof(heapFreeCommands[0]); i++) {
+        if(strcmp(heapFreeCommands[i], name) == 0) return true;
+    }
+    return false;
+}
+
+ShellError MiniShell::cmd_heap(CommandArgs args) {
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_INTERNAL);
+    uint32_t freeHeap = info.total_free_bytes;
+    uint32_t largest = info.largest_free_block;
+    
+    ShellOutput::println("\n=== Heap ===");
+    ShellOutput::printf("Internal: free %u KB, min %u KB, largest %u KB (frag %u%%)\n",
+                        freeHeap / 1024, (unsigned)info.minimum_free_bytes / 1024, largest / 1024,
+                        freeHeap ? 100 - (uint32_t)((uint64_t)largest * 100 / freeHeap) : 0);
+    ShellOutput::printf("Blocks:   %u allocated, %u free\n",
+                        (unsigned)info.allocated_blocks, (unsigned)info.free_blocks);
+    if(psramFound()) {
+        uint32_t freePsram = ESP.getFreePsram();
+        uint32_t largestPsram = ESP.getMaxAllocPsram();
+        ShellOutput::printf("PSRAM:    free %u KB, largest %u KB (frag %u%%)\n",
+                            freePsram / 1024, largestPsram / 1024,
+                            freePsram ? 100 - (uint32_t)((uint64_t)largestPsram * 100 / freePsram) : 0);
+    }
+    ShellOutput::printf("Tracking: %s\n\n", Profiler::exactAllocs()
+                        ? "exact per command (heap hooks)"
+                        : "net live blocks, system-wide (no heap hooks)");
+    
+    ShellOutput::println("COMMAND       CALLS  ALLOCS/CALL  KB/CALL  MAX ALLOCS  PEAK KB  LARGEST KB first>last (min)");
+    ShellOutput::println("--------------------------------------------------------------------------------------------");
+    
+    CommandProfile profile;
+    int shown = 0;
+    int heapFreeChecked = 0;
+    int heapFreeFailed = 0;
+    for(int i = 0; i < shell.getCommandCount(); i++) {
+        if(!Profiler::get(i, &profile)) continue;
+        
+        const char* name = shell.getCommand(i)->name;
+        bool heapFree = expectsHeapFree(name);
+        bool allocated = heapFree && Profiler::exactAllocs() && profile.maxAllocs > 0;
+        if(heapFree) heapFreeChecked++;
+        if(allocated) heapFreeFailed++;
+        char label[16];
+        snprintf(label, sizeof(label), "%s%s", name, allocated ? "!" : heapFree ? "*" : "");
+        
+        uint64_t bytesPerCall = profile.allocBytes / profile.calls;
+        ShellOutput::printf("%-12s %6u %12u %5u.%u %11u %8u  %6u > %-6u (%u)\n",
+                            label, (unsigned)profile.calls,
+                            (unsigned)((profile.allocs + profile.calls / 2) / profile.calls),
+                            (unsigned)(bytesPerCall / 1024), (unsigned)(bytesPerCall % 1024) * 10 / 1024,
+                            (unsigned)profile.maxAllocs, (unsigned)profile.maxPeakBytes / 1024,
+                            (unsigned)profile.firstLargestFree / 1024,
+                            (unsigned)profile.lastLargestFree / 1024,
+                            (unsigned)profile.minLargestFree / 1024);
+        shown++;
+    }
+    
+    if(shown == 0) {
+        ShellOutput::println("No commands measured yet");
+    } else if(heapFreeChecked > 0) {
+        // Sin hooks el contador es neto de todo el sistema: no demuestra nada
+        ShellOutput::printf("\n* = expected heap-free, ! = allocated anyway (%d of %d)%s\n",
+                            heapFreeFailed, heapFreeChecked,
+                            Profiler::exactAllocs() ? "" : "; exact only with heap hooks");
+    }
+    ShellOutput::println();
+    return SHELL_OK;
+}
+
+// Comando: dmesg - Registro del sistema
+// Uso: dmesg [-l e|w|i|d] [-n <líneas>] [-c]  (-c vacía la vista tras mostrarla)
+ShellError MiniShell::cmd_dmesg(CommandArgs args) {
+    int maxLevel = SYSLOG_DEBUG;
+    uint32_t lines = 0;
+    bool clearAfter = false;
+    
+    for(int i = 1; i < args.argc; i++) {
+        if(strcmp(args.argv[i], "-c") == 0) {
+            clearAfter = true;
+        } else if(strcmp(args.argv[i], "-l") == 0 && i + 1 < args.argc) {
+            const char* letters = "ewid";
+            const char* found = strchr(letters, tolower(args.argv[++i][0]));
+            if(!found || args.argv[i][0] == '\0') {
+                ShellOutput::println("ERROR: Level must be e, w, i or d");
+                return SHELL_ERR_INVALID_ARGS;
+            }
+            maxLevel = found - letters;
+        } else if(strcmp(args.argv[i], "-n") == 0 && i + 1 < args.argc) {
+            lines = atol(args.argv[++i]);
+        } else {
+            ShellOutput::println("Usage: dmesg [-l e|w|i|d] [-n <lines>] [-c]");
+            return SHELL_ERR_INVALID_ARGS;
+        }
+    }
+    
+    uint32_t end = SysLog::head();
+    uint32_t index = SysLog::first();
+    
+    // Con -n, empezar lo bastante atrás para mostrar las últimas N del nivel
+    if(lines > 0) {
+        uint32_t start = end;
+        uint32_t matched = 0;
+        LogEntry entry;
+        while(start > index && matched < lines) {
+            start--;
+            if(SysLog::read(start, &entry) && entry.level <= maxLevel) matched++;
+        }
+        index = start;
+    }
+    
+    ShellSession* session = ShellSession::current();
+    char line[SYSLOG_TEXT + 32];
+    LogEntry entry;
+    for(; index != end && !session->interrupted(); index++) {
+        if(!SysLog::read(index, &entry) || entry.level > maxLevel) continue;
+        SysLog::format(&entry, line, sizeof(line));
+        ShellOutput::print(line);
+    }
+    
+    if(SysLog::lostCount() > 0) {
+        ShellOutput::printf("(%u entries overwritten before reaching the SD card)\n",
+                            (unsigned)SysLog::lostCount());
+    }
+    if(clearAfter) {
+        SysLog::clear();
+    }
+    return session->cancelled ? SHELL_ERR_CANCELLED : SHELL_OK;
+}
+
+// Comando: trace - Trazas de eventos (start | stop | status | dump <archivo>)
+ShellError MiniShell::cmd_trace(CommandArgs args) {
+    const char* action = args.argc > 1 ? args.argv[1] : "status";
+    
+    if(strcmp(action, "start") == 0) {
+        if(!Tracer::start()) {
+            ShellOutput::println("ERROR: Not enough memory for trace buffers");
+            return SHELL_ERR_NO_SPACE;
+        }
+        ShellOutput::printf("Tracing (%u events per core)\n", (unsigned)Tracer::capacity());
+        return SHELL_OK;
+    }
+    
+    if(strcmp(action, "stop") == 0) {
+        Tracer::stop();
+        ShellOutput::printf("Trace stopped: %u events", (unsigned)Tracer::recorded());
+        if(Tracer::overwritten() > 0) {
+            ShellOutput::printf(" (%u oldest overwritten)", (unsigned)Tracer::overwritten());
+        }
+        ShellOutput::println();
+        return SHELL_OK;
+    }
+    
+    if(strcmp(action, "status") == 0) {
+        ShellOutput::printf("Trace %s: %u events recorded, %u overwritten\n",
+                            Tracer::active ? "running" : "stopped",
+                            (unsigned)Tracer::recorded(), (unsigned)Tracer::overwritten());
+        return SHELL_OK;
+    }
+    
+    if(strcmp(action, "dump") == 0 && args.argc > 2) {
+        if(Tracer::capacity() == 0) {
+            ShellOutput::println("ERROR: Nothing traced yet ('trace start')");
+            return SHELL_ERR_NOT_FOUND;
+        }
+        // No se mezclan eventos nuevos mientras se escribe
+        Tracer::stop();
+        
+        // 'trace' no reserva la SD al registrarse: solo el volcado la usa
+        ShellSession* session = ShellSession::current();
+        if(!CommandExecutor::acquire(CMD_RES_SD_WRITE, session)) {
+            return SHELL_ERR_CANCELLED;
+        }
+        
+        PathString path = shell.resolvePath(args.argv[2]);
+        int64_t oldSize = SdSpace::sizeOf(path.c_str());
+        File file = SD_MMC.open(path, FILE_WRITE);
+        if(!file) {
+            CommandExecutor::release(CMD_RES_SD_WRITE);
+            ShellOutput::println("ERROR: Cannot create file");
+            return SHELL_ERR_PERMISSION;
+        }
+        
+        long events = Tracer::dump(file);
+        size_t size = file.size();
+        file.close();
+        SdSpace::fileChanged(oldSize, size);
+        Profiler::countWritten(size);
+        DirCache::invalidate(path.c_str());
+        CommandExecutor::release(CMD_RES_SD_WRITE);
+        
+        ShellOutput::printf("%ld events written to %s (%u bytes)\n", events, path.c_str(), (unsigned)size);
+        ShellOutput::println("Open it in https://ui.perfetto.dev or chrome://tracing");
+        return SHELL_OK;
+    }
+    
+    ShellOutput::println("Usage: trace start | stop | status | dump <file.json>");
+    return SHELL_ERR_INVALID_ARGS;
+}
@@ -0,0 +1,509 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * netBench.cpp - Implementación del medidor de rendimiento de red
+ */
+
+#include "netBench.h"
+#include "sshServer.h"
+#include "shellSession.h"
+#include "bufferPool.h"
+#include "commandExecutor.h"
+#include "icmpSocket.h"
+#include "profiler.h"
+#include "tracer.h"
+#include <lwip/sockets.h>
+
+// Contador de bytes con informes cada 'interval'
+struct BenchMeter {
+    unsigned long startMs;
+    unsigned long lastMs;
+    uint64_t bytes;
+    uint64_t lastBytes;
+    uint32_t intervalMs;
+
+    void begin(uint32_t interval) {
+        startMs = lastMs = millis();
+        bytes = lastBytes = 0;
+        intervalMs = interval;
+    }
+
+    static void printLine(unsigned long fromMs, unsigned long toMs, uint64_t count) {
+        unsigned long span = toMs - fromMs;
+        double mbits = span > 0 ? (count * 8.0) / (span * 1000.0) : 0;
+        ShellOutput::printf("[%4lu.%lu-%4lu.%lu s]  %9.2f KB  %7.2f Mbit/s\n",
+                            fromMs / 1000, (fromMs % 1000) / 100,
+                            toMs / 1000, (toMs % 1000) / 100,
+                            count / 1024.0, mbits);
+    }
+
+    void tick() {
+        unsigned long now = millis();
+        if(intervalMs == 0 || now - lastMs < intervalMs) return;
+        printLine(lastMs - startMs, now - startMs, bytes - lastBytes);
+        ShellOutput::flush();
+        lastMs = now;
+        lastBytes = bytes;
+    }
+
+    // 'endMs': último dato (0: ahora)
+    void total(unsigned long endMs = 0) {
+        ShellOutput::println("- - - - - - - - - - - - - - - - - - - - - -");
+        printLine(0, (endMs ? endMs : millis()) - startMs, bytes);
+    }
+};
+
+ShellError NetBench::run(const NetBenchConfig* config) {
+    // Sin pool no hay prueba: un buffer en el stack limitaría la medida
+    size_t size = 0;
+    size_t wanted = config->udp ? NETBENCH_UDP_PAYLOAD : config->bufferSize;
+    uint8_t flags = config->mode == NETBENCH_SD ? POOL_DMA : POOL_ANY;
+    // UDP envía y recibe siempre datagramas completos: nada por debajo
+    size_t minimum = config->udp ? wanted : min(wanted, (size_t)NETBENCH_MIN_BUFFER);
+    uint8_t* buffer = (uint8_t*)BufferPool::acquire(wanted, minimum, flags, &size);
+    if(!buffer) {
+        ShellOutput::println("ERROR: Not enough memory for the buffer");
+        return SHELL_ERR_NO_SPACE;
+    }
+    for(size_t i = 0; i < size; i++) {
+        buffer[i] = (uint8_t)i;
+    }
+
+    NetBenchConfig actual = *config;
+    if(!actual.udp) {
+        actual.bufferSize = min(size, actual.bufferSize);
+    }
+
+    ShellError result;
+    if(actual.mode == NETBENCH_SD) {
+        // Solo este modo lee la SD: se reserva aquí y no al registrarse,
+        // así un 'netbench server' no bloquea cp, nano o el log. La red
+        // no se reserva: todos los modos usan sus propios sockets.
+        if(CommandExecutor::acquire(CMD_RES_SD_READ, ShellSession::current())) {
+            result = sdSend(&actual, buffer);
+            CommandExecutor::release(CMD_RES_SD_READ);
+        } else {
+            result = SHELL_ERR_CANCELLED;
+        }
+    } else if(actual.mode == NETBENCH_SERVER) {
+        result = actual.udp ? udpServer(&actual, buffer) : tcpServer(&actual, buffer);
+    } else {
+        result = actual.udp ? udpClient(&actual, buffer) : tcpClient(&actual, buffer);
+    }
+
+    BufferPool::release(buffer);
+    return result;
+}
+
+// Conexión no bloqueante con plazo (y Ctrl+C)
+int NetBench::connectTo(uint32_t addr, uint16_t port, uint32_t timeoutMs) {
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(fd < 0) return -1;
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = addr;
+    to.sin_port = htons(port);
+    if(connect(fd, (struct sockaddr*)&to, sizeof(to)) == 0) {
+        return fd;
+    }
+    if(errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+
+    ShellSession* session = ShellSession::current();
+    unsigned long start = millis();
+    while(millis() - start < timeoutMs && !session->interrupted()) {
+        fd_set writeSet;
+        FD_ZERO(&writeSet);
+        FD_SET(fd, &writeSet);
+        struct timeval wait = { 0, 50000 };
+        if(select(fd + 1, NULL, &writeSet, NULL, &wait) > 0) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+            if(error == 0) return fd;
+            break;
+        }
+    }
+    close(fd);
+    return -1;
+}
+
+int NetBench::listenOn(uint16_t port, int type) {
+    int fd = socket(AF_INET, type, type == SOCK_STREAM ? IPPROTO_TCP : IPPROTO_UDP);
+    if(fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if(bind(fd, (struct sockaddr*)&local, sizeof(local)) < 0 ||
+       (type == SOCK_STREAM && listen(fd, NETBENCH_MAX_STREAMS) < 0)) {
+        close(fd);
+        return -1;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    return fd;
+}
+
+ShellError NetBench::tcpClient(const NetBenchConfig* config, uint8_t* buffer) {
+    char peer[16];
+    IcmpSocket::formatAddr(config->addr, peer, sizeof(peer));
+    ShellOutput::printf("Connecting to %s:%u, %d stream(s), %u-byte writes, %lu s\n",
+                        peer, config->port, config->streams, (unsigned)config->bufferSize,
+                        (unsigned long)(config->durationMs / 1000));
+
+    int fds[NETBENCH_MAX_STREAMS];
+    int open = 0;
+    for(int i = 0; i < config->streams; i++) {
+        fds[i] = connectTo(config->addr, config->port, NETBENCH_CONNECT_MS);
+        if(fds[i] < 0) {
+            ShellOutput::printf("ERROR: Stream %d cannot connect\n", i + 1);
+            for(int k = 0; k < i; k++) close(fds[k]);
+            return SHELL_ERR_NOT_FOUND;
+        }
+        open++;
+    }
+
+    ShellSession* session = ShellSession::current();
+    BenchMeter meter;
+    meter.begin(config->intervalMs);
+    TRACE_BEGIN("net.bench", config->streams);
+
+    while(open > 0 && millis() - meter.startMs < config->durationMs && !session->interrupted()) {
+        fd_set writeSet;
+        FD_ZERO(&writeSet);
+        int maxFd = -1;
+        for(int i = 0; i < config->streams; i++) {
+            if(fds[i] < 0) continue;
+            FD_SET(fds[i], &writeSet);
+            if(fds[i] > maxFd) maxFd = fds[i];
+        }
+        struct timeval wait = { 0, 50000 };
+        if(select(maxFd + 1, NULL, &writeSet, NULL, &wait) > 0) {
+            for(int i = 0; i < config->streams; i++) {
+                if(fds[i] < 0 || !FD_ISSET(fds[i], &writeSet)) continue;
+                int sent = send(fds[i], buffer, config->bufferSize, 0);
+                if(sent > 0) {
+                    meter.bytes += sent;
+                } else if(sent < 0 && errno != EWOULDBLOCK && errno != EAGAIN) {
+                    ShellOutput::printf("Stream %d closed: %s\n", i + 1, strerror(errno));
+                    close(fds[i]);
+                    fds[i] = -1;
+                    open--;
+                }
+            }
+        }
+        meter.tick();
+    }
+
+    TRACE_END("net.bench", (uint32_t)meter.bytes);
+    for(int i = 0; i < config->streams; i++) {
+        if(fds[i] >= 0) close(fds[i]);
+    }
+    if(session->cancelled) {
+        ShellOutput::println("^C");
+    }
+    meter.total();
+    return session->cancelled ? SHELL_ERR_CANCELLED : SHELL_OK;
+}
+
+ShellError NetBench::tcpServer(const NetBenchConfig* config, uint8_t* buffer) {
+    int listener = listenOn(config->port, SOCK_STREAM);
+    if(listener < 0) {
+        ShellOutput::printf("ERROR: Cannot listen on port %u\n", config->port);
+        return SHELL_ERR_PERMISSION;
+    }
+    ShellOutput::printf("Listening on TCP port %u (Ctrl+C to stop)\n", config->port);
+    ShellOutput::flush();
+
+    int fds[NETBENCH_MAX_STREAMS];
+    int open = 0;
+    int accepted = 0;
+    for(int i = 0; i < NETBENCH_MAX_STREAMS; i++) fds[i] = -1;
+
+    ShellSession* session = ShellSession::current();
+    BenchMeter meter;
+    meter.begin(config->intervalMs);
+
+    // Hasta que el peer cierre todas sus conexiones
+    while(!session->interrupted() && (accepted == 0 || open > 0)) {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(listener, &readSet);
+        int maxFd = listener;
+        for(int i = 0; i < NETBENCH_MAX_STREAMS; i++) {
+            if(fds[i] < 0) continue;
+            FD_SET(fds[i], &readSet);
+            if(fds[i] > maxFd) maxFd = fds[i];
+        }
+        struct timeval wait = { 0, 50000 };
+        if(select(maxFd + 1, &readSet, NULL, NULL, &wait) > 0) {
+            if(FD_ISSET(listener, &readSet)) {
+                struct sockaddr_in from;
+                socklen_t length = sizeof(from);
+                int fd = accept(listener, (struct sockaddr*)&from, &length);
+                int slot = -1;
+                for(int i = 0; i < NETBENCH_MAX_STREAMS && fd >= 0; i++) {
+                    if(fds[i] < 0) {
+                        slot = i;
+                        break;
+                    }
+                }
+                if(fd >= 0 && slot < 0) {
+                    close(fd);
+                } else if(fd >= 0) {
+                    int flags = fcntl(fd, F_GETFL, 0);
+                    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+                    fds[slot] = fd;
+                    open++;
+                    char peer[16];
+                    IcmpSocket::formatAddr(from.sin_addr.s_addr, peer, sizeof(peer));
+                    ShellOutput::printf("Stream %d from %s:%u\n", slot + 1, peer, ntohs(from.sin_port));
+                    // El tiempo cuenta desde la primera conexión
+                    if(accepted++ == 0) meter.begin(config->intervalMs);
+                }
+            }
+            for(int i = 0; i < NETBENCH_MAX_STREAMS; i++) {
+                if(fds[i] < 0 || !FD_ISSET(fds[i], &readSet)) continue;
+                int received = recv(fds[i], buffer, config->bufferSize, 0);
+                if(received > 0) {
+                    meter.bytes += received;
+                } else if(received == 0 || (errno != EWOULDBLOCK && errno != EAGAIN)) {
+                    close(fds[i]);
+                    fds[i] = -1;
+                    open--;
+                }
+            }
+        }
+        if(accepted > 0) meter.tick();
+    }
+
+    for(int i = 0; i < NETBENCH_MAX_STREAMS; i++) {
+        if(fds[i] >= 0) close(fds[i]);
+    }
+    close(listener);
+    if(session->cancelled) {
+        ShellOutput::println("^C");
+    }
+    if(accepted > 0) {
+        meter.total();
+    }
+    return session->cancelled && accepted == 0 ? SHELL_ERR_CANCELLED : SHELL_OK;
+}
+
+ShellError NetBench::udpClient(const NetBenchConfig* config, uint8_t* buffer) {
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if(fd < 0) {
+        ShellOutput::println("ERROR: Cannot create UDP socket");
+        return SHELL_ERR_PERMISSION;
+    }
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = config->addr;
+    to.sin_port = htons(config->port);
+
+    char peer[16];
+    IcmpSocket::formatAddr(config->addr, peer, sizeof(peer));
+    ShellOutput::printf("UDP to %s:%u, %d-byte datagrams, ", peer, config->port, NETBENCH_UDP_PAYLOAD);
+    if(config->rateKbps > 0) ShellOutput::printf("%lu kbit/s, ", (unsigned long)config->rateKbps);
+    else ShellOutput::print("no rate limit, ");
+    ShellOutput::printf("%lu s\n", (unsigned long)(config->durationMs / 1000));
+
+    ShellSession* session = ShellSession::current();
+    BenchMeter meter;
+    meter.begin(config->intervalMs);
+    uint32_t seq = 0;
+    uint32_t dropped = 0;
+
+    while(millis() - meter.startMs < config->durationMs && !session->interrupted()) {
+        // Con límite: no adelantarse a lo que permite el ritmo pedido
+        if(config->rateKbps > 0) {
+            uint64_t allowed = (uint64_t)(millis() - meter.startMs) * config->rateKbps / 8;
+            if(meter.bytes >= allowed) {
+                delay(1);
+                meter.tick();
+                continue;
+            }
+        }
+        uint32_t header[2] = { htonl(seq), htonl((uint32_t)micros()) };
+        memcpy(buffer, header, sizeof(header));
+        int sent = sendto(fd, buffer, NETBENCH_UDP_PAYLOAD, 0, (struct sockaddr*)&to, sizeof(to));
+        if(sent > 0) {
+            meter.bytes += sent;
+            seq++;
+        } else {
+            // Sin pbufs en lwIP: dejar que la radio vacíe la cola
+            dropped++;
+            delay(1);
+        }
+        meter.tick();
+    }
+
+    close(fd);
+    if(session->cancelled) {
+        ShellOutput::println("^C");
+    }
+    meter.total();
+    ShellOutput::printf("%lu datagrams sent, %lu send retries (stack out of buffers)\n",
+                        (unsigned long)seq, (unsigned long)dropped);
+    return session->cancelled ? SHELL_ERR_CANCELLED : SHELL_OK;
+}
+
+ShellError NetBench::udpServer(const NetBenchConfig* config, uint8_t* buffer) {
+    int fd = listenOn(config->port, SOCK_DGRAM);
+    if(fd < 0) {
+        ShellOutput::printf("ERROR: Cannot bind UDP port %u\n", config->port);
+        return SHELL_ERR_PERMISSION;
+    }
+    ShellOutput::printf("Listening on UDP port %u (Ctrl+C to stop)\n", config->port);
+    ShellOutput::flush();
+
+    ShellSession* session = ShellSession::current();
+    BenchMeter meter;
+    meter.begin(config->intervalMs);
+    uint32_t packets = 0;
+    uint32_t lost = 0;
+    uint32_t reordered = 0;
+    uint32_t expected = 0;
+    unsigned long lastMs = 0;
+
+    while(!session->interrupted()) {
+        if(packets > 0 && millis() - lastMs >= NETBENCH_UDP_IDLE_MS) break;
+
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(fd, &readSet);
+        struct timeval wait = { 0, 50000 };
+        if(select(fd + 1, &readSet, NULL, NULL, &wait) > 0) {
+            int received;
+            while((received = recv(fd, buffer, NETBENCH_UDP_PAYLOAD, 0)) > 0) {
+                if(packets++ == 0) meter.begin(config->intervalMs);
+                lastMs = millis();
+                meter.bytes += received;
+                if(received < 8) continue;
+                uint32_t seq;
+                memcpy(&seq, buffer, sizeof(seq));
+                seq = ntohl(seq);
+                if(seq >= expected) {
+                    lost += seq - expected;
+                    expected = seq + 1;
+                } else {
+                    // Llegó tarde: no estaba perdido
+                    reordered++;
+                    if(lost > 0) lost--;
+                }
+            }
+        }
+        if(packets > 0) meter.tick();
+    }
+
+    close(fd);
+    if(session->cancelled) {
+        ShellOutput::println("^C");
+    }
+    if(packets > 0) {
+        // Sin contar la espera final sin datagramas
+        meter.total(lastMs);
+        uint32_t total = packets + lost;
+        ShellOutput::printf("%lu datagrams, %lu lost (%.2f%%), %lu out of order\n",
+                            (unsigned long)packets, (unsigned long)lost,
+                            total > 0 ? lost * 100.0 / total : 0.0, (unsigned long)reordered);
+    }
+    return session->cancelled && packets == 0 ? SHELL_ERR_CANCELLED : SHELL_OK;
+}
+
+// Lee de la SD y envía por el socket, midiendo cada parte por separado
+ShellError NetBench::sdSend(const NetBenchConfig* config, uint8_t* buffer) {
+    File file = SD_MMC.open(config->path, FILE_READ);
+    if(!file || file.isDirectory()) {
+        if(file) file.close();
+        ShellOutput::println("ERROR: Cannot open file");
+        return SHELL_ERR_NOT_FOUND;
+    }
+
+    char peer[16];
+    IcmpSocket::formatAddr(config->addr, peer, sizeof(peer));
+    ShellOutput::printf("Sending %s (%lu bytes) to %s:%u in %u-byte blocks\n",
+                        config->path, (unsigned long)file.size(), peer, config->port,
+                        (unsigned)config->bufferSize);
+
+    int fd = connectTo(config->addr, config->port, NETBENCH_CONNECT_MS);
+    if(fd < 0) {
+        file.close();
+        ShellOutput::println("ERROR: Cannot connect");
+        return SHELL_ERR_NOT_FOUND;
+    }
+
+    ShellSession* session = ShellSession::current();
+    BenchMeter meter;
+    meter.begin(config->intervalMs);
+    uint64_t sdUs = 0;
+    uint64_t netUs = 0;
+    uint64_t readBytes = 0;
+    bool failed = false;
+
+    TRACE_BEGIN("net.bench.sd", file.size());
+    while(!failed && !session->interrupted()) {
+        uint32_t t0 = micros();
+        size_t length = file.read(buffer, config->bufferSize);
+        uint32_t t1 = micros();
+        sdUs += t1 - t0;
+        if(length == 0) break;
+        readBytes += length;
+
+        // Enviar el bloque completo; el tiempo esperando al socket es de la red
+        size_t offset = 0;
+        while(offset < length && !session->interrupted()) {
+            int sent = send(fd, buffer + offset, length - offset, 0);
+            if(sent > 0) {
+                offset += sent;
+                meter.bytes += sent;
+                continue;
+            }
+            if(sent < 0 && errno != EWOULDBLOCK && errno != EAGAIN) {
+                ShellOutput::printf("ERROR: Send failed: %s\n", strerror(errno));
+                failed = true;
+                break;
+            }
+            fd_set writeSet;
+            FD_ZERO(&writeSet);
+            FD_SET(fd, &writeSet);
+            struct timeval wait = { 0, 50000 };
+            select(fd + 1, NULL, &writeSet, NULL, &wait);
+        }
+        netUs += micros() - t1;
+        meter.tick();
+    }
+    TRACE_END("net.bench.sd", (uint32_t)meter.bytes);
+
+    close(fd);
+    file.close();
+    Profiler::countRead((size_t)readBytes);
+    if(session->cancelled) {
+        ShellOutput::println("^C");
+    }
+    meter.total();
+
+    // Cada parte a su propio ritmo: la más lenta es el límite
+    double sdRate = sdUs > 0 ? readBytes * 8.0 / sdUs : 0;
+    double netRate = netUs > 0 ? meter.bytes * 8.0 / netUs : 0;
+    ShellOutput::printf("SD read:     %8.2f Mbit/s (%lu ms)\n", sdRate, (unsigned long)(sdUs / 1000));
+    ShellOutput::printf("Socket send: %8.2f Mbit/s (%lu ms)\n", netRate, (unsigned long)(netUs / 1000));
+    if(sdUs > 0 && netUs > 0) {
+        ShellOutput::printf("Bottleneck:  %s (%.0f%% of the time)\n",
+                            sdUs > netUs ? "SD card" : "network",
+                            (sdUs > netUs ? sdUs : netUs) * 100.0 / (sdUs + netUs));
+    }
+    if(failed) return SHELL_ERR_PERMISSION;
+    return session->cancelled ? SHELL_ERR_CANCELLED : SHELL_OK;
+}
@@ -0,0 +1,65 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * netBench.h - Medidor de rendimiento de red (netbench)
+ */
+
+#ifndef NET_BENCH_H
+#define NET_BENCH_H
+
+#include <Arduino.h>
+#include "shell.h"
+
+#define NETBENCH_PORT 5201
+#define NETBENCH_BUFFER 8192            // Bytes por send/recv
+#define NETBENCH_MIN_BUFFER 512
+#define NETBENCH_MAX_BUFFER 65536
+#define NETBENCH_DURATION_S 10
+#define NETBENCH_INTERVAL_S 1
+#define NETBENCH_MAX_STREAMS 4
+#define NETBENCH_UDP_PAYLOAD 1460       // Sin fragmentar en WiFi (MTU 1500)
+#define NETBENCH_UDP_IDLE_MS 2000       // Fin del test UDP en el servidor
+#define NETBENCH_CONNECT_MS 3000
+
+enum NetBenchMode {
+    NETBENCH_CLIENT = 0,    // Envía al peer
+    NETBENCH_SERVER,        // Recibe del peer
+    NETBENCH_SD             // Lee un archivo de la SD y lo envía
+};
+
+struct NetBenchConfig {
+    uint8_t mode;
+    bool udp;
+    uint32_t addr;          // Peer (orden de red), cliente y sd
+    uint16_t port;
+    size_t bufferSize;
+    uint32_t durationMs;    // Cliente
+    uint32_t intervalMs;    // Informes parciales (0: solo el total)
+    int streams;            // Conexiones TCP en paralelo (cliente)
+    uint32_t rateKbps;      // UDP: 0 = sin límite
+    const char* path;       // sd
+};
+
+// Flujo TCP (o datagramas UDP) sin protocolo de control: el peer del PC
+// puede ser nc o un script de pocas líneas, p. ej.
+//   cliente -> PC:  nc -l 5201 > /dev/null
+//   PC -> servidor: nc <esp32> 5201 < /dev/zero
+// Los datagramas UDP llevan número de secuencia y marca de tiempo (8
+// bytes, orden de red) para contar pérdidas y desorden en el receptor.
+// El modo sd separa el tiempo de lectura de la SD del de envío por el
+// socket, para saber cuál de los dos limita la transferencia.
+class NetBench {
+public:
+    static ShellError run(const NetBenchConfig* config);
+
+private:
+    static ShellError tcpClient(const NetBenchConfig* config, uint8_t* buffer);
+    static ShellError tcpServer(const NetBenchConfig* config, uint8_t* buffer);
+    static ShellError udpClient(const NetBenchConfig* config, uint8_t* buffer);
+    static ShellError udpServer(const NetBenchConfig* config, uint8_t* buffer);
+    static ShellError sdSend(const NetBenchConfig* config, uint8_t* buffer);
+
+    static int connectTo(uint32_t addr, uint16_t port, uint32_t timeoutMs);
+    static int listenOn(uint16_t port, int type);
+};
+
+#endif
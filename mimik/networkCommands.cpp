@@ -6,6 +6,14 @@
 #include "shell.h"
 #include "sshServer.h"
 #include "networkConfig.h"
+#include "shellSession.h"
+#include "icmpSocket.h"
+#include "tcpProbe.h"
+#include "netBench.h"
+#include "dnsCache.h"
+#include "wifiScanner.h"
+#include <esp_wifi.h>
+#include <lwip/sockets.h>
 
 
 // Comando: netconfig - Mostrar configuración guardada
@@ -49,6 +57,66 @@ ShellError MiniShell::cmd_netclear(CommandArgs args) {
         return SHELL_ERR_PERMISSION;
     }
 }
+// Comando: dnscache - Mostrar o vaciar la caché de nombres
+// Uso: dnscache [flush]
+ShellError MiniShell::cmd_dnscache(CommandArgs args) {
+    if(args.argc > 1) {
+        if(strcmp(args.argv[1], "flush") != 0) {
+            ShellOutput::println("Usage: dnscache [flush]");
+            return SHELL_ERR_INVALID_ARGS;
+        }
+        DnsCache::flush();
+        ShellOutput::println("DNS cache flushed");
+        return SHELL_OK;
+    }
+    
+    ShellOutput::println("\n=== DNS Cache ===\n");
+    ShellOutput::println("NAME                             ADDRESS          EXPIRES   HITS");
+    ShellOutput::println("------------------------------------------------------------------");
+    
+    uint32_t now = millis();
+    int shown = 0;
+    DnsEntry entry;
+    for(int i = 0; i < DNS_CACHE_SLOTS; i++) {
+        if(!DnsCache::getEntry(i, &entry)) continue;
+        uint32_t age = now - entry.storedMs;
+        char address[16];
+        if(entry.negative) strcpy(address, "(not found)");
+        else IcmpSocket::formatAddr(entry.addr, address, sizeof(address));
+        if(age < entry.ttlMs) {
+            ShellOutput::printf("%-32.32s %-15s  %6lus  %5lu\n", entry.name, address,
+                                (unsigned long)((entry.ttlMs - age + 999) / 1000),
+                                (unsigned long)entry.hits);
+        } else {
+            ShellOutput::printf("%-32.32s %-15s  %7s  %5lu\n", entry.name, address,
+                                "expired", (unsigned long)entry.hits);
+        }
+        shown++;
+    }
+    if(shown == 0) {
+        ShellOutput::println("(empty)");
+    }
+    
+    ShellOutput::printf("\nLookups: %lu from cache, %lu sent to DNS\n",
+                        (unsigned long)DnsCache::hitCount(), (unsigned long)DnsCache::missCount());
+    return SHELL_OK;
+}
+
+// "a.b.c.d" sin IPAddress::toString() ni WiFi.macAddress(), que crean
+// un String por línea
+static const char* formatIp(IPAddress ip, char* buffer, size_t size) {
+    snprintf(buffer, size, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    return buffer;
+}
+
+static const char* formatMac(char* buffer, size_t size) {
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    snprintf(buffer, size, "%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return buffer;
+}
+
 // Comando: ifconfig - Mostrar información de interfaces de red
 ShellError MiniShell::cmd_ifconfig(CommandArgs args) {
     ShellOutput::println("\n=== Network Interfaces ===\n");
@@ -57,29 +125,23 @@ ShellError MiniShell::cmd_ifconfig(CommandArgs args) {
     ShellOutput::println("wlan0: WiFi Interface");
     ShellOutput::println("-------------------------------");
     
-    if(WiFi.status() == WL_CONNECTED) {
+    char text[18];
+    wifi_ap_record_t ap;
+    if(WiFi.status() == WL_CONNECTED && esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        // SSID, RSSI y canal del registro del driver (WiFi.SSID() crea un String)
+        ap.ssid[sizeof(ap.ssid) - 1] = '\0';
         ShellOutput::print("  Status:     CONNECTED\n");
-        ShellOutput::print("  SSID:       ");
-        ShellOutput::println(WiFi.SSID());
-        ShellOutput::print("  IP Address: ");
-        ShellOutput::println(WiFi.localIP().toString());
-        ShellOutput::print("  Netmask:    ");
-        ShellOutput::println(WiFi.subnetMask().toString());
-        ShellOutput::print("  Gateway:    ");
-        ShellOutput::println(WiFi.gatewayIP().toString());
-        ShellOutput::print("  DNS:        ");
-        ShellOutput::println(WiFi.dnsIP().toString());
-        ShellOutput::print("  MAC:        ");
-        ShellOutput::println(WiFi.macAddress());
-        ShellOutput::print("  RSSI:       ");
-        ShellOutput::print((int)WiFi.RSSI());
-        ShellOutput::println(" dBm");
-        ShellOutput::print("  Channel:    ");
-        ShellOutput::println(WiFi.channel());
+        ShellOutput::printf("  SSID:       %s\n", (const char*)ap.ssid);
+        ShellOutput::printf("  IP Address: %s\n", formatIp(WiFi.localIP(), text, sizeof(text)));
+        ShellOutput::printf("  Netmask:    %s\n", formatIp(WiFi.subnetMask(), text, sizeof(text)));
+        ShellOutput::printf("  Gateway:    %s\n", formatIp(WiFi.gatewayIP(), text, sizeof(text)));
+        ShellOutput::printf("  DNS:        %s\n", formatIp(WiFi.dnsIP(), text, sizeof(text)));
+        ShellOutput::printf("  MAC:        %s\n", formatMac(text, sizeof(text)));
+        ShellOutput::printf("  RSSI:       %d dBm\n", (int)ap.rssi);
+        ShellOutput::printf("  Channel:    %u\n", (unsigned)ap.primary);
     } else {
         ShellOutput::println("  Status:     DISCONNECTED");
-        ShellOutput::print("  MAC:        ");
-        ShellOutput::println(WiFi.macAddress());
+        ShellOutput::printf("  MAC:        %s\n", formatMac(text, sizeof(text)));
     }
     
     ShellOutput::println();
@@ -113,13 +175,11 @@ ShellError MiniShell::cmd_ipset(CommandArgs args) {
         return SHELL_ERR_PERMISSION;
     }
     
+    char text[16];
     ShellOutput::println("Static IP configured successfully");
-    ShellOutput::print("IP:      ");
-    ShellOutput::println(ip.toString());
-    ShellOutput::print("Netmask: ");
-    ShellOutput::println(netmask.toString());
-    ShellOutput::print("Gateway: ");
-    ShellOutput::println(gateway.toString());
+    ShellOutput::printf("IP:      %s\n", formatIp(ip, text, sizeof(text)));
+    ShellOutput::printf("Netmask: %s\n", formatIp(netmask, text, sizeof(text)));
+    ShellOutput::printf("Gateway: %s\n", formatIp(gateway, text, sizeof(text)));
     
     // NUEVO: Guardar IP estática en SD
     if(NetworkConfigManager::saveStaticIP(args.argv[1], args.argv[2], args.argv[3])) {
@@ -132,15 +192,69 @@ ShellError MiniShell::cmd_ipset(CommandArgs args) {
     return SHELL_OK;
 }
 
+// Nombre o IP -> dirección (orden de red) y su texto, que se calcula
+// una sola vez (toString() crea un String por línea). Las IP literales
+// y los nombres ya resueltos no esperan al DNS.
+static bool resolveHost(const char* host, uint32_t* addr, char* text, size_t size) {
+    if(!DnsCache::resolve(host, addr)) {
+        return false;
+    }
+    IcmpSocket::formatAddr(*addr, text, size);
+    return true;
+}
+
 // Comando: ping - Hacer ping ICMP a un host
-// Uso: ping <host> [count]
-// Ejemplo: ping 8.8.8.8 o ping 192.168.1.100 5
+// Uso: ping [-c count] [-i intervalo_s] [-W timeout_s] [-t] <host> [count]
+// Ejemplo: ping 8.8.8.8, ping -i 0.2 -c 50 192.168.1.1 o ping -t router
+//
+// Los echos salen a su hora aunque la respuesta anterior no haya
+// llegado, y cada respuesta se muestra al recibirla con su RTT en
+// microsegundos (la marca de tiempo viaja en el paquete) y el TTL real.
+// Al final: mínimo/media/máximo, desviación típica y jitter (media de
+// la diferencia entre RTT consecutivos).
 ShellError MiniShell::cmd_ping(CommandArgs args) {
-    String host = args.argv[1];
-    int count = args.argc > 2 ? atoi(args.argv[2]) : 4;
+    const char* host = NULL;
+    long count = PING_COUNT;
+    float intervalSec = PING_INTERVAL_MS / 1000.0f;
+    float timeoutSec = PING_TIMEOUT_MS / 1000.0f;
+    bool continuous = false;
+    
+    for(int i = 1; i < args.argc; i++) {
+        if(strcmp(args.argv[i], "-c") == 0 && i + 1 < args.argc) {
+            count = atol(args.argv[++i]);
+        } else if(strcmp(args.argv[i], "-i") == 0 && i + 1 < args.argc) {
+            intervalSec = atof(args.argv[++i]);
+        } else if(strcmp(args.argv[i], "-W") == 0 && i + 1 < args.argc) {
+            timeoutSec = atof(args.argv[++i]);
+        } else if(strcmp(args.argv[i], "-t") == 0) {
+            continuous = true;
+        } else if(!host && args.argv[i][0] != '-') {
+            host = args.argv[i];
+        } else if(host && isdigit((unsigned char)args.argv[i][0])) {
+            count = atol(args.argv[i]);     // Forma antigua: ping <host> <count>
+        } else {
+            host = NULL;
+            break;
+        }
+    }
     
-    if(count < 1 || count > 20) {
-        ShellOutput::println("ERROR: Count must be between 1 and 20");
+    if(!host) {
+        ShellOutput::println("Usage: ping [-c count] [-i interval_s] [-W timeout_s] [-t] <host>");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    if(count == 0) continuous = true;
+    if(!continuous && (count < 1 || count > PING_MAX_COUNT)) {
+        ShellOutput::printf("ERROR: Count must be between 1 and %d (-t: until Ctrl+C)\n", PING_MAX_COUNT);
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    unsigned long intervalMs = (unsigned long)(intervalSec * 1000 + 0.5f);
+    unsigned long timeoutMs = (unsigned long)(timeoutSec * 1000 + 0.5f);
+    if(intervalMs < PING_MIN_INTERVAL_MS || intervalMs > 60000) {
+        ShellOutput::printf("ERROR: Interval must be between %.2f and 60 s\n", PING_MIN_INTERVAL_MS / 1000.0f);
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    if(timeoutMs < 10 || timeoutMs > 30000) {
+        ShellOutput::println("ERROR: Timeout must be between 0.01 and 30 s");
         return SHELL_ERR_INVALID_ARGS;
     }
     
@@ -149,117 +263,867 @@ ShellError MiniShell::cmd_ping(CommandArgs args) {
         return SHELL_ERR_PERMISSION;
     }
     
-    IPAddress targetIP;
+    uint32_t addr;
+    char ipText[16];
+    if(!resolveHost(host, &addr, ipText, sizeof(ipText))) {
+        ShellOutput::println("ERROR: Cannot resolve hostname");
+        return SHELL_ERR_NOT_FOUND;
+    }
     
-    // Resolver hostname a IP
-    if(!WiFi.hostByName(host.c_str(), targetIP)) {
-        // Si no puede resolver, intentar parsear como IP directa
-        if(!targetIP.fromString(host)) {
-            ShellOutput::println("ERROR: Cannot resolve hostname");
-            return SHELL_ERR_NOT_FOUND;
+    IcmpSocket icmp;
+    if(!icmp.open()) {
+        ShellOutput::println("ERROR: Cannot open ICMP socket");
+        return SHELL_ERR_PERMISSION;
+    }
+    
+    if(continuous) {
+        ShellOutput::printf("PING %s (%s) %d data bytes - Ctrl+C to stop\n", host, ipText, ICMP_PAYLOAD);
+    } else {
+        ShellOutput::printf("PING %s (%s) %d data bytes - %ld packets\n", host, ipText, ICMP_PAYLOAD, count);
+    }
+    
+    // Echos sin respuesta todavía
+    struct Pending {
+        uint16_t seq;
+        unsigned long sentMs;
+    } pending[PING_MAX_PENDING];
+    int waiting = 0;
+    
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    uint32_t errors = 0;
+    uint32_t minUs = 0xFFFFFFFF;
+    uint32_t maxUs = 0;
+    uint64_t sumUs = 0;
+    uint64_t sumSquares = 0;
+    uint64_t jitterSum = 0;
+    uint32_t lastUs = 0;
+    
+    ShellSession* session = ShellSession::current();
+    unsigned long started = millis();
+    unsigned long nextSend = started;
+    
+    while(!session->interrupted()) {
+        unsigned long now = millis();
+        bool sending = continuous || sent < (uint32_t)count;
+        
+        if(sending && (long)(now - nextSend) >= 0) {
+            // Ventana llena (intervalo mucho menor que el timeout): el
+            // más antiguo se da por perdido
+            if(waiting == PING_MAX_PENDING) {
+                int oldest = 0;
+                for(int k = 1; k < waiting; k++) {
+                    if(now - pending[k].sentMs > now - pending[oldest].sentMs) oldest = k;
+                }
+                pending[oldest] = pending[--waiting];
+            }
+            uint16_t seq = (uint16_t)sent;
+            if(icmp.send(addr, seq)) {
+                pending[waiting].seq = seq;
+                pending[waiting].sentMs = now;
+                waiting++;
+            }
+            sent++;
+            // Mantener el ritmo; si nos hemos retrasado, no enviar en ráfaga
+            nextSend += intervalMs;
+            if((long)(now - nextSend) > 0) nextSend = now + intervalMs;
+            sending = continuous || sent < (uint32_t)count;
         }
+        
+        // Los que superan el timeout se pierden
+        for(int k = 0; k < waiting; ) {
+            if(now - pending[k].sentMs >= timeoutMs) {
+                pending[k] = pending[--waiting];
+            } else {
+                k++;
+            }
+        }
+        if(!sending && waiting == 0) break;
+        
+        // Esperar al siguiente envío o al primer vencimiento (50 ms como
+        // mucho, para Ctrl+C)
+        unsigned long wait = 50;
+        if(sending) {
+            long untilSend = (long)(nextSend - now);
+            if(untilSend < (long)wait) wait = untilSend > 0 ? untilSend : 0;
+        }
+        for(int k = 0; k < waiting; k++) {
+            unsigned long left = timeoutMs - (now - pending[k].sentMs);
+            if(left < wait) wait = left;
+        }
+        
+        IcmpReply reply;
+        bool printed = false;
+        while(icmp.receive(&reply, wait)) {
+            wait = 0;
+            int slot = -1;
+            for(int k = 0; k < waiting; k++) {
+                if(pending[k].seq == reply.seq) {
+                    slot = k;
+                    break;
+                }
+            }
+            if(slot < 0) continue;     // Tardía o duplicada
+            pending[slot] = pending[--waiting];
+            
+            char from[16];
+            IcmpSocket::formatAddr(reply.addr, from, sizeof(from));
+            if(reply.type != ICMP_ECHO_REPLY) {
+                errors++;
+                ShellOutput::printf("From %s icmp_seq=%u %s\n", from, reply.seq,
+                                    reply.type == ICMP_TIME_EXCEEDED ? "Time to live exceeded"
+                                                                     : "Destination unreachable");
+                printed = true;
+                continue;
+            }
+            
+            uint32_t rtt = reply.rttUs;
+            if(received > 0) {
+                jitterSum += rtt > lastUs ? rtt - lastUs : lastUs - rtt;
+            }
+            lastUs = rtt;
+            received++;
+            sumUs += rtt;
+            sumSquares += (uint64_t)rtt * rtt;
+            if(rtt < minUs) minUs = rtt;
+            if(rtt > maxUs) maxUs = rtt;
+            
+            ShellOutput::printf("%u bytes from %s: icmp_seq=%u ttl=%u time=%lu.%03lu ms\n",
+                                reply.bytes, from, reply.seq, reply.ttl,
+                                (unsigned long)(rtt / 1000), (unsigned long)(rtt % 1000));
+            printed = true;
+        }
+        if(printed) {
+            ShellOutput::flush();
+        }
+    }
+    if(session->cancelled) {
+        ShellOutput::println("^C");
+    }
+    
+    unsigned long elapsed = millis() - started;
+    ShellOutput::println();
+    ShellOutput::printf("--- %s ping statistics ---\n", ipText);
+    ShellOutput::printf("%u packets transmitted, %u received, ", (unsigned)sent, (unsigned)received);
+    if(errors > 0) {
+        ShellOutput::printf("+%u errors, ", (unsigned)errors);
     }
+    ShellOutput::printf("%u%% packet loss, time %lums\n",
+                        sent > 0 ? (unsigned)(((sent - received) * 100) / sent) : 0, elapsed);
     
-    ShellOutput::printf("PING %s (%s) - %d packets\n", 
-                  host.c_str(), targetIP.toString().c_str(), count);
+    if(received > 0) {
+        double mean = (double)sumUs / received;
+        double variance = (double)sumSquares / received - mean * mean;
+        double mdev = variance > 0 ? sqrt(variance) : 0;
+        double jitter = received > 1 ? (double)jitterSum / (received - 1) : 0;
+        ShellOutput::printf("rtt min/avg/max/mdev = %.3f/%.3f/%.3f/%.3f ms, jitter %.3f ms\n",
+                            minUs / 1000.0, mean / 1000.0, maxUs / 1000.0,
+                            mdev / 1000.0, jitter / 1000.0);
+    }
+    
+    return session->cancelled ? SHELL_ERR_CANCELLED : SHELL_OK;
+}
+
+// a.b.c.d[/prefijo] -> primera dirección y número de hosts (orden de host).
+// Sin la de red ni la de broadcast salvo en /31 y /32.
+static bool parseSubnet(const char* text, uint32_t* first, uint32_t* count, int* prefix) {
+    char address[16];
+    const char* slash = strchr(text, '/');
+    size_t length = slash ? (size_t)(slash - text) : strlen(text);
+    if(length == 0 || length >= sizeof(address)) return false;
+    memcpy(address, text, length);
+    address[length] = '\0';
+    
+    IPAddress ip;
+    if(!ip.fromString(address)) return false;
+    *prefix = slash ? atoi(slash + 1) : 32;
+    if(*prefix < 0 || *prefix > 32) return false;
+    
+    uint32_t base = ((uint32_t)ip[0] << 24) | ((uint32_t)ip[1] << 16) | ((uint32_t)ip[2] << 8) | ip[3];
+    uint32_t mask = *prefix == 0 ? 0 : 0xFFFFFFFFUL << (32 - *prefix);
+    uint64_t size = 1ULL << (32 - *prefix);
+    base &= mask;
+    if(*prefix >= 31) {
+        *first = base;
+        *count = (uint32_t)size;
+    } else {
+        *first = base + 1;
+        *count = (uint32_t)(size - 2);
+    }
+    return true;
+}
+
+// Comando: pingsweep - Buscar hosts vivos en una subred
+// Uso: pingsweep <a.b.c.d/prefijo> [-w ventana] [-t timeout_ms] [-r reintentos]
+// Ejemplo: pingsweep 192.168.1.0/24
+//
+// Mantiene hasta 'ventana' echos en vuelo por un único socket ICMP y
+// casa las respuestas por secuencia (= índice del host), así que un /24
+// termina en unos segundos en lugar de minutos. Los hosts que no
+// responden se prueban otra vez en la siguiente pasada: en la red local
+// cada destino necesita ARP y la tabla de lwIP es pequeña, de modo que
+// con muchas resoluciones a la vez alguna petición se pierde.
+ShellError MiniShell::cmd_pingsweep(CommandArgs args) {
+    const char* target = NULL;
+    int window = SWEEP_WINDOW;
+    int timeoutMs = SWEEP_TIMEOUT_MS;
+    int retries = SWEEP_RETRIES;
+    
+    for(int i = 1; i < args.argc; i++) {
+        if(strcmp(args.argv[i], "-w") == 0 && i + 1 < args.argc) {
+            window = atoi(args.argv[++i]);
+        } else if(strcmp(args.argv[i], "-t") == 0 && i + 1 < args.argc) {
+            timeoutMs = atoi(args.argv[++i]);
+        } else if(strcmp(args.argv[i], "-r") == 0 && i + 1 < args.argc) {
+            retries = atoi(args.argv[++i]);
+        } else if(!target && args.argv[i][0] != '-') {
+            target = args.argv[i];
+        } else {
+            target = NULL;
+            break;
+        }
+    }
+    
+    uint32_t first, hosts;
+    int prefix;
+    if(!target || !parseSubnet(target, &first, &hosts, &prefix)) {
+        ShellOutput::println("Usage: pingsweep <a.b.c.d/prefix> [-w window] [-t timeout_ms] [-r retries]");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    if(hosts > SWEEP_MAX_HOSTS) {
+        ShellOutput::printf("ERROR: At most %d hosts (/22 or smaller)\n", SWEEP_MAX_HOSTS);
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    if(window < 1 || window > SWEEP_MAX_WINDOW) {
+        ShellOutput::printf("ERROR: Window must be between 1 and %d\n", SWEEP_MAX_WINDOW);
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    if(timeoutMs < 50 || timeoutMs > 10000 || retries < 0 || retries > 5) {
+        ShellOutput::println("ERROR: Timeout must be 50-10000 ms and retries 0-5");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    
+    if(WiFi.status() != WL_CONNECTED) {
+        ShellOutput::println("ERROR: WiFi not connected");
+        return SHELL_ERR_PERMISSION;
+    }
+    
+    IcmpSocket icmp;
+    if(!icmp.open()) {
+        ShellOutput::println("ERROR: Cannot open ICMP socket");
+        return SHELL_ERR_PERMISSION;
+    }
+    
+    char text[16];
+    IcmpSocket::formatAddr(htonl(first), text, sizeof(text));
+    ShellOutput::printf("PINGSWEEP %s (%u hosts from %s, window %d, timeout %d ms)\n",
+                        target, (unsigned)hosts, text, window, timeoutMs);
     ShellOutput::println("-------------------------------");
     
-    int success = 0;
-    int failed = 0;
-    unsigned long totalTime = 0;
-    unsigned long minTime = 999999;
-    unsigned long maxTime = 0;
+    // Hosts que ya respondieron (1 bit por host) y echos en vuelo
+    uint8_t answered[SWEEP_MAX_HOSTS / 8];
+    memset(answered, 0, sizeof(answered));
+    struct Probe {
+        uint16_t host;
+        unsigned long sentMs;
+    } inflight[SWEEP_MAX_WINDOW];
+    int active = 0;
     
-    for(int i = 0; i < count; i++) {
-        // Usar ping de la librería ESP32
-        int result = Ping.ping(targetIP, 1);
-        
-        if(result > 0) {
-            unsigned long avgTime = Ping.averageTime();
-            totalTime += avgTime;
-            success++;
+    uint32_t up = 0;
+    uint32_t sent = 0;
+    ShellSession* session = ShellSession::current();
+    unsigned long started = millis();
+    
+    for(int pass = 0; pass <= retries && up < hosts && !session->interrupted(); pass++) {
+        uint32_t next = 0;
+        while(!session->interrupted()) {
+            // Llenar la ventana con los que aún no han respondido
+            while(active < window && next < hosts) {
+                if(answered[next >> 3] & (1 << (next & 7))) {
+                    next++;
+                    continue;
+                }
+                // Sin hueco en la pila: seguir cuando vuelvan respuestas
+                // (sin nada en vuelo no llegará ninguna: saltar el host)
+                if(!icmp.send(htonl(first + next), (uint16_t)next)) {
+                    if(active > 0) break;
+                    next++;
+                    continue;
+                }
+                inflight[active].host = (uint16_t)next;
+                inflight[active].sentMs = millis();
+                active++;
+                next++;
+                sent++;
+            }
+            if(active == 0) break;
+            
+            // Esperar hasta el vencimiento más próximo (o 50 ms, por Ctrl+C)
+            unsigned long now = millis();
+            unsigned long wait = 50;
+            for(int k = 0; k < active; k++) {
+                unsigned long age = now - inflight[k].sentMs;
+                unsigned long left = age >= (unsigned long)timeoutMs ? 0 : timeoutMs - age;
+                if(left < wait) wait = left;
+            }
             
-            if(avgTime < minTime) minTime = avgTime;
-            if(avgTime > maxTime) maxTime = avgTime;
+            IcmpReply reply;
+            bool printed = false;
+            while(icmp.receive(&reply, wait)) {
+                wait = 0;   // Recoger lo que haya sin volver a esperar
+                uint32_t host = reply.seq;
+                if(reply.type != ICMP_ECHO_REPLY || host >= hosts) continue;
+                if(reply.addr != htonl(first + host)) continue;
+                if(answered[host >> 3] & (1 << (host & 7))) continue;
+                
+                // Las que llegan tras su timeout también cuentan
+                answered[host >> 3] |= 1 << (host & 7);
+                up++;
+                for(int k = 0; k < active; k++) {
+                    if(inflight[k].host == host) {
+                        inflight[k] = inflight[--active];
+                        break;
+                    }
+                }
+                IcmpSocket::formatAddr(reply.addr, text, sizeof(text));
+                ShellOutput::printf("%-15s  time=%lu.%03lu ms  ttl=%u\n", text,
+                                    (unsigned long)(reply.rttUs / 1000),
+                                    (unsigned long)(reply.rttUs % 1000), reply.ttl);
+                printed = true;
+            }
+            if(printed) {
+                ShellOutput::flush();
+            }
             
-            ShellOutput::printf("Reply from %s: time=%lums TTL=64\n", 
-                         targetIP.toString().c_str(), avgTime);
+            // Retirar los que han agotado su timeout
+            now = millis();
+            for(int k = 0; k < active; ) {
+                if(now - inflight[k].sentMs >= (unsigned long)timeoutMs) {
+                    inflight[k] = inflight[--active];
+                } else {
+                    k++;
+                }
+            }
+            if(active == 0 && next >= hosts) break;
+        }
+    }
+    
+    if(session->cancelled) {
+        ShellOutput::println("^C");
+    }
+    unsigned long elapsed = millis() - started;
+    ShellOutput::println();
+    ShellOutput::printf("--- %s sweep ---\n", target);
+    ShellOutput::printf("%u hosts up, %u without reply, %u echo requests sent in %lu.%lu s\n",
+                        (unsigned)up, (unsigned)(hosts - up), (unsigned)sent,
+                        elapsed / 1000, (elapsed % 1000) / 100);
+    
+    return session->cancelled ? SHELL_ERR_CANCELLED : SHELL_OK;
+}
+
+// Comando: tcping - Tiempo de conexión TCP a un puerto
+// Uso: tcping [-c count] [-i intervalo_s] [-W timeout_s] [-t] <host> <puerto>
+// Ejemplo: tcping 192.168.1.10 80 o tcping -t router 443
+ShellError MiniShell::cmd_tcping(CommandArgs args) {
+    const char* host = NULL;
+    long port = -1;
+    long count = TCPING_COUNT;
+    float intervalSec = TCPING_INTERVAL_MS / 1000.0f;
+    float timeoutSec = TCPING_TIMEOUT_MS / 1000.0f;
+    bool continuous = false;
+    
+    for(int i = 1; i < args.argc; i++) {
+        if(strcmp(args.argv[i], "-c") == 0 && i + 1 < args.argc) {
+            count = atol(args.argv[++i]);
+        } else if(strcmp(args.argv[i], "-i") == 0 && i + 1 < args.argc) {
+            intervalSec = atof(args.argv[++i]);
+        } else if(strcmp(args.argv[i], "-W") == 0 && i + 1 < args.argc) {
+            timeoutSec = atof(args.argv[++i]);
+        } else if(strcmp(args.argv[i], "-t") == 0) {
+            continuous = true;
+        } else if(!host && args.argv[i][0] != '-') {
+            host = args.argv[i];
+        } else if(host && port < 0) {
+            port = atol(args.argv[i]);
         } else {
-            failed++;
-            ShellOutput::printf("Request timeout for %s\n", targetIP.toString().c_str());
+            host = NULL;
+            break;
         }
+    }
+    
+    if(!host || port < 0) {
+        ShellOutput::println("Usage: tcping [-c count] [-i interval_s] [-W timeout_s] [-t] <host> <port>");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    if(port < 1 || port > 65535) {
+        ShellOutput::println("ERROR: Port must be between 1 and 65535");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    if(count == 0) continuous = true;
+    if(!continuous && (count < 1 || count > TCPING_MAX_COUNT)) {
+        ShellOutput::printf("ERROR: Count must be between 1 and %d (-t: until Ctrl+C)\n", TCPING_MAX_COUNT);
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    unsigned long intervalMs = (unsigned long)(intervalSec * 1000 + 0.5f);
+    unsigned long timeoutMs = (unsigned long)(timeoutSec * 1000 + 0.5f);
+    if(intervalMs < 50 || intervalMs > 60000 || timeoutMs < 10 || timeoutMs > 30000) {
+        ShellOutput::println("ERROR: Interval must be 0.05-60 s and timeout 0.01-30 s");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    
+    if(WiFi.status() != WL_CONNECTED) {
+        ShellOutput::println("ERROR: WiFi not connected");
+        return SHELL_ERR_PERMISSION;
+    }
+    
+    uint32_t addr;
+    char ipText[16];
+    if(!resolveHost(host, &addr, ipText, sizeof(ipText))) {
+        ShellOutput::println("ERROR: Cannot resolve hostname");
+        return SHELL_ERR_NOT_FOUND;
+    }
+    
+    ShellOutput::printf("TCPING %s (%s) port %ld\n", host, ipText, port);
+    
+    uint32_t sent = 0;
+    uint32_t connected = 0;
+    uint32_t minUs = 0xFFFFFFFF;
+    uint32_t maxUs = 0;
+    uint64_t sumUs = 0;
+    
+    // Una conexión cada vez: el intervalo cuenta desde el inicio de cada una
+    TcpProber prober(1, timeoutMs);
+    ShellSession* session = ShellSession::current();
+    while((continuous || sent < (uint32_t)count) && !session->interrupted()) {
+        unsigned long started = millis();
+        if(!prober.start(addr, (uint16_t)port)) {
+            ShellOutput::println("ERROR: No free sockets");
+            break;
+        }
+        sent++;
         
-        if(i < count - 1) delay(1000);
+        TcpProbeResult result;
+        while(!prober.poll(&result, 50)) {
+            if(session->interrupted()) break;
+        }
+        if(session->cancelled) break;
+        
+        uint32_t us = result.connectUs;
+        if(result.state == TCP_PROBE_OPEN) {
+            connected++;
+            sumUs += us;
+            if(us < minUs) minUs = us;
+            if(us > maxUs) maxUs = us;
+            ShellOutput::printf("Connected to %s:%ld: seq=%u time=%lu.%03lu ms\n",
+                                ipText, port, (unsigned)(sent - 1),
+                                (unsigned long)(us / 1000), (unsigned long)(us % 1000));
+        } else if(result.state == TCP_PROBE_CLOSED) {
+            ShellOutput::printf("Refused by %s:%ld: seq=%u time=%lu.%03lu ms\n",
+                                ipText, port, (unsigned)(sent - 1),
+                                (unsigned long)(us / 1000), (unsigned long)(us % 1000));
+        } else if(result.state == TCP_PROBE_TIMEOUT) {
+            ShellOutput::printf("Timeout for %s:%ld: seq=%u\n", ipText, port, (unsigned)(sent - 1));
+        } else {
+            ShellOutput::printf("Error for %s:%ld: seq=%u (%s)\n", ipText, port,
+                                (unsigned)(sent - 1), strerror(result.error));
+        }
+        
+        if(continuous || sent < (uint32_t)count) {
+            ShellOutput::flush();
+            unsigned long spent = millis() - started;
+            if(spent < intervalMs) session->sleep(intervalMs - spent);
+        }
+    }
+    if(session->cancelled) {
+        ShellOutput::println("^C");
     }
     
     ShellOutput::println();
-    ShellOutput::printf("--- %s ping statistics ---\n", targetIP.toString().c_str());
-    ShellOutput::printf("%d packets transmitted, %d received, %d%% packet loss\n", 
-                  count, success, (failed * 100) / count);
+    ShellOutput::printf("--- %s:%ld tcping statistics ---\n", ipText, port);
+    ShellOutput::printf("%u connects, %u successful, %u%% failed\n",
+                        (unsigned)sent, (unsigned)connected,
+                        sent > 0 ? (unsigned)(((sent - connected) * 100) / sent) : 0);
+    if(connected > 0) {
+        ShellOutput::printf("connect min/avg/max = %.3f/%.3f/%.3f ms\n",
+                            minUs / 1000.0, (double)sumUs / connected / 1000.0, maxUs / 1000.0);
+    }
     
-    if(success > 0) {
-        ShellOutput::printf("rtt min/avg/max = %lu/%lu/%lu ms\n", 
-                     minTime, totalTime / success, maxTime);
+    return session->cancelled ? SHELL_ERR_CANCELLED : SHELL_OK;
+}
+
+// "22,80,8000-8100" -> rangos [desde, hasta]
+static int parsePorts(const char* text, uint16_t ranges[][2], int maxRanges, uint32_t* total) {
+    int count = 0;
+    *total = 0;
+    const char* p = text;
+    while(*p) {
+        char* end;
+        long from = strtol(p, &end, 10);
+        long to = from;
+        if(end == p) return -1;
+        p = end;
+        if(*p == '-') {
+            p++;
+            to = strtol(p, &end, 10);
+            if(end == p) return -1;
+            p = end;
+        }
+        if(from < 1 || to > 65535 || from > to || count >= maxRanges) return -1;
+        ranges[count][0] = (uint16_t)from;
+        ranges[count][1] = (uint16_t)to;
+        *total += to - from + 1;
+        count++;
+        if(*p == ',') p++;
+        else if(*p) return -1;
     }
+    return count;
+}
+
+// Comando: portscan - Puertos TCP abiertos en un host
+// Uso: portscan [-w ventana] [-W timeout_s] [-v] <host> <puertos>
+// Ejemplo: portscan 192.168.1.10 1-1024 o portscan router 22,80,443,8080
+//
+// Con 'ventana' connect() en paralelo; cada puerto abierto se muestra
+// en cuanto se completa la conexión. -v muestra también los cerrados.
+ShellError MiniShell::cmd_portscan(CommandArgs args) {
+    const char* host = NULL;
+    const char* ports = NULL;
+    int window = PORTSCAN_WINDOW;
+    float timeoutSec = PORTSCAN_TIMEOUT_MS / 1000.0f;
+    bool verbose = false;
     
-    return SHELL_OK;
+    for(int i = 1; i < args.argc; i++) {
+        if(strcmp(args.argv[i], "-w") == 0 && i + 1 < args.argc) {
+            window = atoi(args.argv[++i]);
+        } else if(strcmp(args.argv[i], "-W") == 0 && i + 1 < args.argc) {
+            timeoutSec = atof(args.argv[++i]);
+        } else if(strcmp(args.argv[i], "-v") == 0) {
+            verbose = true;
+        } else if(!host && args.argv[i][0] != '-') {
+            host = args.argv[i];
+        } else if(host && !ports) {
+            ports = args.argv[i];
+        } else {
+            host = NULL;
+            break;
+        }
+    }
+    
+    uint16_t ranges[PORTSCAN_MAX_RANGES][2];
+    uint32_t total = 0;
+    int rangeCount = ports ? parsePorts(ports, ranges, PORTSCAN_MAX_RANGES, &total) : -1;
+    if(!host || rangeCount <= 0) {
+        ShellOutput::println("Usage: portscan [-w window] [-W timeout_s] [-v] <host> <ports>");
+        ShellOutput::println("  ports: 1-1024, 22,80,443 or a mix (up to 16 ranges)");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    unsigned long timeoutMs = (unsigned long)(timeoutSec * 1000 + 0.5f);
+    if(window < 1 || window > TCP_PROBE_MAX_WINDOW || timeoutMs < 10 || timeoutMs > 30000) {
+        ShellOutput::printf("ERROR: Window must be 1-%d and timeout 0.01-30 s\n", TCP_PROBE_MAX_WINDOW);
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    
+    if(WiFi.status() != WL_CONNECTED) {
+        ShellOutput::println("ERROR: WiFi not connected");
+        return SHELL_ERR_PERMISSION;
+    }
+    
+    uint32_t addr;
+    char ipText[16];
+    if(!resolveHost(host, &addr, ipText, sizeof(ipText))) {
+        ShellOutput::println("ERROR: Cannot resolve hostname");
+        return SHELL_ERR_NOT_FOUND;
+    }
+    
+    ShellOutput::printf("PORTSCAN %s (%s), %u ports, window %d, timeout %lu ms\n",
+                        host, ipText, (unsigned)total, window, timeoutMs);
+    ShellOutput::println("PORT       STATE     CONNECT");
+    
+    uint32_t counts[TCP_PROBE_ERROR + 1] = {0};
+    int range = 0;
+    uint32_t port = ranges[0][0];
+    
+    TcpProber prober(window, timeoutMs);
+    ShellSession* session = ShellSession::current();
+    unsigned long started = millis();
+    
+    while(!session->interrupted()) {
+        bool pending = range < rangeCount;
+        while(pending && !prober.full()) {
+            // Sin sockets libres en lwIP: esperar a que se cierre alguno
+            if(!prober.start(addr, (uint16_t)port)) break;
+            if(++port > ranges[range][1]) {
+                if(++range < rangeCount) port = ranges[range][0];
+            }
+            pending = range < rangeCount;
+        }
+        if(prober.active() == 0) {
+            if(!pending) break;
+            ShellOutput::println("ERROR: No free sockets");
+            break;
+        }
+        
+        TcpProbeResult result;
+        bool printed = false;
+        uint32_t wait = 50;
+        while(prober.poll(&result, wait)) {
+            wait = 0;
+            counts[result.state]++;
+            if(result.state == TCP_PROBE_OPEN || (verbose && result.state != TCP_PROBE_TIMEOUT)) {
+                ShellOutput::printf("%5u/tcp  %-8s  %lu.%03lu ms\n", result.port,
+                                    TcpProber::stateName(result.state),
+                                    (unsigned long)(result.connectUs / 1000),
+                                    (unsigned long)(result.connectUs % 1000));
+                printed = true;
+            }
+            if(range < rangeCount) break;   // Rellenar la ventana cuanto antes
+        }
+        if(printed) {
+            ShellOutput::flush();
+        }
+    }
+    
+    if(session->cancelled) {
+        ShellOutput::println("^C");
+    }
+    unsigned long elapsed = millis() - started;
+    ShellOutput::println();
+    ShellOutput::printf("--- %s portscan ---\n", ipText);
+    ShellOutput::printf("%u open, %u closed, %u filtered, %u errors in %lu.%lu s\n",
+                        (unsigned)counts[TCP_PROBE_OPEN], (unsigned)counts[TCP_PROBE_CLOSED],
+                        (unsigned)counts[TCP_PROBE_TIMEOUT], (unsigned)counts[TCP_PROBE_ERROR],
+                        elapsed / 1000, (elapsed % 1000) / 100);
+    
+    return session->cancelled ? SHELL_ERR_CANCELLED : SHELL_OK;
+}
+
+// Comando: netbench - Rendimiento de la red (estilo iperf)
+// Uso: netbench server [-p puerto] [-u] [-l bytes] [-i intervalo_s]
+//      netbench client <host> [-p puerto] [-t s] [-l bytes] [-P flujos] [-i s] [-u] [-b kbit/s]
+//      netbench sd <archivo> <host> [-p puerto] [-l bytes] [-i s]
+ShellError MiniShell::cmd_netbench(CommandArgs args) {
+    NetBenchConfig config;
+    memset(&config, 0, sizeof(config));
+    config.port = NETBENCH_PORT;
+    config.bufferSize = NETBENCH_BUFFER;
+    config.durationMs = NETBENCH_DURATION_S * 1000UL;
+    config.intervalMs = NETBENCH_INTERVAL_S * 1000UL;
+    config.streams = 1;
+    
+    const char* mode = args.argv[1];
+    const char* host = NULL;
+    int first = 2;
+    if(strcmp(mode, "server") == 0) {
+        config.mode = NETBENCH_SERVER;
+    } else if(strcmp(mode, "client") == 0 && args.argc > 2) {
+        config.mode = NETBENCH_CLIENT;
+        host = args.argv[2];
+        first = 3;
+    } else if(strcmp(mode, "sd") == 0 && args.argc > 3) {
+        config.mode = NETBENCH_SD;
+        config.path = args.argv[2];
+        host = args.argv[3];
+        first = 4;
+    } else {
+        first = -1;
+    }
+    
+    for(int i = first; i > 0 && i < args.argc; i++) {
+        const char* option = args.argv[i];
+        bool hasValue = i + 1 < args.argc;
+        if(strcmp(option, "-u") == 0 && config.mode != NETBENCH_SD) {
+            config.udp = true;
+        } else if(strcmp(option, "-p") == 0 && hasValue) {
+            config.port = atoi(args.argv[++i]);
+        } else if(strcmp(option, "-l") == 0 && hasValue) {
+            config.bufferSize = atol(args.argv[++i]);
+        } else if(strcmp(option, "-i") == 0 && hasValue) {
+            config.intervalMs = (uint32_t)(atof(args.argv[++i]) * 1000 + 0.5f);
+        } else if(strcmp(option, "-t") == 0 && hasValue && config.mode == NETBENCH_CLIENT) {
+            config.durationMs = atol(args.argv[++i]) * 1000UL;
+        } else if(strcmp(option, "-P") == 0 && hasValue && config.mode == NETBENCH_CLIENT) {
+            config.streams = atoi(args.argv[++i]);
+        } else if(strcmp(option, "-b") == 0 && hasValue && config.mode == NETBENCH_CLIENT) {
+            config.rateKbps = atol(args.argv[++i]);
+        } else {
+            first = -1;
+            break;
+        }
+    }
+    
+    if(first < 0) {
+        ShellOutput::println("Usage: netbench server [-p port] [-u] [-l bytes] [-i interval_s]");
+        ShellOutput::println("       netbench client <host> [-p port] [-t secs] [-l bytes] [-P streams]");
+        ShellOutput::println("                      [-i interval_s] [-u] [-b kbit/s]");
+        ShellOutput::println("       netbench sd <file> <host> [-p port] [-l bytes] [-i interval_s]");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    if(config.port < 1 || config.bufferSize < NETBENCH_MIN_BUFFER || config.bufferSize > NETBENCH_MAX_BUFFER) {
+        ShellOutput::printf("ERROR: Port must be 1-65535 and buffer %d-%d bytes\n",
+                            NETBENCH_MIN_BUFFER, NETBENCH_MAX_BUFFER);
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    if(config.durationMs < 1000 || config.durationMs > 3600000UL ||
+       config.streams < 1 || config.streams > NETBENCH_MAX_STREAMS) {
+        ShellOutput::printf("ERROR: Duration must be 1-3600 s and streams 1-%d\n", NETBENCH_MAX_STREAMS);
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    if(config.udp && config.streams > 1) {
+        ShellOutput::println("ERROR: UDP uses a single stream");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    
+    if(WiFi.status() != WL_CONNECTED) {
+        ShellOutput::println("ERROR: WiFi not connected");
+        return SHELL_ERR_PERMISSION;
+    }
+    
+    char ipText[16];
+    if(host && !resolveHost(host, &config.addr, ipText, sizeof(ipText))) {
+        ShellOutput::println("ERROR: Cannot resolve hostname");
+        return SHELL_ERR_NOT_FOUND;
+    }
+    
+    PathString path;
+    if(config.mode == NETBENCH_SD) {
+        path = shell.resolvePath(config.path);
+        if(path.isEmpty()) {
+            ShellOutput::println("ERROR: Invalid path");
+            return SHELL_ERR_INVALID_PATH;
+        }
+        config.path = path;
+    }
+    
+    return NetBench::run(&config);
 }
 
-// Comando: wifiscan - Escanear redes WiFi disponibles
+// Comando: wifiscan - Redes WiFi conocidas (caché) o escaneo nuevo
 ShellError MiniShell::cmd_wifiscan(CommandArgs args) {
-    ShellOutput::println("Scanning WiFi networks...");
+    bool refresh = false;
+    bool passive = false;
+    bool all = false;
+    long channel = 0;
+    bool valid = true;
     
-    WiFi.mode(WIFI_STA);
-    WiFi.disconnect();
-    delay(100);
+    for(int i = 1; i < args.argc; i++) {
+        if(strcmp(args.argv[i], "-r") == 0) {
+            refresh = true;
+        } else if(strcmp(args.argv[i], "-p") == 0) {
+            passive = true;
+            refresh = true;
+        } else if(strcmp(args.argv[i], "-c") == 0 && i + 1 < args.argc) {
+            channel = atol(args.argv[++i]);
+            refresh = true;
+        } else if(strcmp(args.argv[i], "-a") == 0) {
+            all = true;
+        } else {
+            valid = false;
+            break;
+        }
+    }
     
-    int n = WiFi.scanNetworks();
+    if(!valid) {
+        ShellOutput::println("Usage: wifiscan [-r] [-c channel] [-p] [-a]");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    if(channel < 0 || channel > 14) {
+        ShellOutput::println("ERROR: Channel must be between 1 and 14");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    
+    // Sin nada en caché hay que escanear de todos modos
+    WifiScanner::poll();
+    if(refresh || !WifiScanner::hasResults()) {
+        if(channel > 0) {
+            ShellOutput::printf("Scanning channel %ld%s...\n", channel, passive ? " (passive)" : "");
+        } else {
+            ShellOutput::printf("Scanning WiFi networks%s...\n", passive ? " (passive)" : "");
+        }
+        uint32_t previous = WifiScanner::lastScan();
+        if(!WifiScanner::start(channel, passive)) {
+            ShellOutput::println("ERROR: Scan failed");
+            return SHELL_ERR_NOT_FOUND;
+        }
+        
+        // El escaneo sigue aunque se cancele: lo recoge la tarea de monitoreo
+        ShellSession* session = ShellSession::current();
+        while(WifiScanner::scanning()) {
+            if(!session->sleep(100)) {
+                ShellOutput::println("^C");
+                return SHELL_ERR_CANCELLED;
+            }
+            WifiScanner::poll();
+        }
+        if(WifiScanner::lastScan() == previous) {
+            ShellOutput::println("ERROR: Scan failed");
+            return SHELL_ERR_NOT_FOUND;
+        }
+    }
     
-    if(n == 0) {
+    if(WifiScanner::count() == 0) {
         ShellOutput::println("No networks found");
         return SHELL_OK;
     }
     
     ShellOutput::println("\n=== Available WiFi Networks ===\n");
-    ShellOutput::println("SSID                             | RSSI | Channel | Encryption");
-    ShellOutput::println("----------------------------------------------------------------");
+    if(all) {
+        ShellOutput::println("SSID                             | BSSID             | RSSI | Channel | Encryption      | Seen");
+        ShellOutput::println("------------------------------------------------------------------------------------------------");
+    } else {
+        ShellOutput::println("SSID                             | RSSI | Channel | Encryption      | Seen");
+        ShellOutput::println("----------------------------------------------------------------------------");
+    }
+    
+    // La red conectada se marca con '*'
+    uint8_t connected[6] = {0};
+    uint8_t* currentBssid = WiFi.status() == WL_CONNECTED ? WiFi.BSSID() : NULL;
+    bool isConnected = currentBssid != NULL;
+    if(isConnected) {
+        memcpy(connected, currentBssid, sizeof(connected));
+    }
     
-    for(int i = 0; i < n; i++) {
-        String ssid = WiFi.SSID(i);
-        if(ssid.length() > 32) ssid = ssid.substring(0, 29) + "...";
+    uint32_t now = millis();
+    int shown = 0;
+    int total = WifiScanner::count();
+    WifiNetwork network;
+    WifiNetwork other;
+    for(int i = 0; WifiScanner::getNetwork(i, &network); i++) {
+        // Sin -a, una fila por SSID: la primera es la más fuerte
+        if(!all && network.ssid[0] != '\0') {
+            bool repeated = false;
+            for(int j = 0; j < i && !repeated; j++) {
+                repeated = WifiScanner::getNetwork(j, &other) && strcmp(other.ssid, network.ssid) == 0;
+            }
+            if(repeated) continue;
+        }
         
-        ShellOutput::printf("%-32s | %4d | %7d | ", 
-                     ssid.c_str(), 
-                     WiFi.RSSI(i), 
-                     WiFi.channel(i));
+        bool current = isConnected && memcmp(connected, network.bssid, sizeof(connected)) == 0;
+        char ssid[34];
+        snprintf(ssid, sizeof(ssid), "%s%s", current ? "*" : "",
+                 network.ssid[0] ? network.ssid : "(hidden)");
+        unsigned long age = (now - network.seenMs) / 1000;
         
-        switch(WiFi.encryptionType(i)) {
-            case WIFI_AUTH_OPEN:
-                ShellOutput::println("Open");
-                break;
-            case WIFI_AUTH_WEP:
-                ShellOutput::println("WEP");
-                break;
-            case WIFI_AUTH_WPA_PSK:
-                ShellOutput::println("WPA-PSK");
-                break;
-            case WIFI_AUTH_WPA2_PSK:
-                ShellOutput::println("WPA2-PSK");
-                break;
-            case WIFI_AUTH_WPA_WPA2_PSK:
-                ShellOutput::println("WPA/WPA2-PSK");
-                break;
-            case WIFI_AUTH_WPA2_ENTERPRISE:
-                ShellOutput::println("WPA2-Enterprise");
-                break;
-            default:
-                ShellOutput::println("Unknown");
-        }
-    }
-    
-    ShellOutput::printf("\nTotal: %d networks found\n", n);
-    WiFi.scanDelete();
+        if(all) {
+            char bssid[18];
+            WifiScanner::formatBssid(network.bssid, bssid, sizeof(bssid));
+            ShellOutput::printf("%-32.32s | %s | %4d | %7u | %-15s | %4lus\n", ssid, bssid,
+                                network.rssi, network.channel, WifiScanner::authName(network.auth), age);
+        } else {
+            ShellOutput::printf("%-32.32s | %4d | %7u | %-15s | %4lus\n", ssid,
+                                network.rssi, network.channel, WifiScanner::authName(network.auth), age);
+        }
+        shown++;
+    }
     
+    unsigned long scanAge = (now - WifiScanner::lastScan()) / 1000;
+    ShellOutput::printf("\nTotal: %d networks (%d access points), scanned %lus ago", shown, total, scanAge);
+    if(WifiScanner::lastChannel() != 0) {
+        ShellOutput::printf(" on channel %u", WifiScanner::lastChannel());
+    }
+    ShellOutput::println(WifiScanner::lastPassive() ? " (passive)" : "");
+    if(WifiScanner::scanning()) {
+        ShellOutput::println("A scan is in progress");
+    }
     return SHELL_OK;
 }
 
@@ -267,16 +1131,30 @@ ShellError MiniShell::cmd_wifiscan(CommandArgs args) {
 // Uso: wificonnect <ssid> <password>
 // Ejemplo: wificonnect "MyWiFi" "mypassword123"
 ShellError MiniShell::cmd_wificonnect(CommandArgs args) {
-    String ssid = args.argv[1];
-    String password = args.argv[2];
+    const char* ssid = args.argv[1];
+    const char* password = args.argv[2];
     
-    ShellOutput::printf("Connecting to '%s'...\n", ssid.c_str());
+    ShellOutput::printf("Connecting to '%s'...\n", ssid);
     
     WiFi.mode(WIFI_STA);
-    WiFi.begin(ssid.c_str(), password.c_str());
+    
+    // Si un escaneo reciente la vio, directo a su punto de acceso más fuerte
+    WifiNetwork best;
+    bool pinned = WifiScanner::findBest(ssid, &best);
+    if(pinned) {
+        WiFi.begin(ssid, password, best.channel, best.bssid);
+    } else {
+        WiFi.begin(ssid, password);
+    }
     
     int attempts = 0;
     while(WiFi.status() != WL_CONNECTED && attempts < 20) {
+        // El punto de acceso elegido no responde: cualquiera de la red
+        if(pinned && attempts == 10) {
+            WiFi.begin(ssid, password);
+            pinned = false;
+        }
+        ShellOutput::flush();
         delay(500);
         ShellOutput::print(".");
         attempts++;
@@ -284,17 +1162,15 @@ ShellError MiniShell::cmd_wificonnect(CommandArgs args) {
     ShellOutput::println();
     
     if(WiFi.status() == WL_CONNECTED) {
+        if(pinned) WifiScanner::unpinBssid();
+        char text[16];
         ShellOutput::println("Connected successfully!");
-        ShellOutput::print("IP Address: ");
-        ShellOutput::println(WiFi.localIP().toString());
-        ShellOutput::print("Gateway:    ");
-        ShellOutput::println(WiFi.gatewayIP().toString());
-        ShellOutput::print("RSSI:       ");
-        ShellOutput::print((int)WiFi.RSSI());
-        ShellOutput::println(" dBm");
+        ShellOutput::printf("IP Address: %s\n", formatIp(WiFi.localIP(), text, sizeof(text)));
+        ShellOutput::printf("Gateway:    %s\n", formatIp(WiFi.gatewayIP(), text, sizeof(text)));
+        ShellOutput::printf("RSSI:       %d dBm\n", (int)WiFi.RSSI());
         
         // NUEVO: Guardar credenciales en SD
-        if(NetworkConfigManager::saveWiFiCredentials(ssid.c_str(), password.c_str())) {
+        if(NetworkConfigManager::saveWiFiCredentials(ssid, password)) {
             ShellOutput::println("WiFi credentials saved to SD card");
         } else {
             ShellOutput::println("WARNING: Could not save credentials");
@@ -4,56 +4,64 @@
  */
 
 #include "networkConfig.h"
+#include "sysLog.h"
+#include "wifiScanner.h"
+
+// Quita espacios (y el '\r' de los finales de línea Windows) en ambos
+// extremos, sobre el propio buffer
+static char* trimSpaces(char* text) {
+    while(isspace((unsigned char)*text)) text++;
+    char* end = text + strlen(text);
+    while(end > text && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return text;
+}
 
 bool NetworkConfigManager::loadConfig(NetworkConfig* config) {
-    Serial.print("Looking for config at: ");
-    Serial.println(CONFIG_FILE);
-    Serial.print("File exists: ");
-    Serial.println(SD_MMC.exists(CONFIG_FILE) ? "YES" : "NO");
     if(!SD_MMC.exists(CONFIG_FILE)) {
-        Serial.println("Network config file not found");
+        SysLog::debug("netcfg", "%s not found", CONFIG_FILE);
         return false;
     }
     
     File file = SD_MMC.open(CONFIG_FILE, FILE_READ);
     if(!file) {
-        Serial.println("ERROR: Cannot open network config file");
+        SysLog::error("netcfg", "Cannot open %s", CONFIG_FILE);
         return false;
     }
     
     // Leer línea por línea
     memset(config, 0, sizeof(NetworkConfig));
     
+    char line[160];
     while(file.available()) {
-        String line = file.readStringUntil('\n');
-        line.trim();
+        size_t len = file.readBytesUntil('\n', line, sizeof(line) - 1);
+        line[len] = '\0';
+        char* text = trimSpaces(line);
         
         // Ignorar líneas vacías o comentarios
-        if(line.length() == 0 || line.startsWith("#")) {
+        if(text[0] == '\0' || text[0] == '#') {
             continue;
         }
         
         // Parsear key=value
-        int separatorIndex = line.indexOf('=');
-        if(separatorIndex > 0) {
-            String key = line.substring(0, separatorIndex);
-            String value = line.substring(separatorIndex + 1);
-            
-            key.trim();
-            value.trim();
+        char* separator = strchr(text, '=');
+        if(separator && separator > text) {
+            *separator = '\0';
+            const char* key = trimSpaces(text);
+            const char* value = trimSpaces(separator + 1);
             
-            if(key == "SSID") {
-                strncpy(config->ssid, value.c_str(), sizeof(config->ssid) - 1);
-            } else if(key == "PASSWORD") {
-                strncpy(config->password, value.c_str(), sizeof(config->password) - 1);
-            } else if(key == "USE_STATIC_IP") {
-                config->useStaticIP = (value == "true" || value == "1");
-            } else if(key == "STATIC_IP") {
-                strncpy(config->staticIP, value.c_str(), sizeof(config->staticIP) - 1);
-            } else if(key == "NETMASK") {
-                strncpy(config->netmask, value.c_str(), sizeof(config->netmask) - 1);
-            } else if(key == "GATEWAY") {
-                strncpy(config->gateway, value.c_str(), sizeof(config->gateway) - 1);
+            if(strcmp(key, "SSID") == 0) {
+                strncpy(config->ssid, value, sizeof(config->ssid) - 1);
+            } else if(strcmp(key, "PASSWORD") == 0) {
+                strncpy(config->password, value, sizeof(config->password) - 1);
+            } else if(strcmp(key, "USE_STATIC_IP") == 0) {
+                config->useStaticIP = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+            } else if(strcmp(key, "STATIC_IP") == 0) {
+                strncpy(config->staticIP, value, sizeof(config->staticIP) - 1);
+            } else if(strcmp(key, "NETMASK") == 0) {
+                strncpy(config->netmask, value, sizeof(config->netmask) - 1);
+            } else if(strcmp(key, "GATEWAY") == 0) {
+                strncpy(config->gateway, value, sizeof(config->gateway) - 1);
             }
         }
     }
@@ -65,7 +73,7 @@ bool NetworkConfigManager::loadConfig(NetworkConfig* config) {
 bool NetworkConfigManager::saveConfig(const NetworkConfig* config) {
     File file = SD_MMC.open(CONFIG_FILE, FILE_WRITE);
     if(!file) {
-        Serial.println("ERROR: Cannot write network config file");
+        SysLog::error("netcfg", "Cannot write %s", CONFIG_FILE);
         return false;
     }
     
@@ -95,7 +103,7 @@ bool NetworkConfigManager::saveConfig(const NetworkConfig* config) {
     }
     
     file.close();
-    Serial.println("Network configuration saved to SD card");
+    SysLog::info("netcfg", "Network configuration saved");
     return true;
 }
 
@@ -103,17 +111,16 @@ bool NetworkConfigManager::autoConnect() {
     NetworkConfig config;
     
     if(!loadConfig(&config)) {
-        Serial.println("No saved network configuration found");
+        SysLog::info("wifi", "No saved network configuration");
         return false;
     }
     
     if(strlen(config.ssid) == 0) {
-        Serial.println("ERROR: SSID is empty in config");
+        SysLog::error("wifi", "SSID is empty in %s", CONFIG_FILE);
         return false;
     }
     
-    Serial.print("Auto-connecting to WiFi: ");
-    Serial.println(config.ssid);
+    SysLog::info("wifi", "Auto-connecting to '%s'", config.ssid);
     
     // Configurar IP estática si está habilitada
     if(config.useStaticIP && strlen(config.staticIP) > 0) {
@@ -123,34 +130,59 @@ bool NetworkConfigManager::autoConnect() {
            netmask.fromString(config.netmask) && 
            gateway.fromString(config.gateway)) {
             
-            Serial.println("Configuring static IP...");
+            SysLog::info("wifi", "Using static IP %s", config.staticIP);
             WiFi.config(ip, gateway, netmask);
         } else {
-            Serial.println("WARNING: Invalid static IP configuration, using DHCP");
+            SysLog::warn("wifi", "Invalid static IP configuration, using DHCP");
         }
     }
     
-    // Conectar a WiFi
+    // Conectar a WiFi: un escaneo corto primero llena la caché de
+    // 'wifiscan' y permite ir al punto de acceso más fuerte de la red
     WiFi.mode(WIFI_STA);
-    WiFi.begin(config.ssid, config.password);
+    if(WifiScanner::start()) {
+        unsigned long scanStart = millis();
+        while(WifiScanner::scanning() && millis() - scanStart < WIFI_SCAN_BOOT_WAIT_MS) {
+            delay(50);
+            WifiScanner::poll();
+        }
+    }
+    
+    WifiNetwork best;
+    bool pinned = WifiScanner::findBest(config.ssid, &best);
+    if(pinned) {
+        char bssid[18];
+        WifiScanner::formatBssid(best.bssid, bssid, sizeof(bssid));
+        SysLog::info("wifi", "Using access point %s on channel %u (RSSI %d dBm)",
+                     bssid, best.channel, best.rssi);
+        WiFi.begin(config.ssid, config.password, best.channel, best.bssid);
+    } else {
+        SysLog::warn("wifi", "'%s' not seen in scan, connecting anyway", config.ssid);
+        WiFi.begin(config.ssid, config.password);
+    }
     
     int attempts = 0;
     while(WiFi.status() != WL_CONNECTED && attempts < 40) {
+        // El punto de acceso elegido no responde: cualquiera de la red
+        if(pinned && attempts == 20) {
+            SysLog::warn("wifi", "Access point not responding, retrying by SSID");
+            WiFi.begin(config.ssid, config.password);
+            pinned = false;
+        }
         delay(500);
-        Serial.print(".");
         attempts++;
     }
-    Serial.println();
     
     if(WiFi.status() == WL_CONNECTED) {
-        Serial.println("WiFi connected successfully!");
-        Serial.print("IP Address: ");
-        Serial.println(WiFi.localIP());
-        Serial.print("Gateway:    ");
-        Serial.println(WiFi.gatewayIP());
+        if(pinned) WifiScanner::unpinBssid();
+        IPAddress ip = WiFi.localIP();
+        IPAddress gateway = WiFi.gatewayIP();
+        SysLog::info("wifi", "Connected in %d ms: IP %u.%u.%u.%u, gateway %u.%u.%u.%u, RSSI %d dBm",
+                     attempts * 500, ip[0], ip[1], ip[2], ip[3],
+                     gateway[0], gateway[1], gateway[2], gateway[3], (int)WiFi.RSSI());
         return true;
     } else {
-        Serial.println("ERROR: WiFi connection failed");
+        SysLog::error("wifi", "Connection to '%s' failed", config.ssid);
         return false;
     }
 }
@@ -0,0 +1,286 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * profiler.cpp - Implementación del perfilador de comandos
+ */
+
+#include "profiler.h"
+#include "shell.h"
+#include "shellSession.h"
+#include <esp_heap_caps.h>
+
+CommandProfile* Profiler::profiles[PROF_MAX_COMMANDS] = {nullptr};
+
+static portMUX_TYPE profileLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Contadores de reservas de las tareas que están ejecutando un comando.
+// Cada contador solo lo incrementa su propia tarea (desde el hook).
+struct AllocSlot {
+    TaskHandle_t task;
+    uint8_t depth;              // executeLine anidados (scripts)
+    volatile uint32_t allocs;
+    volatile uint32_t bytes;
+};
+static AllocSlot allocSlots[PROF_ALLOC_SLOTS];
+
+#ifdef CONFIG_HEAP_USE_HOOKS
+// El IDF llama a este hook en cada reserva de cualquier tarea o
+// interrupción: tiene que ser corto, estar en IRAM y no reservar nada
+extern "C" void IRAM_ATTR esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) {
+    if(!ptr || xPortInIsrContext()) return;
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    for(int i = 0; i < PROF_ALLOC_SLOTS; i++) {
+        if(allocSlots[i].task == task) {
+            allocSlots[i].allocs++;
+            allocSlots[i].bytes += size;
+            return;
+        }
+    }
+}
+#endif
+
+bool Profiler::exactAllocs() {
+#ifdef CONFIG_HEAP_USE_HOOKS
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Empieza (o anida) el contador de la tarea actual. -1 si no hay hooks
+// o no queda hueco.
+int8_t Profiler::claimAllocSlot(uint32_t* allocs, uint32_t* bytes) {
+    if(!exactAllocs()) return -1;
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    int8_t slot = -1;
+    portENTER_CRITICAL(&profileLock);
+    for(int i = 0; i < PROF_ALLOC_SLOTS; i++) {
+        if(allocSlots[i].task == task) {
+            slot = i;
+            break;
+        }
+        if(slot < 0 && !allocSlots[i].task) slot = i;
+    }
+    if(slot >= 0) {
+        AllocSlot* s = &allocSlots[slot];
+        if(s->task != task) {
+            s->allocs = 0;
+            s->bytes = 0;
+            s->depth = 0;
+            s->task = task;
+        }
+        s->depth++;
+        *allocs = s->allocs;
+        *bytes = s->bytes;
+    }
+    portEXIT_CRITICAL(&profileLock);
+    return slot;
+}
+
+void Profiler::releaseAllocSlot(int8_t slot, uint32_t* allocs, uint32_t* bytes) {
+    portENTER_CRITICAL(&profileLock);
+    AllocSlot* s = &allocSlots[slot];
+    *allocs = s->allocs;
+    *bytes = s->bytes;
+    if(--s->depth == 0) {
+        s->task = nullptr;
+    }
+    portEXIT_CRITICAL(&profileLock);
+}
+
+// Reservas vivas en todo el sistema (recorre los heaps: solo sin hooks)
+static void heapTotals(uint32_t* blocks, uint32_t* bytes) {
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    *blocks = info.allocated_blocks;
+    *bytes = info.total_allocated_bytes;
+}
+
+// Tiempo de CPU de la tarea actual (contador de run-time de FreeRTOS,
+// en us con el esp_timer del core de Arduino)
+uint32_t Profiler::taskCpuUs() {
+#if configGENERATE_RUN_TIME_STATS == 1 && configUSE_TRACE_FACILITY == 1
+    TaskStatus_t status;
+    vTaskGetInfo(NULL, &status, pdFALSE, eRunning);
+    return status.ulRunTimeCounter;
+#else
+    return 0;
+#endif
+}
+
+void Profiler::begin(ProfileMark* mark, ShellSession* session) {
+    mark->startFree = ESP.getFreeHeap();
+    mark->startGlobalMin = ESP.getMinFreeHeap();
+    mark->startSdRead = session->sdBytesRead;
+    mark->startSdWritten = session->sdBytesWritten;
+    mark->allocSlot = claimAllocSlot(&mark->startAllocs, &mark->startAllocBytes);
+    if(mark->allocSlot < 0) {
+        heapTotals(&mark->startAllocs, &mark->startAllocBytes);
+    }
+    mark->startCpu = taskCpuUs();
+    mark->startUs = micros();
+}
+
+void Profiler::end(const ProfileMark* mark, ShellSession* session,
+                   const Command* command, ProfileSample* out) {
+    ProfileSample sample;
+    sample.wallUs = micros() - mark->startUs;
+    uint32_t cpu = taskCpuUs();
+    sample.cpuUs = cpu - mark->startCpu;
+
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t globalMin = ESP.getMinFreeHeap();
+    sample.heapDelta = (int32_t)(freeHeap - mark->startFree);
+
+    // El mínimo de heap es global y no se puede reiniciar. Si bajó
+    // durante el comando, el nuevo mínimo se alcanzó ahora (exacto);
+    // si no, lo único seguro es el menor valor visto al empezar/acabar.
+    if(globalMin < mark->startGlobalMin) {
+        sample.minFreeHeap = globalMin;
+        sample.minFreeExact = true;
+    } else {
+        sample.minFreeHeap = min(mark->startFree, freeHeap);
+        sample.minFreeExact = false;
+    }
+
+    sample.sdRead = session->sdBytesRead - mark->startSdRead;
+    sample.sdWritten = session->sdBytesWritten - mark->startSdWritten;
+
+    // Reservas: exactas con el contador de la tarea; si no, el neto de
+    // bloques vivos de todo el sistema (lo liberado antes de acabar no
+    // cuenta, y otras tareas pueden sumar o restar)
+    uint32_t allocs, allocBytes;
+    if(mark->allocSlot >= 0) {
+        releaseAllocSlot(mark->allocSlot, &allocs, &allocBytes);
+        sample.allocExact = true;
+    } else {
+        heapTotals(&allocs, &allocBytes);
+        sample.allocExact = false;
+    }
+    sample.allocs = allocs > mark->startAllocs ? allocs - mark->startAllocs : 0;
+    sample.allocBytes = allocBytes > mark->startAllocBytes ? allocBytes - mark->startAllocBytes : 0;
+    sample.peakBytes = mark->startFree > sample.minFreeHeap ? mark->startFree - sample.minFreeHeap : 0;
+    sample.largestFree = ESP.getMaxAllocHeap();
+    if(out) {
+        *out = sample;
+    }
+
+    int index = command - shell.getCommand(0);
+    if(index < 0 || index >= PROF_MAX_COMMANDS) {
+        return;
+    }
+
+    // Reservar el acumulado la primera vez (fuera del lock)
+    if(!profiles[index]) {
+        CommandProfile* profile = (CommandProfile*)calloc(1, sizeof(CommandProfile));
+        if(!profile) return;
+        profile->minFreeHeap = UINT32_MAX;
+        profile->minLargestFree = UINT32_MAX;
+        portENTER_CRITICAL(&profileLock);
+        if(!profiles[index]) {
+            profiles[index] = profile;
+            profile = nullptr;
+        }
+        portEXIT_CRITICAL(&profileLock);
+        free(profile);
+    }
+
+    int bucket = bucketOf(sample.wallUs);
+    portENTER_CRITICAL(&profileLock);
+    CommandProfile* profile = profiles[index];
+    profile->calls++;
+    profile->totalWallUs += sample.wallUs;
+    if(sample.wallUs > profile->maxWallUs) profile->maxWallUs = sample.wallUs;
+    profile->totalCpuUs += sample.cpuUs;
+    profile->totalHeapDelta += sample.heapDelta;
+    if(sample.minFreeHeap < profile->minFreeHeap) profile->minFreeHeap = sample.minFreeHeap;
+    profile->sdRead += sample.sdRead;
+    profile->sdWritten += sample.sdWritten;
+    profile->allocs += sample.allocs;
+    profile->allocBytes += sample.allocBytes;
+    if(sample.allocs > profile->maxAllocs) profile->maxAllocs = sample.allocs;
+    if(sample.peakBytes > profile->maxPeakBytes) profile->maxPeakBytes = sample.peakBytes;
+    if(profile->calls == 1) profile->firstLargestFree = sample.largestFree;
+    profile->lastLargestFree = sample.largestFree;
+    if(sample.largestFree < profile->minLargestFree) profile->minLargestFree = sample.largestFree;
+    profile->buckets[bucket]++;
+    portEXIT_CRITICAL(&profileLock);
+}
+
+void Profiler::countRead(size_t bytes) {
+    ShellSession::current()->sdBytesRead += bytes;
+}
+
+void Profiler::countWritten(size_t bytes) {
+    ShellSession::current()->sdBytesWritten += bytes;
+}
+
+bool Profiler::get(int index, CommandProfile* out) {
+    if(index < 0 || index >= PROF_MAX_COMMANDS) return false;
+    portENTER_CRITICAL(&profileLock);
+    bool used = profiles[index] && profiles[index]->calls > 0;
+    if(used) *out = *profiles[index];
+    portEXIT_CRITICAL(&profileLock);
+    return used;
+}
+
+void Profiler::reset() {
+    portENTER_CRITICAL(&profileLock);
+    for(int i = 0; i < PROF_MAX_COMMANDS; i++) {
+        if(profiles[i]) {
+            memset(profiles[i], 0, sizeof(CommandProfile));
+            profiles[i]->minFreeHeap = UINT32_MAX;
+            profiles[i]->minLargestFree = UINT32_MAX;
+        }
+    }
+    portEXIT_CRITICAL(&profileLock);
+}
+
+// Cubeta 0: < 16 us. Después dos por octava: [2^n, 1.5*2^n) y
+// [1.5*2^n, 2^(n+1))
+int Profiler::bucketOf(uint32_t us) {
+    if(us < (1u << PROF_MIN_SHIFT)) {
+        return 0;
+    }
+    int msb = 31 - __builtin_clz(us);
+    int half = (us >> (msb - 1)) & 1;
+    int bucket = 1 + (msb - PROF_MIN_SHIFT) * 2 + half;
+    return bucket < PROF_BUCKETS ? bucket : PROF_BUCKETS - 1;
+}
+
+uint32_t Profiler::bucketLimit(int bucket) {
+    if(bucket <= 0) {
+        return 1u << PROF_MIN_SHIFT;
+    }
+    int msb = PROF_MIN_SHIFT + (bucket - 1) / 2;
+    if(msb >= 31) {
+        return UINT32_MAX;
+    }
+    return (bucket - 1) % 2 ? (1u << (msb + 1)) : (1u << msb) + (1u << (msb - 1));
+}
+
+uint32_t Profiler::percentile(const CommandProfile* profile, int pct) {
+    if(profile->calls == 0) return 0;
+    // Posición (redondeada hacia arriba) de la muestra buscada
+    uint32_t target = ((uint64_t)profile->calls * pct + 99) / 100;
+    if(target == 0) target = 1;
+    uint32_t seen = 0;
+    for(int b = 0; b < PROF_BUCKETS; b++) {
+        seen += profile->buckets[b];
+        if(seen >= target) {
+            // La última cubeta no tiene límite: usar el máximo visto
+            if(b == PROF_BUCKETS - 1) return profile->maxWallUs;
+            return min(bucketLimit(b), profile->maxWallUs);
+        }
+    }
+    return profile->maxWallUs;
+}
+
+void Profiler::formatUs(char* buffer, size_t size, uint32_t us) {
+    if(us < 1000) {
+        snprintf(buffer, size, "%u us", (unsigned)us);
+    } else if(us < 1000000) {
+        snprintf(buffer, size, "%u.%u ms", (unsigned)(us / 1000), (unsigned)(us % 1000) / 100);
+    } else {
+        snprintf(buffer, size, "%u.%02u s", (unsigned)(us / 1000000), (unsigned)(us % 1000000) / 10000);
+    }
+}
@@ -0,0 +1,111 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * profiler.h - Latencia y recursos por comando (time, prof)
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+class ShellSession;
+struct Command;
+
+// Histograma logarítmico de tiempos de pared: dos cubetas por octava
+// desde 16 us (cubeta 0: < 16 us) hasta más de un minuto
+#define PROF_BUCKETS 48
+#define PROF_MIN_SHIFT 4
+// Igual que MiniShell::MAX_COMMANDS
+#define PROF_MAX_COMMANDS 48
+// Tareas que pueden estar ejecutando un comando a la vez (serial,
+// workers Telnet y de trabajos)
+#define PROF_ALLOC_SLOTS 8
+
+// Resultado de una ejecución (lo imprime 'time')
+struct ProfileSample {
+    uint32_t wallUs;
+    uint32_t cpuUs;         // 0 si no hay estadísticas de FreeRTOS
+    int32_t heapDelta;      // Heap libre al terminar - al empezar
+    uint32_t minFreeHeap;   // Mínimo de heap libre durante el comando
+    bool minFreeExact;      // false: cota superior (ver Profiler::end)
+    uint32_t sdRead;
+    uint32_t sdWritten;
+    uint32_t allocs;        // Reservas de heap hechas por el comando
+    uint32_t allocBytes;
+    bool allocExact;        // false: neto de todo el sistema (sin hooks)
+    uint32_t peakBytes;     // Heap libre al empezar - mínimo durante
+    uint32_t largestFree;   // Mayor bloque libre al terminar
+};
+
+// Marca tomada al empezar un comando
+struct ProfileMark {
+    uint32_t startUs;
+    uint32_t startCpu;
+    uint32_t startFree;
+    uint32_t startGlobalMin;
+    uint32_t startSdRead;
+    uint32_t startSdWritten;
+    uint32_t startAllocs;
+    uint32_t startAllocBytes;
+    int8_t allocSlot;       // -1: sin contador por tarea
+};
+
+// Acumulado de un comando registrado
+struct CommandProfile {
+    uint32_t calls;
+    uint64_t totalWallUs;
+    uint32_t maxWallUs;
+    uint64_t totalCpuUs;
+    int64_t totalHeapDelta;
+    uint32_t minFreeHeap;
+    uint64_t sdRead;
+    uint64_t sdWritten;
+    uint64_t allocs;
+    uint64_t allocBytes;
+    uint32_t maxAllocs;
+    uint32_t maxPeakBytes;
+    uint32_t firstLargestFree;  // Tendencia del mayor bloque libre
+    uint32_t lastLargestFree;   // (primera y última ejecución)
+    uint32_t minLargestFree;
+    uint32_t buckets[PROF_BUCKETS];
+};
+
+// Medición siempre activa en executeLine: unas pocas lecturas de
+// contadores por comando. Los acumulados de cada comando se reservan
+// la primera vez que se ejecuta.
+class Profiler {
+public:
+    static void begin(ProfileMark* mark, ShellSession* session);
+    static void end(const ProfileMark* mark, ShellSession* session,
+                    const Command* command, ProfileSample* out);
+
+    // Bytes de la SD leídos / escritos por el comando de esta tarea
+    static void countRead(size_t bytes);
+    static void countWritten(size_t bytes);
+
+    // true si el IDF tiene los hooks de heap (CONFIG_HEAP_USE_HOOKS):
+    // reservas exactas por tarea. Sin ellos solo hay el neto global.
+    static bool exactAllocs();
+
+    // Consulta: copia el acumulado del comando 'index' (false si no se usó)
+    static bool get(int index, CommandProfile* out);
+    static void reset();
+
+    // Percentil (0-100) a partir de las cubetas, en us (límite superior)
+    static uint32_t percentile(const CommandProfile* profile, int pct);
+    static uint32_t bucketLimit(int bucket);
+
+    // "850 us", "12.3 ms", "1.25 s"
+    static void formatUs(char* buffer, size_t size, uint32_t us);
+
+private:
+    static CommandProfile* profiles[PROF_MAX_COMMANDS];
+    static int bucketOf(uint32_t us);
+    static uint32_t taskCpuUs();
+    static int8_t claimAllocSlot(uint32_t* allocs, uint32_t* bytes);
+    static void releaseAllocSlot(int8_t slot, uint32_t* allocs, uint32_t* bytes);
+};
+
+#endif
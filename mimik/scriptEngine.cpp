@@ -0,0 +1,831 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * scriptEngine.cpp - Compilador a bytecode e intérprete de scripts
+ *
+ * Sintaxis soportada (una instrucción por línea, '#' comenta):
+ *   NAME=value                 variable ($NAME, ${NAME})
+ *   $0..$9, $#, $?             argumentos, número de argumentos, último código
+ *   if <cond> [; then] / else / fi
+ *   while <cond> [; do] / done
+ *   for VAR in a b c [; do] / done
+ *   break, exit [n], set -e / set +e
+ * Una condición es 'true', 'false', '[ expr ]' o cualquier comando
+ * (verdadera si devuelve SHELL_OK). Se puede negar con '!'.
+ */
+
+#include <new>
+#include "scriptEngine.h"
+#include "shellSession.h"
+#include "sshServer.h"
+#include "profiler.h"
+#include "tracer.h"
+#include "sysLog.h"
+#include "commandExecutor.h"
+
+// Instrucciones ejecutadas entre cesiones de CPU (watchdog)
+#define SCRIPT_YIELD_OPS 256
+
+ScriptProgram* ScriptEngine::programs[SCRIPT_CACHE_SLOTS];
+SemaphoreHandle_t ScriptEngine::mutex = NULL;
+unsigned long ScriptEngine::hits = 0;
+unsigned long ScriptEngine::misses = 0;
+
+// ============================================
+// Compilación
+// ============================================
+
+enum BlockType : uint8_t {
+    BLOCK_IF,
+    BLOCK_WHILE,
+    BLOCK_FOR
+};
+
+struct CompileBlock {
+    BlockType type;
+    uint16_t start;       // OP_TEST / OP_FOR que abre el bloque
+    int16_t elseJump;     // OP_JUMP al final del 'if' (-1 sin else)
+};
+
+struct Compiler {
+    ScriptOp* ops;
+    uint16_t opCount;
+    char* pool;
+    uint16_t poolSize;
+    CompileBlock blocks[SCRIPT_MAX_NESTING];
+    int depth;
+    int lineNumber;
+};
+
+static uint16_t addString(Compiler* c, const char* text, size_t len) {
+    if(len == 0) return 0;
+    uint16_t offset = c->poolSize;
+    memcpy(c->pool + offset, text, len);
+    c->pool[offset + len] = '\0';
+    c->poolSize += len + 1;
+    return offset;
+}
+
+static ScriptOp* addOp(Compiler* c, ScriptOpcode code) {
+    if(c->opCount >= SCRIPT_MAX_OPS) return nullptr;
+    ScriptOp* op = &c->ops[c->opCount++];
+    op->code = code;
+    op->flags = 0;
+    op->a = 0;
+    op->b = 0;
+    op->target = 0;
+    return op;
+}
+
+static bool compileError(Compiler* c, const char* message) {
+    ShellOutput::printf("script: line %d: %s\n", c->lineNumber, message);
+    return false;
+}
+
+static bool isNameChar(char ch, bool first) {
+    return ch == '_' || isalpha((unsigned char)ch) || (!first && isdigit((unsigned char)ch));
+}
+
+// 'cond' con '!' opcional delante
+static bool addTest(Compiler* c, const char* cond) {
+    ScriptOp* op = addOp(c, OP_TEST);
+    if(!op) return compileError(c, "script too long");
+    if(cond[0] == '!' && cond[1] == ' ') {
+        op->flags |= OPF_NEGATE;
+        cond += 2;
+        while(*cond == ' ') cond++;
+    }
+    if(*cond == '\0') return compileError(c, "missing condition");
+    op->a = addString(c, cond, strlen(cond));
+    return true;
+}
+
+static bool pushBlock(Compiler* c, BlockType type, uint16_t start) {
+    if(c->depth >= SCRIPT_MAX_NESTING) return compileError(c, "blocks nested too deep");
+    CompileBlock* block = &c->blocks[c->depth++];
+    block->type = type;
+    block->start = start;
+    block->elseJump = -1;
+    return true;
+}
+
+// Quita "; then" / "; do" del final de la línea
+static void stripSuffix(char* line, size_t* len, const char* word) {
+    size_t wordLen = strlen(word);
+    if(*len < wordLen + 1) return;
+    char* tail = line + *len - wordLen;
+    if(strcmp(tail, word) != 0) return;
+
+    char* p = tail;
+    while(p > line && p[-1] == ' ') p--;
+    if(p > line && p[-1] == ';') {
+        p--;
+        while(p > line && p[-1] == ' ') p--;
+        *p = '\0';
+        *len = p - line;
+    }
+}
+
+static bool compileLine(Compiler* c, char* line) {
+    size_t len = strlen(line);
+    stripSuffix(line, &len, "then");
+    stripSuffix(line, &len, "do");
+
+    // Primera palabra
+    char* rest = line;
+    while(*rest && *rest != ' ') rest++;
+    size_t wordLen = rest - line;
+    while(*rest == ' ') rest++;
+
+    #define KEYWORD(k) (wordLen == strlen(k) && strncmp(line, k, wordLen) == 0)
+
+    if(KEYWORD("then") || KEYWORD("do")) {
+        return true;
+    }
+
+    if(KEYWORD("if")) {
+        uint16_t start = c->opCount;
+        return addTest(c, rest) && pushBlock(c, BLOCK_IF, start);
+    }
+
+    if(KEYWORD("else")) {
+        if(c->depth == 0 || c->blocks[c->depth - 1].type != BLOCK_IF ||
+           c->blocks[c->depth - 1].elseJump >= 0) {
+            return compileError(c, "'else' without 'if'");
+        }
+        CompileBlock* block = &c->blocks[c->depth - 1];
+        ScriptOp* jump = addOp(c, OP_JUMP);
+        if(!jump) return compileError(c, "script too long");
+        block->elseJump = c->opCount - 1;
+        c->ops[block->start].target = c->opCount;
+        return true;
+    }
+
+    if(KEYWORD("fi")) {
+        if(c->depth == 0 || c->blocks[c->depth - 1].type != BLOCK_IF) {
+            return compileError(c, "'fi' without 'if'");
+        }
+        CompileBlock* block = &c->blocks[--c->depth];
+        if(block->elseJump >= 0) c->ops[block->elseJump].target = c->opCount;
+        else c->ops[block->start].target = c->opCount;
+        return true;
+    }
+
+    if(KEYWORD("while")) {
+        uint16_t start = c->opCount;
+        return addTest(c, rest) && pushBlock(c, BLOCK_WHILE, start);
+    }
+
+    if(KEYWORD("for")) {
+        // for VAR in lista
+        char* var = rest;
+        char* p = var;
+        while(*p && isNameChar(*p, p == var)) p++;
+        size_t varLen = p - var;
+        while(*p == ' ') p++;
+        if(varLen == 0 || varLen >= SCRIPT_VAR_NAME || strncmp(p, "in", 2) != 0 ||
+           (p[2] != ' ' && p[2] != '\0')) {
+            return compileError(c, "expected 'for NAME in ...'");
+        }
+        p += 2;
+        while(*p == ' ') p++;
+
+        uint16_t start = c->opCount;
+        ScriptOp* op = addOp(c, OP_FOR);
+        if(!op) return compileError(c, "script too long");
+        op->a = addString(c, var, varLen);
+        op->b = addString(c, p, strlen(p));
+        return pushBlock(c, BLOCK_FOR, start);
+    }
+
+    if(KEYWORD("done")) {
+        if(c->depth == 0 || c->blocks[c->depth - 1].type == BLOCK_IF) {
+            return compileError(c, "'done' without loop");
+        }
+        CompileBlock* block = &c->blocks[--c->depth];
+        ScriptOp* jump = addOp(c, OP_JUMP);
+        if(!jump) return compileError(c, "script too long");
+        jump->target = block->start;
+        c->ops[block->start].target = c->opCount;
+        return true;
+    }
+
+    if(KEYWORD("break")) {
+        int i = c->depth - 1;
+        while(i >= 0 && c->blocks[i].type == BLOCK_IF) i--;
+        if(i < 0) return compileError(c, "'break' outside a loop");
+        ScriptOp* op = addOp(c, OP_BREAK);
+        if(!op) return compileError(c, "script too long");
+        op->target = c->blocks[i].start;
+        return true;
+    }
+
+    if(KEYWORD("exit")) {
+        ScriptOp* op = addOp(c, OP_EXIT);
+        if(!op) return compileError(c, "script too long");
+        op->a = addString(c, rest, strlen(rest));
+        return true;
+    }
+
+    if(KEYWORD("set") && (strcmp(rest, "-e") == 0 || strcmp(rest, "+e") == 0)) {
+        ScriptOp* op = addOp(c, OP_ERREXIT);
+        if(!op) return compileError(c, "script too long");
+        op->flags = rest[0] == '-';
+        return true;
+    }
+
+    #undef KEYWORD
+
+    // NAME=valor
+    char* eq = line;
+    while(*eq && isNameChar(*eq, eq == line)) eq++;
+    if(*eq == '=' && eq > line) {
+        if(eq - line >= SCRIPT_VAR_NAME) return compileError(c, "variable name too long");
+        ScriptOp* op = addOp(c, OP_SET);
+        if(!op) return compileError(c, "script too long");
+        op->a = addString(c, line, eq - line);
+        op->b = addString(c, eq + 1, strlen(eq + 1));
+        return true;
+    }
+
+    ScriptOp* op = addOp(c, OP_EXEC);
+    if(!op) return compileError(c, "script too long");
+    op->a = addString(c, line, len);
+    return true;
+}
+
+ScriptProgram* ScriptEngine::compile(const char* path, File& file, ShellError* error) {
+    size_t size = file.size();
+    if(size > SCRIPT_MAX_SIZE) {
+        ShellOutput::println("ERROR: Script too large");
+        *error = SHELL_ERR_NO_SPACE;
+        return nullptr;
+    }
+
+    // Texto fuente y tablas temporales. Cada línea aporta como mucho su
+    // longitud + 1 al pool, así que size + 2 basta.
+    char* source = (char*)malloc(size + 1);
+    ScriptOp* ops = (ScriptOp*)malloc(sizeof(ScriptOp) * SCRIPT_MAX_OPS);
+    char* pool = (char*)malloc(size + 2);
+    if(!source || !ops || !pool) {
+        free(source);
+        free(ops);
+        free(pool);
+        ShellOutput::println("ERROR: Out of memory");
+        *error = SHELL_ERR_NO_SPACE;
+        return nullptr;
+    }
+
+    TRACE_BEGIN("sd.read", size);
+    size_t got = file.read((uint8_t*)source, size);
+    TRACE_END("sd.read", got);
+    source[got] = '\0';
+    Profiler::countRead(got);
+
+    Compiler c;
+    c.ops = ops;
+    c.opCount = 0;
+    c.pool = pool;
+    c.pool[0] = '\0';
+    c.poolSize = 1;
+    c.depth = 0;
+    c.lineNumber = 0;
+
+    bool ok = true;
+    char* cursor = source;
+    while(ok && *cursor) {
+        char* line = cursor;
+        char* end = strchr(cursor, '\n');
+        if(end) {
+            *end = '\0';
+            cursor = end + 1;
+        } else {
+            cursor += strlen(cursor);
+        }
+        c.lineNumber++;
+
+        // Recortar espacios, tabuladores y '\r'
+        for(char* p = line; *p; p++) {
+            if(*p == '\t') *p = ' ';
+        }
+        while(*line == ' ') line++;
+        size_t len = strlen(line);
+        while(len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\r')) line[--len] = '\0';
+
+        if(len == 0 || line[0] == '#') continue;
+        ok = compileLine(&c, line);
+    }
+
+    if(ok && c.depth > 0) {
+        ok = compileError(&c, c.blocks[c.depth - 1].type == BLOCK_IF ?
+                              "missing 'fi'" : "missing 'done'");
+    }
+
+    ScriptProgram* program = nullptr;
+    if(ok) {
+        // Un solo bloque: cabecera, instrucciones y texto
+        size_t opBytes = sizeof(ScriptOp) * c.opCount;
+        program = (ScriptProgram*)malloc(sizeof(ScriptProgram) + opBytes + c.poolSize);
+        if(program) {
+            strncpy(program->path, path, MAX_PATH_LENGTH - 1);
+            program->path[MAX_PATH_LENGTH - 1] = '\0';
+            program->mtime = file.getLastWrite();
+            program->size = size;
+            program->opCount = c.opCount;
+            program->poolSize = c.poolSize;
+            program->refs = 0;
+            program->lastUsed = millis();
+            program->ops = (ScriptOp*)(program + 1);
+            program->pool = (char*)program->ops + opBytes;
+            memcpy(program->ops, ops, opBytes);
+            memcpy(program->pool, pool, c.poolSize);
+        } else {
+            ShellOutput::println("ERROR: Out of memory");
+            *error = SHELL_ERR_NO_SPACE;
+        }
+    } else {
+        *error = SHELL_ERR_INVALID_ARGS;
+    }
+
+    free(source);
+    free(ops);
+    free(pool);
+    return program;
+}
+
+// ============================================
+// Cache de programas compilados
+// ============================================
+
+void ScriptEngine::begin() {
+    if(!mutex) {
+        mutex = xSemaphoreCreateMutex();
+    }
+}
+
+ScriptProgram* ScriptEngine::acquire(const char* path, ShellError* error) {
+    File file = SD_MMC.open(path, FILE_READ);
+    if(!file) {
+        ShellOutput::printf("ERROR: Cannot open script: %s\n", path);
+        *error = SHELL_ERR_NOT_FOUND;
+        return nullptr;
+    }
+    if(file.isDirectory()) {
+        file.close();
+        ShellOutput::println("ERROR: Is a directory");
+        *error = SHELL_ERR_INVALID_PATH;
+        return nullptr;
+    }
+
+    time_t mtime = file.getLastWrite();
+    size_t size = file.size();
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for(int i = 0; i < SCRIPT_CACHE_SLOTS; i++) {
+        ScriptProgram* program = programs[i];
+        if(program && program->mtime == mtime && program->size == size &&
+           strcmp(program->path, path) == 0) {
+            program->refs++;
+            program->lastUsed = millis();
+            hits++;
+            xSemaphoreGive(mutex);
+            file.close();
+            return program;
+        }
+    }
+    misses++;
+    xSemaphoreGive(mutex);
+
+    ScriptProgram* program = compile(path, file, error);
+    file.close();
+    if(!program) return nullptr;
+    program->refs = 1;
+
+    // Guardar en un hueco libre, en la versión antigua del mismo
+    // script o en el menos usado que no se esté ejecutando
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    int slot = -1;
+    for(int i = 0; i < SCRIPT_CACHE_SLOTS; i++) {
+        ScriptProgram* old = programs[i];
+        if(!old) {
+            if(slot < 0) slot = i;
+            continue;
+        }
+        if(old->refs > 0) continue;
+        if(strcmp(old->path, path) == 0) {
+            slot = i;
+            break;
+        }
+        if(slot < 0 || (programs[slot] && old->lastUsed < programs[slot]->lastUsed)) {
+            slot = i;
+        }
+    }
+    if(slot >= 0) {
+        free(programs[slot]);
+        programs[slot] = program;
+    }
+    xSemaphoreGive(mutex);
+
+    return program;
+}
+
+void ScriptEngine::release(ScriptProgram* program) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    program->refs--;
+    bool cached = false;
+    for(int i = 0; i < SCRIPT_CACHE_SLOTS; i++) {
+        if(programs[i] == program) cached = true;
+    }
+    // Decidido con el mutex tomado: solo el último en soltarlo libera
+    bool last = !cached && program->refs == 0;
+    xSemaphoreGive(mutex);
+
+    // Sin hueco en la cache (o sustituido): liberar al terminar
+    if(last) {
+        free(program);
+    }
+}
+
+int ScriptEngine::cachedPrograms() {
+    int count = 0;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for(int i = 0; i < SCRIPT_CACHE_SLOTS; i++) {
+        if(programs[i]) count++;
+    }
+    xSemaphoreGive(mutex);
+    return count;
+}
+
+// ============================================
+// Ejecución
+// ============================================
+
+struct ScriptVar {
+    char name[SCRIPT_VAR_NAME];
+    char value[SCRIPT_VAR_VALUE];
+};
+
+struct LoopFrame {
+    uint16_t pc;
+    uint16_t pos;
+    char list[MAX_CMD_LENGTH];
+};
+
+struct ScriptContext {
+    ScriptProgram* program;
+    int argc;
+    char** argv;
+    int status;
+    bool errexit;
+
+    ScriptVar vars[SCRIPT_MAX_VARS];
+    int varCount;
+
+    LoopFrame loops[SCRIPT_MAX_NESTING];
+    int loopDepth;
+
+    char line[MAX_CMD_LENGTH];
+};
+
+static const char* getVar(ScriptContext* ctx, const char* name, size_t len) {
+    for(int i = 0; i < ctx->varCount; i++) {
+        if(strlen(ctx->vars[i].name) == len && strncmp(ctx->vars[i].name, name, len) == 0) {
+            return ctx->vars[i].value;
+        }
+    }
+    return "";
+}
+
+static bool setVar(ScriptContext* ctx, const char* name, const char* value, size_t valueLen) {
+    ScriptVar* var = nullptr;
+    for(int i = 0; i < ctx->varCount; i++) {
+        if(strcmp(ctx->vars[i].name, name) == 0) {
+            var = &ctx->vars[i];
+            break;
+        }
+    }
+    if(!var) {
+        if(ctx->varCount >= SCRIPT_MAX_VARS) {
+            ShellOutput::println("script: too many variables");
+            return false;
+        }
+        var = &ctx->vars[ctx->varCount++];
+        strncpy(var->name, name, SCRIPT_VAR_NAME - 1);
+        var->name[SCRIPT_VAR_NAME - 1] = '\0';
+    }
+    valueLen = min(valueLen, (size_t)SCRIPT_VAR_VALUE - 1);
+    memcpy(var->value, value, valueLen);
+    var->value[valueLen] = '\0';
+    return true;
+}
+
+// Sustituye $NAME, ${NAME}, $0..$9, $# y $? en 'src'
+static void expand(ScriptContext* ctx, const char* src, char* dst, size_t size) {
+    size_t out = 0;
+    char number[12];
+
+    while(*src && out < size - 1) {
+        if(src[0] == '\\' && src[1] == '$') {
+            dst[out++] = '$';
+            src += 2;
+            continue;
+        }
+        if(*src != '$') {
+            dst[out++] = *src++;
+            continue;
+        }
+
+        const char* value = nullptr;
+        src++;
+        if(*src == '?') {
+            snprintf(number, sizeof(number), "%d", ctx->status);
+            value = number;
+            src++;
+        } else if(*src == '#') {
+            snprintf(number, sizeof(number), "%d", ctx->argc > 0 ? ctx->argc - 1 : 0);
+            value = number;
+            src++;
+        } else if(isdigit((unsigned char)*src)) {
+            int index = *src - '0';
+            value = index < ctx->argc ? ctx->argv[index] : "";
+            src++;
+        } else if(*src == '{') {
+            const char* close = strchr(src, '}');
+            if(close) {
+                value = getVar(ctx, src + 1, close - src - 1);
+                src = close + 1;
+            } else {
+                value = "${";
+                src++;
+            }
+        } else if(isNameChar(*src, true)) {
+            const char* name = src;
+            while(isNameChar(*src, false)) src++;
+            value = getVar(ctx, name, src - name);
+        } else {
+            value = "$";
+        }
+
+        while(*value && out < size - 1) dst[out++] = *value++;
+    }
+    dst[out] = '\0';
+}
+
+// Palabras de '[ ... ]'; las comillas dobles agrupan (y permiten "")
+static int splitTest(char* text, char** words, int maxWords) {
+    int count = 0;
+    char* p = text;
+    while(*p && count < maxWords) {
+        while(*p == ' ') p++;
+        if(!*p) break;
+        if(*p == '"') {
+            words[count++] = ++p;
+            while(*p && *p != '"') p++;
+        } else {
+            words[count++] = p;
+            while(*p && *p != ' ') p++;
+        }
+        if(*p) *p++ = '\0';
+    }
+    return count;
+}
+
+bool ScriptEngine::evalTest(char* expr, bool* valid) {
+    char* words[4];
+    int count = splitTest(expr, words, 4);
+    *valid = true;
+
+    if(count == 1) {
+        return words[0][0] != '\0';
+    }
+
+    if(count == 2) {
+        const char* op = words[0];
+        const char* arg = words[1];
+        if(strcmp(op, "-z") == 0) return arg[0] == '\0';
+        if(strcmp(op, "-n") == 0) return arg[0] != '\0';
+        if(strcmp(op, "-e") == 0 || strcmp(op, "-f") == 0 || strcmp(op, "-d") == 0) {
+            PathString path = shell.resolvePath(arg);
+            if(!CommandExecutor::acquire(CMD_RES_SD_READ, ShellSession::current())) return false;
+            File file = SD_MMC.open(path);
+            bool exists = file;
+            bool isDir = exists && file.isDirectory();
+            if(file) file.close();
+            CommandExecutor::release(CMD_RES_SD_READ);
+            if(!exists) return false;
+            if(op[1] == 'f') return !isDir;
+            if(op[1] == 'd') return isDir;
+            return true;
+        }
+    }
+
+    if(count == 3) {
+        const char* left = words[0];
+        const char* op = words[1];
+        const char* right = words[2];
+        if(strcmp(op, "=") == 0 || strcmp(op, "==") == 0) return strcmp(left, right) == 0;
+        if(strcmp(op, "!=") == 0) return strcmp(left, right) != 0;
+
+        long a = atol(left);
+        long b = atol(right);
+        if(strcmp(op, "-eq") == 0) return a == b;
+        if(strcmp(op, "-ne") == 0) return a != b;
+        if(strcmp(op, "-lt") == 0) return a < b;
+        if(strcmp(op, "-le") == 0) return a <= b;
+        if(strcmp(op, "-gt") == 0) return a > b;
+        if(strcmp(op, "-ge") == 0) return a >= b;
+    }
+
+    *valid = false;
+    return false;
+}
+
+// Evalúa la condición de OP_TEST; deja el código en ctx->status
+bool ScriptEngine::evalCondition(ScriptContext* ctx, const ScriptOp* op, ShellError* error) {
+    expand(ctx, ctx->program->pool + op->a, ctx->line, sizeof(ctx->line));
+    char* cond = ctx->line;
+    size_t len = strlen(cond);
+    bool result;
+
+    if(strcmp(cond, "true") == 0) {
+        result = true;
+    } else if(strcmp(cond, "false") == 0) {
+        result = false;
+    } else if(len >= 2 && cond[0] == '[' && cond[len - 1] == ']') {
+        cond[len - 1] = '\0';
+        bool valid;
+        result = evalTest(cond + 1, &valid);
+        if(!valid) {
+            ShellOutput::printf("script: bad test: %s]\n", ctx->program->pool + op->a);
+            *error = SHELL_ERR_INVALID_ARGS;
+            return false;
+        }
+    } else {
+        result = shell.executeLine(cond) == SHELL_OK;
+    }
+
+    if(op->flags & OPF_NEGATE) result = !result;
+    ctx->status = result ? SHELL_OK : 1;
+    return result;
+}
+
+ShellError ScriptEngine::execute(ScriptContext* ctx) {
+    ScriptProgram* program = ctx->program;
+    const char* pool = program->pool;
+    uint16_t pc = 0;
+    unsigned long steps = 0;
+
+    ShellSession* session = ShellSession::current();
+
+    while(pc < program->opCount) {
+        const ScriptOp* op = &program->ops[pc];
+
+        if(session->interrupted()) {
+            return SHELL_ERR_CANCELLED;
+        }
+
+        if(++steps % SCRIPT_YIELD_OPS == 0) {
+            vTaskDelay(1);
+        }
+
+        switch(op->code) {
+            case OP_EXEC: {
+                expand(ctx, pool + op->a, ctx->line, sizeof(ctx->line));
+                ShellError err = shell.executeLine(ctx->line);
+                ctx->status = err;
+                if(err != SHELL_OK && ctx->errexit) return err;
+                pc++;
+                break;
+            }
+
+            case OP_SET: {
+                char value[SCRIPT_VAR_VALUE];
+                expand(ctx, pool + op->b, value, sizeof(value));
+                if(!setVar(ctx, pool + op->a, value, strlen(value))) return SHELL_ERR_NO_SPACE;
+                pc++;
+                break;
+            }
+
+            case OP_TEST: {
+                ShellError error = SHELL_OK;
+                bool result = evalCondition(ctx, op, &error);
+                if(error != SHELL_OK) return error;
+                pc = result ? pc + 1 : op->target;
+                break;
+            }
+
+            case OP_JUMP:
+                pc = op->target;
+                break;
+
+            case OP_FOR: {
+                LoopFrame* frame = nullptr;
+                if(ctx->loopDepth > 0 && ctx->loops[ctx->loopDepth - 1].pc == pc) {
+                    frame = &ctx->loops[ctx->loopDepth - 1];
+                } else {
+                    if(ctx->loopDepth >= SCRIPT_MAX_NESTING) return SHELL_ERR_NO_SPACE;
+                    frame = &ctx->loops[ctx->loopDepth++];
+                    frame->pc = pc;
+                    frame->pos = 0;
+                    expand(ctx, pool + op->b, frame->list, sizeof(frame->list));
+                }
+
+                const char* p = frame->list + frame->pos;
+                while(*p == ' ') p++;
+                if(*p == '\0') {
+                    ctx->loopDepth--;
+                    pc = op->target;
+                    break;
+                }
+                const char* word = p;
+                while(*p && *p != ' ') p++;
+                frame->pos = p - frame->list;
+                if(!setVar(ctx, pool + op->a, word, p - word)) return SHELL_ERR_NO_SPACE;
+                pc++;
+                break;
+            }
+
+            case OP_BREAK: {
+                const ScriptOp* loop = &program->ops[op->target];
+                if(loop->code == OP_FOR && ctx->loopDepth > 0 &&
+                   ctx->loops[ctx->loopDepth - 1].pc == op->target) {
+                    ctx->loopDepth--;
+                }
+                pc = loop->target;
+                break;
+            }
+
+            case OP_EXIT: {
+                char code[12];
+                expand(ctx, pool + op->a, code, sizeof(code));
+                return code[0] ? (ShellError)atoi(code) : (ShellError)ctx->status;
+            }
+
+            case OP_ERREXIT:
+                ctx->errexit = op->flags != 0;
+                pc++;
+                break;
+        }
+    }
+
+    return SHELL_OK;
+}
+
+ShellError ScriptEngine::run(const char* path, int argc, char** argv) {
+    ShellSession* session = ShellSession::current();
+    if(session->scriptDepth >= SCRIPT_MAX_DEPTH) {
+        ShellOutput::println("ERROR: Scripts nested too deep");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+
+    // 'source' no reserva la SD al registrarse (sus comandos reservan lo
+    // suyo): solo la carga del script la lee
+    if(!CommandExecutor::acquire(CMD_RES_SD_READ, session)) {
+        ShellOutput::println("^C");
+        return SHELL_ERR_CANCELLED;
+    }
+    PathString fullPath = shell.resolvePath(path);
+    ShellError error = SHELL_OK;
+    ScriptProgram* program = acquire(fullPath.c_str(), &error);
+    CommandExecutor::release(CMD_RES_SD_READ);
+    if(!program) return error;
+
+    ScriptContext* ctx = new (std::nothrow) ScriptContext;
+    if(!ctx) {
+        release(program);
+        ShellOutput::println("ERROR: Out of memory");
+        return SHELL_ERR_NO_SPACE;
+    }
+    ctx->program = program;
+    ctx->argc = argc;
+    ctx->argv = argv;
+    ctx->status = SHELL_OK;
+    ctx->errexit = false;
+    ctx->varCount = 0;
+    ctx->loopDepth = 0;
+
+    session->scriptDepth++;
+    error = execute(ctx);
+    session->scriptDepth--;
+
+    delete ctx;
+    release(program);
+    return error;
+}
+
+void ScriptEngine::autorun() {
+    ShellSession* session = ShellSession::current();
+    if(!CommandExecutor::acquire(CMD_RES_SD_READ, session)) return;
+    bool present = SD_MMC.exists(AUTORUN_SCRIPT);
+    CommandExecutor::release(CMD_RES_SD_READ);
+    if(!present) return;
+
+    // Como 'source' desde el prompt: es el comando en curso durante todo
+    // el script, así que Ctrl+C lo cancela también entre dos comandos
+    SysLog::info("script", "Running " AUTORUN_SCRIPT);
+    char line[] = "source " AUTORUN_SCRIPT;
+    session->resetCancel();
+    ShellError err = shell.executeLine(line);
+    if(err != SHELL_OK) {
+        SysLog::warn("script", AUTORUN_SCRIPT " finished with code %d", err);
+    }
+}
@@ -0,0 +1,100 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * scriptEngine.h - Ejecución de scripts (source / sh)
+ */
+
+#ifndef SCRIPT_ENGINE_H
+#define SCRIPT_ENGINE_H
+
+#include <Arduino.h>
+#include <SD_MMC.h>
+#include <freertos/semphr.h>
+#include "shell.h"
+
+#define AUTORUN_SCRIPT "/autorun.sh"
+
+// Límites de un script
+#define SCRIPT_MAX_SIZE 8192     // Tamaño máximo del archivo
+#define SCRIPT_MAX_OPS 512       // Instrucciones tras compilar
+#define SCRIPT_MAX_NESTING 8     // Bloques if/while/for anidados
+#define SCRIPT_MAX_DEPTH 4       // 'source' dentro de 'source'
+
+// Variables de una ejecución
+#define SCRIPT_MAX_VARS 16
+#define SCRIPT_VAR_NAME 16
+#define SCRIPT_VAR_VALUE 64
+
+// Programas compilados recordados (clave: ruta + fecha + tamaño)
+#define SCRIPT_CACHE_SLOTS 4
+
+// Instrucciones del bytecode
+enum ScriptOpcode : uint8_t {
+    OP_EXEC,      // a: línea de comando
+    OP_SET,       // a: nombre, b: valor
+    OP_TEST,      // a: condición; si es falsa salta a 'target'
+    OP_JUMP,      // salta a 'target'
+    OP_FOR,       // a: variable, b: lista; al agotarse salta a 'target'
+    OP_BREAK,     // target: instrucción del bucle (OP_TEST/OP_FOR)
+    OP_EXIT,      // a: código de salida (opcional)
+    OP_ERREXIT    // 'set -e': abortar en el primer error
+};
+
+// Las cadenas (a, b) son desplazamientos dentro del pool de texto.
+// El desplazamiento 0 es siempre la cadena vacía.
+struct ScriptOp {
+    ScriptOpcode code;
+    uint8_t flags;
+    uint16_t a;
+    uint16_t b;
+    uint16_t target;
+};
+
+#define OPF_NEGATE 0x01   // 'if ! cond'
+
+// Script compilado: un único bloque con instrucciones y pool de texto
+struct ScriptProgram {
+    char path[MAX_PATH_LENGTH];
+    time_t mtime;
+    size_t size;
+    uint16_t opCount;
+    uint16_t poolSize;
+    uint8_t refs;           // Ejecuciones en curso (no se libera)
+    unsigned long lastUsed;
+    ScriptOp* ops;
+    char* pool;
+};
+
+struct ScriptContext;
+
+class ScriptEngine {
+public:
+    static void begin();
+
+    // Ejecuta 'path' con argumentos ($0 = path, $1..$9)
+    static ShellError run(const char* path, int argc, char** argv);
+
+    // Ejecuta /autorun.sh si existe (desde la tarea del shell)
+    static void autorun();
+
+    // Estadísticas de la cache de bytecode
+    static int cachedPrograms();
+    static unsigned long cacheHits() { return hits; }
+    static unsigned long cacheMisses() { return misses; }
+
+private:
+    static ScriptProgram* programs[SCRIPT_CACHE_SLOTS];
+    static SemaphoreHandle_t mutex;
+    static unsigned long hits;
+    static unsigned long misses;
+
+    static ScriptProgram* acquire(const char* path, ShellError* error);
+    static void release(ScriptProgram* program);
+    static ScriptProgram* compile(const char* path, File& file, ShellError* error);
+
+    // Intérprete
+    static ShellError execute(ScriptContext* ctx);
+    static bool evalCondition(ScriptContext* ctx, const ScriptOp* op, ShellError* error);
+    static bool evalTest(char* expr, bool* valid);
+};
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * sdSpace.cpp - Implementación del contador de espacio de la SD
+ */
+
+#include "sdSpace.h"
+
+uint64_t SdSpace::totalBytes = 0;
+int64_t SdSpace::usedBytes = 0;
+int64_t SdSpace::drift = 0;
+unsigned long SdSpace::scannedAt = 0;
+unsigned long SdSpace::scanDuration = 0;
+
+static portMUX_TYPE spaceLock = portMUX_INITIALIZER_UNLOCKED;
+
+// El llamador debe impedir escrituras mientras tanto (CMD_RES_SD_READ),
+// si no un ajuste concurrente se contaría dos veces o ninguna
+bool SdSpace::reconcile() {
+    if(SD_MMC.cardType() == CARD_NONE) {
+        return false;
+    }
+
+    unsigned long start = millis();
+    uint64_t scannedTotal = SD_MMC.totalBytes();
+    uint64_t scannedUsed = SD_MMC.usedBytes();
+    unsigned long now = millis();
+
+    portENTER_CRITICAL(&spaceLock);
+    drift = scannedAt ? (int64_t)scannedUsed - usedBytes : 0;
+    totalBytes = scannedTotal;
+    usedBytes = scannedUsed;
+    scanDuration = now - start;
+    scannedAt = now ? now : 1;
+    portEXIT_CRITICAL(&spaceLock);
+    return true;
+}
+
+void SdSpace::adjust(int64_t delta) {
+    if(delta == 0) return;
+    portENTER_CRITICAL(&spaceLock);
+    usedBytes += delta;
+    if(usedBytes < 0) usedBytes = 0;
+    if(totalBytes && usedBytes > (int64_t)totalBytes) usedBytes = totalBytes;
+    portEXIT_CRITICAL(&spaceLock);
+}
+
+int64_t SdSpace::sizeOf(const char* path) {
+    if(!SD_MMC.exists(path)) {
+        return 0;
+    }
+    File file = SD_MMC.open(path, FILE_READ);
+    if(!file) {
+        return 0;
+    }
+    int64_t size = file.isDirectory() ? 0 : file.size();
+    file.close();
+    return size;
+}
+
+uint64_t SdSpace::total() {
+    portENTER_CRITICAL(&spaceLock);
+    uint64_t value = totalBytes;
+    portEXIT_CRITICAL(&spaceLock);
+    return value;
+}
+
+uint64_t SdSpace::used() {
+    portENTER_CRITICAL(&spaceLock);
+    uint64_t value = usedBytes;
+    portEXIT_CRITICAL(&spaceLock);
+    return value;
+}
+
+uint64_t SdSpace::available() {
+    portENTER_CRITICAL(&spaceLock);
+    uint64_t value = totalBytes - usedBytes;
+    portEXIT_CRITICAL(&spaceLock);
+    return value;
+}
+
+unsigned long SdSpace::age() {
+    return known() ? millis() - scannedAt : 0;
+}
+
+bool SdSpace::due() {
+    return !known() || age() >= SDSPACE_RECONCILE_MS;
+}
@@ -0,0 +1,54 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * sdSpace.h - Contador incremental del espacio usado en la SD
+ */
+
+#ifndef SD_SPACE_H
+#define SD_SPACE_H
+
+#include <Arduino.h>
+#include <SD_MMC.h>
+
+// Cada cuánto se vuelve a recorrer la FAT para corregir el contador
+#define SDSPACE_RECONCILE_MS 600000
+
+// SD_MMC.usedBytes() recorre la tabla FAT: en tarjetas grandes tarda
+// segundos y ocupa el bus de la SD. Se hace una vez al montar (desde
+// sdMonitorTask) y cada SDSPACE_RECONCILE_MS; entre medias los
+// comandos de archivos ajustan el contador con lo que escriben o
+// borran. El ajuste es en bytes: el redondeo a clusters y lo que
+// escriban otros (historial, configuración) lo corrige la siguiente
+// reconciliación.
+class SdSpace {
+public:
+    // Recorrido completo (lento). Devuelve false si no hay tarjeta.
+    static bool reconcile();
+
+    // Ajustes de los comandos de archivos
+    static void adjust(int64_t delta);
+    static void fileChanged(int64_t oldSize, int64_t newSize) { adjust(newSize - oldSize); }
+
+    // Tamaño de 'path' si es un archivo (0 si no existe)
+    static int64_t sizeOf(const char* path);
+
+    static bool known() { return scannedAt != 0; }
+    static uint64_t total();
+    static uint64_t used();
+    static uint64_t available();
+
+    // Milisegundos desde la última reconciliación
+    static unsigned long age();
+    static unsigned long lastScanMs() { return scanDuration; }
+    // Corrección aplicada en la última reconciliación (bytes)
+    static int64_t lastDrift() { return drift; }
+    static bool due();
+
+private:
+    static uint64_t totalBytes;
+    static int64_t usedBytes;
+    static int64_t drift;
+    static unsigned long scannedAt;
+    static unsigned long scanDuration;
+};
+
+#endif
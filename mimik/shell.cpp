@@ -5,82 +5,126 @@
 
 #include "shell.h"
 #include "networkConfig.h"
+#include "shellSession.h"
+#include "sshServer.h"
+#include "completion.h"
+#include "scriptEngine.h"
+#include "jobManager.h"
+#include "commandExecutor.h"
+#include "profiler.h"
+#include "tracer.h"
+#include "bufferPool.h"
+#include "metrics.h"
+#include "sysLog.h"
+
+// Sesión de la consola serial
+static ShellSession serialSession;
 
 MiniShell shell;
 
 MiniShell::MiniShell() {
-    strcpy(currentPath, "/");
-    cmdIndex = 0;
     commandCount = 0;
-    memset(cmdBuffer, 0, MAX_CMD_LENGTH);
+    ShellSession::setDefault(&serialSession);
 }
 
 bool MiniShell::init() {
-    Serial.println("Initializing mimik Shell...");
+    SysLog::info("shell", "Initializing mimik Shell");
+    serialSession.open(ShellSession::SESSION_SERIAL, &Serial, &Serial, "serial");
     
     // Inicializar SD Card en modo 1-bit
     if(!SD_MMC.begin("/sdcard", true)) {
-        Serial.println("ERROR: SD card not mounted");
+        SysLog::error("sd", "SD card not mounted");
         return false;
     }
     
     uint8_t cardType = SD_MMC.cardType();
     if(cardType == CARD_NONE) {
-        Serial.println("ERROR: No SD card inserted");
+        SysLog::error("sd", "No SD card inserted");
         return false;
     }
     
-    Serial.print("SD Card Type: ");
-    if(cardType == CARD_MMC) Serial.println("MMC");
-    else if(cardType == CARD_SD) Serial.println("SD");
-    else if(cardType == CARD_SDHC) Serial.println("SDHC");
-    
+    const char* typeName = cardType == CARD_MMC ? "MMC" : cardType == CARD_SD ? "SD"
+                         : cardType == CARD_SDHC ? "SDHC" : "unknown";
     uint64_t cardSize = SD_MMC.cardSize() / (1024 * 1024);
-    Serial.printf("Size: %lluMB\n", cardSize);
+    SysLog::info("sd", "%s card, %llu MB", typeName, cardSize);
     
     // Crear directorio root si no existe
     if(!SD_MMC.exists("/")) {
-        Serial.println("Creating root directory...");
+        SysLog::info("sd", "Creating root directory");
         SD_MMC.mkdir("/");
     }
     
-    Serial.println("Checking for saved WiFi configuration...");
+    // Historial de comandos de la consola serial
+    serialSession.loadHistory();
+    DirCache::begin();
+    ScriptEngine::begin();
+    if(!CommandExecutor::begin()) {
+        SysLog::warn("shell", "Cannot create executor queue");
+    }
+    BufferPool::begin();
+    
     NetworkConfigManager::autoConnect();
 
     // Registrar comandos del sistema de archivos
-    registerCommand("ls", "List files", cmd_ls, 0, 1);
-    registerCommand("cd", "Change directory", cmd_cd, 1, 1);
+    registerCommand("ls", "List files", cmd_ls, 0, 1, CMD_RES_SD_READ);
+    registerCommand("cd", "Change directory", cmd_cd, 1, 1, CMD_RES_SD_READ);
     registerCommand("pwd", "Print working directory", cmd_pwd, 0, 0);
-    registerCommand("mkdir", "Create directory", cmd_mkdir, 1, 1);
-    registerCommand("touch", "Create file", cmd_touch, 1, 1);
-    registerCommand("rm", "Remove file/directory", cmd_rm, 1, 1);
-    registerCommand("mv", "Move/rename file", cmd_mv, 2, 2);
-    registerCommand("cp", "Copy file", cmd_cp, 2, 2);
+    registerCommand("mkdir", "Create directory", cmd_mkdir, 1, 1, CMD_RES_SD_WRITE);
+    registerCommand("touch", "Create file", cmd_touch, 1, 1, CMD_RES_SD_WRITE);
+    registerCommand("rm", "Remove file/directory", cmd_rm, 1, 1, CMD_RES_SD_WRITE);
+    registerCommand("mv", "Move/rename file", cmd_mv, 2, 2, CMD_RES_SD_WRITE);
+    registerCommand("cp", "Copy file", cmd_cp, 2, 2, CMD_RES_SD_WRITE);
     registerCommand("nano", "Edit file", cmd_nano, 1, 1);
-    registerCommand("cat", "Display file contents", cmd_cat, 1, 1);
+    registerCommand("cat", "Display file contents", cmd_cat, 1, 1, CMD_RES_SD_READ);
+    registerCommand("more", "Display file page by page", cmd_more, 1, 1, CMD_RES_SD_READ);
+    registerCommand("stty", "Terminal settings", cmd_stty, 0, 2);
     registerCommand("help", "Show help", cmd_help, 0, 0);
+    registerCommand("history", "Command history", cmd_history, 0, 1);
+    
+    // Registrar comandos de scripts
+    registerCommand("source", "Run a script file", cmd_source, 1, MAX_ARGS - 1);
+    registerCommand("sh", "Run a script file", cmd_source, 1, MAX_ARGS - 1);
+    registerCommand("echo", "Print arguments", cmd_echo, 0, MAX_ARGS - 1);
+    registerCommand("timeout", "Run a command with a time limit", cmd_timeout, 2, MAX_ARGS - 1);
+    registerCommand("time", "Measure a command", cmd_time, 1, MAX_ARGS - 1);
     
     // Registrar comandos de networking
     registerCommand("ifconfig", "Network interface info", cmd_ifconfig, 0, 0);
-    registerCommand("ipset", "Set static IP", cmd_ipset, 3, 3);
-    registerCommand("ping", "Ping host", cmd_ping, 1, 2);
-    registerCommand("wifiscan", "Scan WiFi networks", cmd_wifiscan, 0, 0);
-    registerCommand("wificonnect", "Connect to WiFi", cmd_wificonnect, 2, 2);
-    registerCommand("wifidisconnect", "Disconnect WiFi", cmd_wifidisconnect, 0, 0);
-    registerCommand("netconfig", "Show network config", cmd_netconfig, 0, 0);
-    registerCommand("netclear", "Clear network config", cmd_netclear, 0, 0);
+    registerCommand("ipset", "Set static IP", cmd_ipset, 3, 3, CMD_RES_NET | CMD_RES_SD_WRITE);
+    registerCommand("ping", "Ping host (RTT, TTL, jitter)", cmd_ping, 1, 8);
+    registerCommand("pingsweep", "Ping every host of a subnet", cmd_pingsweep, 1, 7);
+    registerCommand("tcping", "TCP connect time to a port", cmd_tcping, 2, 9);
+    registerCommand("portscan", "Scan TCP ports of a host", cmd_portscan, 2, 7);
+    registerCommand("netbench", "Network throughput test (TCP/UDP, SD to socket)", cmd_netbench, 1, MAX_ARGS - 1);
+    registerCommand("wifiscan", "List or scan WiFi networks", cmd_wifiscan, 0, 5);
+    registerCommand("wificonnect", "Connect to WiFi", cmd_wificonnect, 2, 2, CMD_RES_NET | CMD_RES_SD_WRITE);
+    registerCommand("wifidisconnect", "Disconnect WiFi", cmd_wifidisconnect, 0, 0, CMD_RES_NET);
+    registerCommand("netconfig", "Show network config", cmd_netconfig, 0, 0, CMD_RES_SD_READ);
+    registerCommand("netclear", "Clear network config", cmd_netclear, 0, 0, CMD_RES_SD_WRITE);
+    registerCommand("dnscache", "Show or flush the DNS cache", cmd_dnscache, 0, 1);
     
     // Registrar comandos de monitoreo
-    registerCommand("top", "System resources", cmd_top, 0, 0);
+    registerCommand("top", "System resources", cmd_top, 0, 2);
+    registerCommand("who", "List shell sessions", cmd_who, 0, 0);
+    registerCommand("jobs", "List background jobs", cmd_jobs, 0, 0);
+    registerCommand("fg", "Attach to a background job", cmd_fg, 0, 1);
+    registerCommand("kill", "Cancel a background job", cmd_kill, 1, 1);
+    registerCommand("stats", "Resource trends (min/avg/max)", cmd_stats, 0, 1);
+    registerCommand("stacks", "Task stack usage and recommended sizes", cmd_stacks, 0, 0);
+    registerCommand("prof", "Per-command latency percentiles", cmd_prof, 0, 1);
+    registerCommand("heap", "Heap state and allocations per command", cmd_heap, 0, 0);
+    registerCommand("dmesg", "System log (levels, SD persisted)", cmd_dmesg, 0, 5);
+    registerCommand("trace", "Event tracer (Chrome trace JSON)", cmd_trace, 0, 2);
     
-    Serial.println("mimik Shell initialized successfully");
+    SysLog::info("shell", "Shell initialized (%d commands)", commandCount);
     return true;
 }
 
 void MiniShell::registerCommand(const char* name, const char* description, 
-                                CommandFunction func, int minArgs, int maxArgs) {
+                                CommandFunction func, int minArgs, int maxArgs,
+                                uint8_t resources) {
     if(commandCount >= MAX_COMMANDS) {
-        Serial.println("ERROR: Command limit reached");
+        SysLog::error("shell", "Command limit reached, '%s' not registered", name);
         return;
     }
     
@@ -89,6 +133,7 @@ void MiniShell::registerCommand(const char* name, const char* description,
     commands[commandCount].function = func;
     commands[commandCount].minArgs = minArgs;
     commands[commandCount].maxArgs = maxArgs;
+    commands[commandCount].resources = resources;
     commandCount++;
 }
 
@@ -111,17 +156,21 @@ Command* MiniShell::findCommand(const char* name) {
     return NULL;
 }
 
-String MiniShell::resolvePath(const char* path) {
-    if(isAbsolutePath(path)) {
-        return String(path);
+// Una ruta que no cabe se devuelve vacía: recortada podría nombrar
+// otro fichero, y las operaciones de la SD rechazan la ruta vacía
+PathString MiniShell::resolvePath(const char* path) {
+    PathString fullPath;
+    if(!isAbsolutePath(path)) {
+        fullPath.set(getCurrentPath());
+        if(fullPath.length() == 0 || fullPath.c_str()[fullPath.length()-1] != '/') {
+            fullPath.append('/');
+        }
     }
+    fullPath.append(path);
     
-    String fullPath = String(currentPath);
-    if(fullPath[fullPath.length()-1] != '/') {
-        fullPath += "/";
+    if(fullPath.overflowed()) {
+        fullPath.clear();
     }
-    fullPath += path;
-    
     return fullPath;
 }
 
@@ -129,66 +178,147 @@ bool MiniShell::isAbsolutePath(const char* path) {
     return path[0] == '/';
 }
 
+bool MiniShell::isSystemEntry(const char* name) {
+    return strcmp(name, "System Volume Information") == 0 ||
+           strcmp(name, "$RECYCLE.BIN") == 0 ||
+           strcmp(name, "RECYCLER") == 0 ||
+           strncmp(name, "._", 2) == 0;
+}
+
+const char* MiniShell::getCurrentPath() {
+    return ShellSession::current()->currentPath;
+}
+
 void MiniShell::setCurrentPath(const char* path) {
+    char* currentPath = ShellSession::current()->currentPath;
     strncpy(currentPath, path, MAX_PATH_LENGTH - 1);
     currentPath[MAX_PATH_LENGTH - 1] = '\0';
 }
 
 void MiniShell::printPrompt() {
-    Serial.print("mimik:");
-    Serial.print(currentPath);
-    Serial.print("$ ");
+    ShellSession::current()->printPrompt();
+}
+
+// Parsear y ejecutar una línea en la sesión actual
+// (compartido por la consola serial y las sesiones telnet)
+ShellError MiniShell::executeLine(char* line) {
+    // 'cmd &': se ejecuta en un worker de segundo plano
+    size_t len = strlen(line);
+    while(len > 0 && isspace((unsigned char)line[len - 1])) len--;
+    if(len > 0 && line[len - 1] == '&') {
+        len--;
+        while(len > 0 && isspace((unsigned char)line[len - 1])) len--;
+        line[len] = '\0';
+        while(isspace((unsigned char)*line)) line++;
+        if(*line == '\0') {
+            return SHELL_OK;
+        }
+        
+        if(!JobManager::available()) {
+            ShellOutput::println("ERROR: Background jobs not available");
+            return SHELL_ERR_NO_SPACE;
+        }
+        int id = JobManager::submit(line);
+        if(id < 0) {
+            ShellOutput::println("ERROR: No free job slot");
+            return SHELL_ERR_NO_SPACE;
+        }
+        ShellOutput::printf("[%d] %s\n", id, line);
+        return SHELL_OK;
+    }
+    
+    CommandArgs args;
+    parseLine(line, &args);
+    
+    if(args.argc == 0) {
+        return SHELL_OK;
+    }
+    
+    Command* cmd = findCommand(args.argv[0]);
+    if(cmd == NULL) {
+        ShellOutput::printf("Command not found: %s\n", args.argv[0]);
+        ShellOutput::println("Type 'help' to see available commands");
+        return SHELL_ERR_NOT_FOUND;
+    }
+    
+    int argCount = args.argc - 1;
+    if(argCount < cmd->minArgs) {
+        ShellOutput::printf("ERROR: %s requires at least %d argument(s)\n", 
+                            cmd->name, cmd->minArgs);
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    if(argCount > cmd->maxArgs) {
+        ShellOutput::printf("ERROR: %s accepts maximum %d argument(s)\n", 
+                            cmd->name, cmd->maxArgs);
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    
+    // Un script ejecuta comandos anidados: restaurar el anterior al volver
+    ShellSession* session = ShellSession::current();
+    const Command* previousCommand = session->runningCommand;
+    unsigned long previousStart = session->commandStart;
+    session->runningCommand = cmd;
+    session->commandStart = millis();
+    
+    // Esperar a que la SD / la red estén libres para este comando
+    ShellError err;
+    if(CommandExecutor::acquire(cmd->resources, session)) {
+        ProfileMark mark;
+        Profiler::begin(&mark, session);
+        const char* outerCommand = Metrics::commandStarted(cmd->name);
+        TRACE_BEGIN(cmd->name, 0);
+        err = cmd->function(args);
+        TRACE_END(cmd->name, err);
+        Profiler::end(&mark, session, cmd, &session->lastProfile);
+        CommandExecutor::release(cmd->resources);
+        bool stackWarning = Metrics::checkStack(cmd->name);
+        Metrics::commandFinished(outerCommand);
+        if(stackWarning) {
+            ShellOutput::printf("WARNING: Stack margin low after '%s' (see 'stacks')\n", cmd->name);
+        }
+    } else {
+        ShellOutput::println("^C");
+        err = SHELL_ERR_CANCELLED;
+    }
+    
+    session->runningCommand = previousCommand;
+    session->commandStart = previousStart;
+    session->commandsRun++;
+    
+    // La cancelación ya la anuncia el propio comando (^C)
+    if(err != SHELL_OK && err != SHELL_ERR_CANCELLED) {
+        ShellOutput::printf("Error executing command (code: %d)\n", err);
+    }
+    return err;
 }
 
+// Procesa toda la entrada serial pendiente. La entrada se lee en bloque
+// y el echo se envía en una sola escritura por lote.
 void MiniShell::processInput() {
-    while(Serial.available()) {
-        char c = Serial.read();
+    ShellSession* session = &serialSession;
+    
+    int input;
+    while((input = session->readInput()) >= 0) {
+        char c = (char)input;
         
-        if(c == '\n' || c == '\r') {
-            if(cmdIndex > 0) {
-                Serial.println();
-                cmdBuffer[cmdIndex] = '\0';
-                
-                CommandArgs args;
-                parseLine(cmdBuffer, &args);
-                
-                if(args.argc > 0) {
-                    Command* cmd = findCommand(args.argv[0]);
-                    
-                    if(cmd != NULL) {
-                        int argCount = args.argc - 1;
-                        if(argCount < cmd->minArgs) {
-                            Serial.printf("ERROR: %s requires at least %d argument(s)\n", 
-                                        cmd->name, cmd->minArgs);
-                        } else if(argCount > cmd->maxArgs) {
-                            Serial.printf("ERROR: %s accepts maximum %d argument(s)\n", 
-                                        cmd->name, cmd->maxArgs);
-                        } else {
-                            ShellError err = cmd->function(args);
-                            if(err != SHELL_OK) {
-                                Serial.printf("Error executing command (code: %d)\n", err);
-                            }
-                        }
-                    } else {
-                        Serial.printf("Command not found: %s\n", args.argv[0]);
-                        Serial.println("Type 'help' to see available commands");
-                    }
-                }
-                
-                cmdIndex = 0;
-                memset(cmdBuffer, 0, MAX_CMD_LENGTH);
-                printPrompt();
-            }
-        } else if(c == 127 || c == 8) {
-            if(cmdIndex > 0) {
-                cmdIndex--;
-                Serial.write(8);
-                Serial.write(' ');
-                Serial.write(8);
-            }
-        } else if(cmdIndex < MAX_CMD_LENGTH - 1) {
-            cmdBuffer[cmdIndex++] = c;
-            Serial.write(c);
+        switch(session->feed(c)) {
+            case INPUT_LINE:
+                session->flushEcho();
+                session->resetCancel();
+                executeLine(session->line());
+                session->resetLine();
+                session->printPrompt();
+                break;
+            case INPUT_CANCEL:
+                session->flushEcho();
+                ShellOutput::println("^C");
+                session->resetLine();
+                session->printPrompt();
+                break;
+            default:
+                break;
         }
     }
-}
\ No newline at end of file
+    
+    session->flushEcho();
+}
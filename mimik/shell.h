@@ -12,7 +12,7 @@
 #include <freertos/task.h>
 #include <WiFi.h>
 #include <ESPmDNS.h>
-#include <ESPping.h>
+#include "fixedString.h"
 
 // Configuración de pines para AI-Thinker ESP32-CAM
 #define SD_MMC_CMD  15
@@ -23,6 +23,13 @@
 #define MAX_CMD_LENGTH 256
 #define MAX_PATH_LENGTH 128
 #define MAX_ARGS 10
+#define SERIAL_RX_BUFFER 2048  // Buffer del driver UART (pegar scripts)
+#define COPY_BUFFER_SIZE 16384 // cp (del pool de buffers, no del stack)
+#define CAT_BUFFER_SIZE 4096   // cat
+#define NANO_BUFFER_SIZE 8192  // nano (texto hasta escribirlo en la SD)
+
+// Ruta en la pila (sin heap)
+typedef FixedString<MAX_PATH_LENGTH> PathString;
 
 // Códigos de error
 enum ShellError {
@@ -32,7 +39,8 @@ enum ShellError {
     SHELL_ERR_FILE_EXISTS,
     SHELL_ERR_PERMISSION,
     SHELL_ERR_NO_SPACE,
-    SHELL_ERR_INVALID_ARGS
+    SHELL_ERR_INVALID_ARGS,
+    SHELL_ERR_CANCELLED
 };
 
 // Estructura para argumentos de comandos
@@ -44,6 +52,14 @@ struct CommandArgs {
 // Tipo de función para comandos
 typedef ShellError (*CommandFunction)(CommandArgs args);
 
+// Recursos que un comando declara al registrarse (ver CommandExecutor).
+// Los comandos que ejecutan otras líneas (source, timeout) no declaran
+// ninguno: cada comando anidado reserva los suyos.
+#define CMD_RES_NONE      0x00
+#define CMD_RES_SD_READ   0x01  // Lee la SD (compartido)
+#define CMD_RES_SD_WRITE  0x02  // Modifica la SD (exclusivo)
+#define CMD_RES_NET       0x04  // Radio WiFi / configuración IP (exclusivo)
+
 // Estructura de comando
 struct Command {
     const char* name;
@@ -51,40 +67,47 @@ struct Command {
     CommandFunction function;
     int minArgs;
     int maxArgs;
+    uint8_t resources;
 };
 
-// Forward declaration de ShellOutput
+// Forward declarations
 class ShellOutput;
+class ShellSession;
 
 // Clase principal del Shell
 class MiniShell {
 private:
-    char currentPath[MAX_PATH_LENGTH];
-    char cmdBuffer[MAX_CMD_LENGTH];
-    int cmdIndex;
-    
     // Comandos registrados
-    static const int MAX_COMMANDS = 30;
+    static const int MAX_COMMANDS = 48;
     Command commands[MAX_COMMANDS];
     int commandCount;
     
     // Métodos privados
     void parseLine(char* line, CommandArgs* args);
-    String resolvePath(const char* path);
+    PathString resolvePath(const char* path);
     bool isAbsolutePath(const char* path);
     
 public:
     MiniShell();
     bool init();
     void registerCommand(const char* name, const char* description, 
-                        CommandFunction func, int minArgs, int maxArgs);
+                        CommandFunction func, int minArgs, int maxArgs,
+                        uint8_t resources = CMD_RES_NONE);
     void processInput();
     void printPrompt();
-    const char* getCurrentPath() { return currentPath; }
+    const char* getCurrentPath();
     void setCurrentPath(const char* path);
     
     // Métodos públicos para SSH
     Command* findCommand(const char* name);
+    ShellError executeLine(char* line);
+    
+    // Tabla de comandos (autocompletado)
+    int getCommandCount() { return commandCount; }
+    const Command* getCommand(int index) { return &commands[index]; }
+    
+    // Entradas de la SD que no se listan (carpetas del sistema de Windows)
+    static bool isSystemEntry(const char* name);
     
     // Comandos integrados - Sistema de archivos
     static ShellError cmd_ls(CommandArgs args);
@@ -97,12 +120,24 @@ public:
     static ShellError cmd_cp(CommandArgs args);
     static ShellError cmd_nano(CommandArgs args);
     static ShellError cmd_cat(CommandArgs args);
+    static ShellError cmd_more(CommandArgs args);
+    static ShellError cmd_stty(CommandArgs args);
     static ShellError cmd_help(CommandArgs args);
+    static ShellError cmd_history(CommandArgs args);
+    static ShellError cmd_source(CommandArgs args);
+    static ShellError cmd_echo(CommandArgs args);
+    static ShellError cmd_timeout(CommandArgs args);
+    static ShellError cmd_time(CommandArgs args);
     
     // Comandos de networking
     static ShellError cmd_ifconfig(CommandArgs args);
     static ShellError cmd_ipset(CommandArgs args);
     static ShellError cmd_ping(CommandArgs args);
+    static ShellError cmd_pingsweep(CommandArgs args);
+    static ShellError cmd_tcping(CommandArgs args);
+    static ShellError cmd_portscan(CommandArgs args);
+    static ShellError cmd_netbench(CommandArgs args);
+    static ShellError cmd_dnscache(CommandArgs args);
     static ShellError cmd_wifiscan(CommandArgs args);
     static ShellError cmd_wificonnect(CommandArgs args);
     static ShellError cmd_wifidisconnect(CommandArgs args);
@@ -111,11 +146,22 @@ public:
     
     // Comandos de monitoreo
     static ShellError cmd_top(CommandArgs args);
+    static ShellError cmd_who(CommandArgs args);
+    static ShellError cmd_jobs(CommandArgs args);
+    static ShellError cmd_fg(CommandArgs args);
+    static ShellError cmd_kill(CommandArgs args);
+    static ShellError cmd_stats(CommandArgs args);
+    static ShellError cmd_stacks(CommandArgs args);
+    static ShellError cmd_prof(CommandArgs args);
+    static ShellError cmd_heap(CommandArgs args);
+    static ShellError cmd_dmesg(CommandArgs args);
+    static ShellError cmd_trace(CommandArgs args);
     
     // Permitir acceso desde funciones globales y SSH
     friend bool initShellTasks();
     friend class SSHServer;
     friend class ShellOutput;
+    friend class ScriptEngine;
 };
 
 // Instancia global
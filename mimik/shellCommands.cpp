@@ -5,6 +5,15 @@
 
 #include "shell.h"
 #include "sshServer.h"
+#include "shellSession.h"
+#include "telnetProtocol.h"
+#include "completion.h"
+#include "scriptEngine.h"
+#include "sdSpace.h"
+#include "profiler.h"
+#include "tracer.h"
+#include "bufferPool.h"
+#include "commandExecutor.h"
 
 // Comando: pwd
 ShellError MiniShell::cmd_pwd(CommandArgs args) {
@@ -14,7 +23,7 @@ ShellError MiniShell::cmd_pwd(CommandArgs args) {
 
 // Comando: ls
 ShellError MiniShell::cmd_ls(CommandArgs args) {
-    String path = args.argc > 1 ? shell.resolvePath(args.argv[1]) : shell.getCurrentPath();
+    PathString path = args.argc > 1 ? shell.resolvePath(args.argv[1]) : PathString(shell.getCurrentPath());
     
     File dir = SD_MMC.open(path);
     if(!dir) {
@@ -30,13 +39,10 @@ ShellError MiniShell::cmd_ls(CommandArgs args) {
     
     File file = dir.openNextFile();
     while(file) {
-        String fileName = String(file.name());
+        const char* fileName = file.name();
         
         // Ignorar carpetas del sistema de Windows
-        if(fileName == "System Volume Information" || 
-           fileName == "$RECYCLE.BIN" ||
-           fileName == "RECYCLER" ||
-           fileName.startsWith("._")) {
+        if(MiniShell::isSystemEntry(fileName)) {
             file = dir.openNextFile();
             continue;
         }
@@ -58,24 +64,23 @@ ShellError MiniShell::cmd_ls(CommandArgs args) {
 
 // Comando: cd
 ShellError MiniShell::cmd_cd(CommandArgs args) {
-    String newPath;
+    PathString newPath;
     
     // Soporte para cd ..
     if(strcmp(args.argv[1], "..") == 0) {
-        String currentPath = String(shell.getCurrentPath());
+        newPath.set(shell.getCurrentPath());
         
         // Si estamos en root, no hacer nada
-        if(currentPath == "/") {
+        if(newPath.equals("/")) {
             return SHELL_OK;
         }
         
-        // Encontrar el último '/' y obtener el directorio padre
-        int lastSlash = currentPath.lastIndexOf('/', currentPath.length() - 2);
-        if(lastSlash <= 0) {
-            newPath = "/";
-        } else {
-            newPath = currentPath.substring(0, lastSlash);
+        // Quitar la '/' final y quedarse con el directorio padre
+        if(newPath.c_str()[newPath.length() - 1] == '/') {
+            newPath.truncate(newPath.length() - 1);
         }
+        int lastSlash = newPath.lastIndexOf('/');
+        newPath.truncate(lastSlash <= 0 ? 1 : lastSlash);
     } else {
         newPath = shell.resolvePath(args.argv[1]);
     }
@@ -99,7 +104,7 @@ ShellError MiniShell::cmd_cd(CommandArgs args) {
 
 // Comando: mkdir
 ShellError MiniShell::cmd_mkdir(CommandArgs args) {
-    String path = shell.resolvePath(args.argv[1]);
+    PathString path = shell.resolvePath(args.argv[1]);
     
     if(SD_MMC.exists(path)) {
         ShellOutput::println("ERROR: Directory already exists");
@@ -107,6 +112,7 @@ ShellError MiniShell::cmd_mkdir(CommandArgs args) {
     }
     
     if(SD_MMC.mkdir(path)) {
+        DirCache::invalidate(path.c_str());
         ShellOutput::println("Directory created");
         return SHELL_OK;
     }
@@ -117,7 +123,7 @@ ShellError MiniShell::cmd_mkdir(CommandArgs args) {
 
 // Comando: touch
 ShellError MiniShell::cmd_touch(CommandArgs args) {
-    String path = shell.resolvePath(args.argv[1]);
+    PathString path = shell.resolvePath(args.argv[1]);
     
     if(SD_MMC.exists(path)) {
         ShellOutput::println("File already exists");
@@ -131,13 +137,14 @@ ShellError MiniShell::cmd_touch(CommandArgs args) {
     }
     
     file.close();
+    DirCache::invalidate(path.c_str());
     ShellOutput::println("File created");
     return SHELL_OK;
 }
 
 // Comando: rm
 ShellError MiniShell::cmd_rm(CommandArgs args) {
-    String path = shell.resolvePath(args.argv[1]);
+    PathString path = shell.resolvePath(args.argv[1]);
     
     if(!SD_MMC.exists(path)) {
         ShellOutput::println("ERROR: File or directory does not exist");
@@ -146,7 +153,9 @@ ShellError MiniShell::cmd_rm(CommandArgs args) {
     
     File file = SD_MMC.open(path);
     bool isDir = file.isDirectory();
+    size_t size = isDir ? 0 : file.size();
     file.close();
+    DirCache::invalidate(path.c_str());
     
     if(isDir) {
         if(SD_MMC.rmdir(path)) {
@@ -156,6 +165,7 @@ ShellError MiniShell::cmd_rm(CommandArgs args) {
         ShellOutput::println("ERROR: Cannot delete directory (is it empty?)");
     } else {
         if(SD_MMC.remove(path)) {
+            SdSpace::adjust(-(int64_t)size);
             ShellOutput::println("File deleted");
             return SHELL_OK;
         }
@@ -167,8 +177,8 @@ ShellError MiniShell::cmd_rm(CommandArgs args) {
 
 // Comando: mv
 ShellError MiniShell::cmd_mv(CommandArgs args) {
-    String srcPath = shell.resolvePath(args.argv[1]);
-    String dstPath = shell.resolvePath(args.argv[2]);
+    PathString srcPath = shell.resolvePath(args.argv[1]);
+    PathString dstPath = shell.resolvePath(args.argv[2]);
     
     if(!SD_MMC.exists(srcPath)) {
         ShellOutput::println("ERROR: Source does not exist");
@@ -181,6 +191,8 @@ ShellError MiniShell::cmd_mv(CommandArgs args) {
     }
     
     if(SD_MMC.rename(srcPath, dstPath)) {
+        DirCache::invalidate(srcPath.c_str());
+        DirCache::invalidate(dstPath.c_str());
         ShellOutput::println("Moved/renamed successfully");
         return SHELL_OK;
     }
@@ -191,15 +203,17 @@ ShellError MiniShell::cmd_mv(CommandArgs args) {
 
 // Comando: cp
 ShellError MiniShell::cmd_cp(CommandArgs args) {
-    String srcPath = shell.resolvePath(args.argv[1]);
-    String dstPath = shell.resolvePath(args.argv[2]);
+    PathString srcPath = shell.resolvePath(args.argv[1]);
+    PathString dstPath = shell.resolvePath(args.argv[2]);
     
     if(!SD_MMC.exists(srcPath)) {
         ShellOutput::println("ERROR: Source does not exist");
         return SHELL_ERR_NOT_FOUND;
     }
     
+    TRACE_BEGIN("sd.open", 0);
     File srcFile = SD_MMC.open(srcPath, FILE_READ);
+    TRACE_END("sd.open", 0);
     if(!srcFile) {
         ShellOutput::println("ERROR: Cannot open source");
         return SHELL_ERR_PERMISSION;
@@ -211,29 +225,124 @@ ShellError MiniShell::cmd_cp(CommandArgs args) {
         return SHELL_ERR_INVALID_ARGS;
     }
     
+    // Buffer del pool en RAM apta para DMA: la SD transfiere directamente
+    // sin pasar sector a sector por un buffer intermedio
+    size_t bufferSize = 0;
+    uint8_t* buffer = (uint8_t*)BufferPool::acquire(COPY_BUFFER_SIZE, 512, POOL_DMA, &bufferSize);
+    if(!buffer) {
+        srcFile.close();
+        ShellOutput::println("ERROR: Not enough memory");
+        return SHELL_ERR_NO_SPACE;
+    }
+    
+    // FILE_WRITE trunca el destino si ya existía
+    int64_t oldSize = SdSpace::sizeOf(dstPath.c_str());
+    TRACE_BEGIN("sd.open", 0);
     File dstFile = SD_MMC.open(dstPath, FILE_WRITE);
+    TRACE_END("sd.open", 0);
     if(!dstFile) {
         srcFile.close();
+        BufferPool::release(buffer);
         ShellOutput::println("ERROR: Cannot create destination");
         return SHELL_ERR_PERMISSION;
     }
+    DirCache::invalidate(dstPath.c_str());
+    
+    ShellSession* session = ShellSession::current();
+    unsigned long start = millis();
+    size_t total = 0;
     
-    uint8_t buffer[512];
     while(srcFile.available()) {
-        size_t len = srcFile.read(buffer, sizeof(buffer));
-        dstFile.write(buffer, len);
+        if(session->interrupted()) {
+            srcFile.close();
+            dstFile.close();
+            BufferPool::release(buffer);
+            SdSpace::fileChanged(oldSize, total);
+            Profiler::countRead(total);
+            Profiler::countWritten(total);
+            ShellOutput::println("Copy cancelled");
+            return SHELL_ERR_CANCELLED;
+        }
+        size_t len;
+        {
+            TraceScope trace("sd.read", bufferSize);
+            len = srcFile.read(buffer, bufferSize);
+        }
+        {
+            TraceScope trace("sd.write", len);
+            dstFile.write(buffer, len);
+        }
+        total += len;
     }
     
     srcFile.close();
     dstFile.close();
-    
-    ShellOutput::println("File copied");
+    BufferPool::release(buffer);
+    SdSpace::fileChanged(oldSize, total);
+    Profiler::countRead(total);
+    Profiler::countWritten(total);
+    
+    // Throughput (útil para comparar copias concurrentes con 'cp ... &')
+    unsigned long elapsed = max(millis() - start, 1UL);
+    ShellOutput::printf("File copied (%u bytes in %lu ms, %lu KB/s)\n",
+                        (unsigned)total, elapsed, (unsigned long)((uint64_t)total * 1000 / elapsed / 1024));
     return SHELL_OK;
 }
 
 // Comando: cat
 ShellError MiniShell::cmd_cat(CommandArgs args) {
-    String path = shell.resolvePath(args.argv[1]);
+    PathString path = shell.resolvePath(args.argv[1]);
+    
+    TRACE_BEGIN("sd.open", 0);
+    File file = SD_MMC.open(path, FILE_READ);
+    TRACE_END("sd.open", 0);
+    if(!file) {
+        ShellOutput::println("ERROR: Cannot open file");
+        return SHELL_ERR_NOT_FOUND;
+    }
+    
+    if(file.isDirectory()) {
+        file.close();
+        ShellOutput::println("ERROR: Is a directory");
+        return SHELL_ERR_INVALID_PATH;
+    }
+    
+    // Por bloques del pool; sin memoria, en trozos pequeños
+    uint8_t small[64];
+    size_t chunk = 0;
+    uint8_t* buffer = (uint8_t*)BufferPool::acquire(CAT_BUFFER_SIZE, 256, POOL_ANY, &chunk);
+    if(!buffer) {
+        buffer = small;
+        chunk = sizeof(small);
+    }
+    
+    ShellSession* session = ShellSession::current();
+    TRACE_BEGIN("sd.read", file.size());
+    while(file.available() && !session->interrupted()) {
+        size_t len = file.read(buffer, chunk);
+        if(len == 0) break;
+        ShellOutput::write(buffer, len);
+    }
+    TRACE_END("sd.read", file.position());
+    if(buffer != small) {
+        BufferPool::release(buffer);
+    }
+    ShellOutput::println();
+    Profiler::countRead(file.position());
+    if(session->cancelled) {
+        file.close();
+        return SHELL_ERR_CANCELLED;
+    }
+    
+    file.close();
+    return SHELL_OK;
+}
+
+// Comando: more - Mostrar un archivo página a página
+// Usa el tamaño de terminal de la sesión (NAWS en telnet)
+ShellError MiniShell::cmd_more(CommandArgs args) {
+    PathString path = shell.resolvePath(args.argv[1]);
+    ShellSession* session = ShellSession::current();
     
     File file = SD_MMC.open(path, FILE_READ);
     if(!file) {
@@ -247,68 +356,331 @@ ShellError MiniShell::cmd_cat(CommandArgs args) {
         return SHELL_ERR_INVALID_PATH;
     }
     
+    size_t total = file.size();
+    int pageLines = session->termRows > 1 ? session->termRows - 1 : 23;
+    int linesLeft = pageLines;
+    int column = 0;
+    
     while(file.available()) {
-        ShellOutput::write(file.read());
+        char c = file.read();
+        ShellOutput::write(c);
+        
+        if(c == '\n' || ++column >= session->termCols) {
+            column = 0;
+            linesLeft--;
+        }
+        
+        if(linesLeft > 0 || !file.available()) {
+            continue;
+        }
+        
+        // Fin de página: esperar tecla
+        ShellOutput::printf("--More--(%u%%)", total ? (unsigned)(file.position() * 100 / total) : 100);
+        ShellOutput::flush();
+        int key;
+        while((key = session->readInput()) < 0) {
+            // Job, timeout, kill o cliente Telnet caído
+            if(!session->sleep(10)) break;
+        }
+        ShellOutput::print("\r              \r");
+        
+        if(key < 0) {
+            file.close();
+            ShellOutput::println("^C");
+            return SHELL_ERR_CANCELLED;
+        }
+        if(key == 'q' || key == 'Q' || key == 3) {
+            break;
+        }
+        linesLeft = (key == '\r' || key == '\n') ? 1 : pageLines;
     }
     ShellOutput::println();
+    Profiler::countRead(file.position());
     
     file.close();
     return SHELL_OK;
 }
 
+// Comando: stty - Ver/ajustar la terminal de la sesión
+// Uso: stty | stty rows <n> | stty cols <n> | stty binary on|off
+ShellError MiniShell::cmd_stty(CommandArgs args) {
+    ShellSession* session = ShellSession::current();
+    
+    if(args.argc == 1) {
+        ShellOutput::printf("rows %d; columns %d;", session->termRows, session->termCols);
+        if(session->telnet) {
+            ShellOutput::printf(" binary %s; echo %s; naws %s; compress %s",
+                                session->telnet->binaryMode() ? "on" : "off",
+                                session->echo ? "server" : "client",
+                                session->telnet->remoteEnabled(TELOPT_NAWS) ? "on" : "off",
+                                session->telnet->compressing() ? "on" : "off");
+        }
+        ShellOutput::println();
+        return SHELL_OK;
+    }
+    
+    if(args.argc != 3) {
+        ShellOutput::println("Usage: stty [rows <n> | cols <n> | binary on|off]");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    
+    if(strcmp(args.argv[1], "rows") == 0 || strcmp(args.argv[1], "cols") == 0) {
+        int value = atoi(args.argv[2]);
+        if(value < 1 || value > 1000) {
+            ShellOutput::println("ERROR: Invalid size");
+            return SHELL_ERR_INVALID_ARGS;
+        }
+        if(args.argv[1][0] == 'r') session->termRows = value;
+        else session->termCols = value;
+        return SHELL_OK;
+    }
+    
+    if(strcmp(args.argv[1], "binary") == 0) {
+        if(!session->telnet) {
+            ShellOutput::println("ERROR: Binary mode is only available over Telnet");
+            return SHELL_ERR_INVALID_ARGS;
+        }
+        bool enable = strcmp(args.argv[2], "on") == 0;
+        // Modo binario en ambos sentidos (RFC 856)
+        session->telnet->requestLocal(TELOPT_BINARY, enable);
+        session->telnet->requestRemote(TELOPT_BINARY, enable);
+        ShellOutput::printf("Binary mode %s requested\n", enable ? "on" : "off");
+        return SHELL_OK;
+    }
+    
+    ShellOutput::println("Usage: stty [rows <n> | cols <n> | binary on|off]");
+    return SHELL_ERR_INVALID_ARGS;
+}
+
+// nano guarda el texto en memoria y reserva la SD solo para escribirlo
+// (al crear el archivo, al llenarse el buffer y al terminar): mientras
+// se edita no bloquea a los demás comandos ni al log. Sin sesión la
+// espera no se cancela, para no perder lo escrito tras Ctrl+C o timeout.
+static bool writeEdited(const char* path, const char* text, size_t length, bool append) {
+    if(!CommandExecutor::acquire(CMD_RES_SD_WRITE, nullptr)) {
+        return false;
+    }
+    int64_t oldSize = SdSpace::sizeOf(path);
+    File file = SD_MMC.open(path, append ? FILE_APPEND : FILE_WRITE);
+    bool ok = file;
+    if(file) {
+        TRACE_BEGIN("sd.write", length);
+        ok = file.write((const uint8_t*)text, length) == length;
+        TRACE_END("sd.write", 0);
+        int64_t newSize = file.size();
+        file.close();
+        SdSpace::fileChanged(oldSize, newSize);
+        Profiler::countWritten(length);
+        if(!append) DirCache::invalidate(path);
+    }
+    CommandExecutor::release(CMD_RES_SD_WRITE);
+    return ok;
+}
+
 // Comando: nano (editor simple)
 ShellError MiniShell::cmd_nano(CommandArgs args) {
-    String path = shell.resolvePath(args.argv[1]);
+    PathString path = shell.resolvePath(args.argv[1]);
     
-    ShellOutput::println("=== Simple Nano Editor ===");
-    ShellOutput::println("Write content. End with 'EOF' on a new line");
-    ShellOutput::println();
+    size_t capacity = 0;
+    char* text = (char*)BufferPool::acquire(NANO_BUFFER_SIZE, MAX_CMD_LENGTH + 2, POOL_ANY, &capacity);
+    if(!text) {
+        ShellOutput::println("ERROR: Not enough memory");
+        return SHELL_ERR_NO_SPACE;
+    }
     
-    File file = SD_MMC.open(path, FILE_WRITE);
-    if(!file) {
+    // Crear (o vaciar) el archivo ya, para avisar antes de escribir nada
+    if(!writeEdited(path.c_str(), "", 0, false)) {
+        BufferPool::release(text);
         ShellOutput::println("ERROR: Cannot open file for writing");
         return SHELL_ERR_PERMISSION;
     }
     
-    String line = "";
-    unsigned long lastActivity = millis();
+    ShellOutput::println("=== Simple Nano Editor ===");
+    ShellOutput::println("Write content. End with 'EOF' on a new line");
+    ShellOutput::println();
     
-    while(true) {
-        while(Serial.available()) {
-            char c = Serial.read();
+    ShellSession* session = ShellSession::current();
+    FixedString<MAX_CMD_LENGTH> line;
+    size_t length = 0;
+    unsigned long lastActivity = millis();
+    const char* message = nullptr;
+    ShellError result = SHELL_OK;
+    bool failed = false;
+    
+    while(!message) {
+        int input;
+        while(!message && (input = session->readInput()) >= 0) {
+            char c = (char)input;
             lastActivity = millis();
             
-            if(c == '\n' || c == '\r') {
+            // Ctrl+C: guardar lo escrito hasta ahora y salir
+            if(c == 3) {
+                message = "^C\nCancelled - file saved";
+                result = SHELL_ERR_CANCELLED;
+            } else if(c == '\n' || c == '\r') {
                 ShellOutput::println();
-                if(line == "EOF") {
-                    file.close();
-                    ShellOutput::println("\nFile saved");
-                    return SHELL_OK;
+                if(line.equals("EOF")) {
+                    message = "\nFile saved";
+                    break;
                 }
-                file.println(line);
-                line = "";
+                if(capacity - length < line.length() + 2) {
+                    failed |= !writeEdited(path.c_str(), text, length, true);
+                    length = 0;
+                }
+                memcpy(text + length, line.c_str(), line.length());
+                length += line.length();
+                text[length++] = '\r';
+                text[length++] = '\n';
+                line.clear();
             } else if(c == 127 || c == 8) {
                 if(line.length() > 0) {
-                    line.remove(line.length() - 1);
+                    line.truncate(line.length() - 1);
                     ShellOutput::write(8);
                     ShellOutput::write(' ');
                     ShellOutput::write(8);
                 }
-            } else {
-                line += c;
+            } else if(line.append(c)) {
                 ShellOutput::write(c);
             }
         }
         
-        // Timeout de 60 segundos sin actividad
-        if(millis() - lastActivity > 60000) {
-            file.close();
-            ShellOutput::println("\nTimeout - file saved");
-            return SHELL_OK;
+        // Timeout de 60 segundos sin actividad (o plazo de 'timeout'/kill)
+        if(!message && (millis() - lastActivity > 60000 || session->interrupted())) {
+            message = "\nTimeout - file saved";
         }
-        
-        delay(10);
+        if(!message) delay(10);
+    }
+    
+    if(length > 0) {
+        failed |= !writeEdited(path.c_str(), text, length, true);
+    }
+    BufferPool::release(text);
+    if(failed) {
+        ShellOutput::println("\nERROR: Could not write the whole file");
+        return SHELL_ERR_PERMISSION;
+    }
+    ShellOutput::println(message);
+    return result;
+}
+
+// Comando: source / sh - Ejecutar un script de la SD
+// Uso: source <archivo> [args...]
+ShellError MiniShell::cmd_source(CommandArgs args) {
+    return ScriptEngine::run(args.argv[1], args.argc - 1, args.argv + 1);
+}
+
+// Comando: echo
+ShellError MiniShell::cmd_echo(CommandArgs args) {
+    for(int i = 1; i < args.argc; i++) {
+        if(i > 1) ShellOutput::print(' ');
+        ShellOutput::print(args.argv[i]);
+    }
+    ShellOutput::println();
+    return SHELL_OK;
+}
+
+// ============================================
+// Comando: time
+// ============================================
+
+ShellError MiniShell::cmd_time(CommandArgs args) {
+    char line[MAX_CMD_LENGTH];
+    line[0] = '\0';
+    for(int i = 1; i < args.argc; i++) {
+        if(i > 1) strncat(line, " ", MAX_CMD_LENGTH - strlen(line) - 1);
+        strncat(line, args.argv[i], MAX_CMD_LENGTH - strlen(line) - 1);
+    }
+    
+    // executeLine deja en lastProfile la medición del comando
+    ShellSession* session = ShellSession::current();
+    memset(&session->lastProfile, 0, sizeof(session->lastProfile));
+    ShellError result = shell.executeLine(line);
+    const ProfileSample* sample = &session->lastProfile;
+    
+    char wall[16], cpu[16];
+    Profiler::formatUs(wall, sizeof(wall), sample->wallUs);
+    Profiler::formatUs(cpu, sizeof(cpu), sample->cpuUs);
+    ShellOutput::printf("\nreal   %s\n", wall);
+    ShellOutput::printf("cpu    %s\n", sample->cpuUs ? cpu : "-");
+    ShellOutput::printf("heap   %+ld B (min free %s%u B)\n", (long)sample->heapDelta,
+                        sample->minFreeExact ? "" : "<= ", (unsigned)sample->minFreeHeap);
+    ShellOutput::printf("sd     %u B read, %u B written\n",
+                        (unsigned)sample->sdRead, (unsigned)sample->sdWritten);
+    ShellOutput::printf("alloc  %u blocks, %u B%s (peak %u B, largest free %u B)\n",
+                        (unsigned)sample->allocs, (unsigned)sample->allocBytes,
+                        sample->allocExact ? "" : " net", (unsigned)sample->peakBytes,
+                        (unsigned)sample->largestFree);
+    return result;
+}
+
+// ============================================
+// Comando: timeout
+// ============================================
+
+ShellError MiniShell::cmd_timeout(CommandArgs args) {
+    long seconds = atol(args.argv[1]);
+    if(seconds <= 0) {
+        ShellOutput::println("ERROR: Invalid timeout");
+        return SHELL_ERR_INVALID_ARGS;
+    }
+    
+    // Reconstruir la línea del comando a ejecutar
+    char line[MAX_CMD_LENGTH];
+    line[0] = '\0';
+    for(int i = 2; i < args.argc; i++) {
+        if(i > 2) strncat(line, " ", MAX_CMD_LENGTH - strlen(line) - 1);
+        strncat(line, args.argv[i], MAX_CMD_LENGTH - strlen(line) - 1);
+    }
+    
+    // El plazo se anida: nunca amplía el de un 'timeout' exterior
+    ShellSession* session = ShellSession::current();
+    unsigned long previous = session->deadline;
+    unsigned long deadline = millis() + seconds * 1000UL;
+    if(previous && (long)(deadline - previous) > 0) {
+        deadline = previous;
+    }
+    session->deadline = deadline ? deadline : 1;
+    
+    ShellError result = shell.executeLine(line);
+    session->deadline = previous;
+    
+    // Si venció el plazo de un 'timeout' exterior, dejar que lo trate él
+    if(session->timedOut && (!previous || (long)(millis() - previous) < 0)) {
+        session->timedOut = false;
+        session->cancelled = false;
+        ShellOutput::printf("timeout: '%s' stopped after %ld s\n", args.argv[2], seconds);
+        return SHELL_ERR_CANCELLED;
     }
+    return result;
+}
+
+// Comando: history - Historial de comandos de la sesión
+// Uso: history | history -c
+ShellError MiniShell::cmd_history(CommandArgs args) {
+    ShellSession* session = ShellSession::current();
+    CommandHistory& history = session->editor.history;
+    
+    if(args.argc > 1) {
+        if(strcmp(args.argv[1], "-c") != 0) {
+            ShellOutput::println("Usage: history [-c]");
+            return SHELL_ERR_INVALID_ARGS;
+        }
+        // 'history' no reserva la SD al registrarse: solo -c la toca
+        if(!CommandExecutor::acquire(CMD_RES_SD_WRITE, session)) {
+            return SHELL_ERR_CANCELLED;
+        }
+        history.clear();
+        SD_MMC.remove(session->historyPath());
+        CommandExecutor::release(CMD_RES_SD_WRITE);
+        ShellOutput::println("History cleared");
+        return SHELL_OK;
+    }
+    
+    int total = history.count();
+    for(int i = total - 1; i >= 0; i--) {
+        ShellOutput::printf("%4d  %s\n", total - i, history.get(i));
+    }
+    return SHELL_OK;
 }
 
 // Comando: help
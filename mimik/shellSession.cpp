@@ -0,0 +1,324 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * shellSession.cpp - Implementación del contexto por sesión
+ */
+
+#include "shellSession.h"
+#include "telnetProtocol.h"
+#include "tracer.h"
+#include "commandExecutor.h"
+
+// Sesión de la tarea actual (almacenamiento local por tarea de ESP-IDF)
+static __thread ShellSession* taskSession = nullptr;
+
+ShellSession* ShellSession::defaultSession = nullptr;
+ShellSession* ShellSession::sessions[MAX_SESSIONS] = {nullptr};
+int ShellSession::nextId = 0;
+portMUX_TYPE ShellSession::registryLock = portMUX_INITIALIZER_UNLOCKED;
+
+ShellSession::ShellSession() {
+    type = SESSION_SERIAL;
+    id = -1;
+    active = false;
+    echo = false;
+    peer[0] = '\0';
+    strcpy(currentPath, "/");
+    in = nullptr;
+    out = nullptr;
+    telnet = nullptr;
+    termCols = 80;
+    termRows = 24;
+    runningCommand = nullptr;
+    commandStart = 0;
+    lastActivity = 0;
+    commandsRun = 0;
+    scriptDepth = 0;
+    sdBytesRead = 0;
+    sdBytesWritten = 0;
+    memset(&lastProfile, 0, sizeof(lastProfile));
+    cancelled = false;
+    deadline = 0;
+    timedOut = false;
+    rxPos = 0;
+    rxLength = 0;
+    echoLength = 0;
+    inputLock = NULL;
+}
+
+void ShellSession::open(SessionType sessionType, Stream* input, Print* output, const char* peerName) {
+    type = sessionType;
+    echo = (sessionType == SESSION_SERIAL);
+    in = input;
+    out = output;
+    telnet = nullptr;
+    termCols = 80;
+    termRows = 24;
+    strncpy(peer, peerName, sizeof(peer) - 1);
+    peer[sizeof(peer) - 1] = '\0';
+    strcpy(currentPath, "/");
+    editor.attach(this);
+    editor.history.clear();
+    if(!inputLock) {
+        inputLock = xSemaphoreCreateMutex();
+    }
+    rxPos = 0;
+    rxLength = 0;
+    echoLength = 0;
+    runningCommand = nullptr;
+    commandsRun = 0;
+    scriptDepth = 0;
+    cancelled = false;
+    deadline = 0;
+    timedOut = false;
+    lastActivity = millis();
+
+    portENTER_CRITICAL(&registryLock);
+    id = nextId++;
+    for(int i = 0; i < MAX_SESSIONS; i++) {
+        if(sessions[i] == nullptr) {
+            sessions[i] = this;
+            break;
+        }
+    }
+    active = true;
+    portEXIT_CRITICAL(&registryLock);
+}
+
+void ShellSession::close() {
+    saveHistory();
+    
+    portENTER_CRITICAL(&registryLock);
+    for(int i = 0; i < MAX_SESSIONS; i++) {
+        if(sessions[i] == this) {
+            sessions[i] = nullptr;
+        }
+    }
+    active = false;
+    portEXIT_CRITICAL(&registryLock);
+
+    in = nullptr;
+    out = nullptr;
+    telnet = nullptr;
+    resetLine();
+}
+
+void ShellSession::resetLine() {
+    editor.reset();
+}
+
+InputResult ShellSession::feed(char c) {
+    lastActivity = millis();
+    
+    InputResult result = editor.feed(c);
+    
+    // El historial se escribe a la SD por lotes, no en cada línea
+    if(result == INPUT_LINE && editor.history.pending() >= HISTORY_SAVE_BATCH) {
+        saveHistory();
+    }
+    return result;
+}
+
+// Lee en bloque lo disponible en la entrada
+size_t ShellSession::refill() {
+    rxPos = 0;
+    rxLength = 0;
+    if(!in) return 0;
+    
+    int avail = in->available();
+    if(avail <= 0) return 0;
+    
+    size_t len = min((size_t)avail, sizeof(rxBuffer));
+    if(type == SESSION_SERIAL) {
+        // Lectura directa del buffer del driver UART
+        rxLength = ((HardwareSerial*)in)->read(rxBuffer, len);
+    } else {
+        // available() cuenta bytes crudos (IAC, el LF tras CR...) que
+        // pueden no dar ningún carácter: readBytes esperaría su timeout
+        while(rxLength < len) {
+            int c = in->read();
+            if(c < 0) break;
+            rxBuffer[rxLength++] = c;
+        }
+    }
+    return rxLength;
+}
+
+// Siguiente carácter de entrada o -1. Lo que queda en el buffer tras
+// una línea completa sigue disponible para el comando que se ejecuta
+// (p.ej. nano) o para la siguiente línea.
+int ShellSession::readInput() {
+    if(inputLock) xSemaphoreTake(inputLock, portMAX_DELAY);
+    int c = -1;
+    if(rxPos < rxLength || refill() > 0) {
+        c = rxBuffer[rxPos++];
+    }
+    if(inputLock) xSemaphoreGive(inputLock);
+    return c;
+}
+
+// El comando en curso no lee la entrada: la tarea Telnet (o el evento
+// UART) la recoge aquí para ver Ctrl+C. Lo leído queda en el buffer y
+// el comando o el editor de línea lo procesan después.
+void ShellSession::watchInput() {
+    if(!runningCommand) return;
+    
+    if(telnet) {
+        // TelnetProtocol busca Ctrl+C / IAC IP al leer del socket
+        telnet->pollInterrupt();
+        return;
+    }
+    if(type != SESSION_SERIAL || !in || !inputLock) return;
+    
+    xSemaphoreTake(inputLock, portMAX_DELAY);
+    if(rxPos > 0) {
+        memmove(rxBuffer, rxBuffer + rxPos, rxLength - rxPos);
+        rxLength -= rxPos;
+        rxPos = 0;
+    }
+    int avail = in->available();
+    size_t space = sizeof(rxBuffer) - rxLength;
+    if(avail > 0 && space > 0) {
+        size_t n = ((HardwareSerial*)in)->read(rxBuffer + rxLength, min(space, (size_t)avail));
+        for(size_t i = 0; i < n; i++) {
+            if(rxBuffer[rxLength + i] == 3) cancelled = true;
+        }
+        rxLength += n;
+    }
+    xSemaphoreGive(inputLock);
+}
+
+bool ShellSession::interrupted() {
+    if(!cancelled && deadline && (long)(millis() - deadline) >= 0) {
+        timedOut = true;
+        cancelled = true;
+    }
+    return cancelled;
+}
+
+// delay() en tramos cortos para responder a Ctrl+C
+bool ShellSession::sleep(unsigned long ms) {
+    TraceScope trace("sleep", ms);
+    unsigned long start = millis();
+    while(millis() - start < ms) {
+        if(interrupted()) return false;
+        unsigned long left = ms - (millis() - start);
+        delay(min(left, 50UL));
+    }
+    return !interrupted();
+}
+
+// Al empezar un comando desde el prompt
+void ShellSession::resetCancel() {
+    cancelled = false;
+    deadline = 0;
+    timedOut = false;
+}
+
+size_t ShellSession::write(const uint8_t* data, size_t len) {
+    if(!out) {
+        return 0;
+    }
+    return out->write(data, len);
+}
+
+// El echo se acumula y se envía en una sola escritura por lote de entrada
+void ShellSession::echoBytes(const char* data, size_t len) {
+    if(echoLength + len > sizeof(echoBuffer)) {
+        flushEcho();
+    }
+    if(len > sizeof(echoBuffer)) {
+        write((const uint8_t*)data, len);
+        return;
+    }
+    memcpy(echoBuffer + echoLength, data, len);
+    echoLength += len;
+}
+
+void ShellSession::flushEcho() {
+    if(echoLength > 0) {
+        write((const uint8_t*)echoBuffer, echoLength);
+        echoLength = 0;
+    }
+}
+
+// Vaciar la salida pendiente (p.ej. el flujo comprimido de telnet)
+void ShellSession::flush() {
+    if(out) {
+        out->flush();
+    }
+}
+
+int ShellSession::formatPrompt(char* buffer, size_t size) {
+    int len = snprintf(buffer, size, "mimik:%s$ ", currentPath);
+    return min(len, (int)size - 1);
+}
+
+void ShellSession::printPrompt() {
+    char prompt[MAX_PATH_LENGTH + 20];
+    int len = formatPrompt(prompt, sizeof(prompt));
+    write((const uint8_t*)prompt, len);
+    flush();
+}
+
+const char* ShellSession::historyPath() {
+    return type == SESSION_TELNET ? HISTORY_FILE_TELNET : HISTORY_FILE_SERIAL;
+}
+
+// El historial se lee y escribe entre comandos, sin hacer esperar a la
+// sesión: si otro comando tiene la SD, se queda vacío al abrir o el lote
+// sigue pendiente hasta la próxima vez.
+void ShellSession::loadHistory() {
+    if(type == SESSION_JOB) return;
+    if(!CommandExecutor::tryAcquire(CMD_RES_SD_READ)) return;
+    editor.history.load(historyPath());
+    CommandExecutor::release(CMD_RES_SD_READ);
+}
+
+void ShellSession::saveHistory() {
+    if(type == SESSION_JOB || editor.history.pending() == 0) return;
+    if(!CommandExecutor::tryAcquire(CMD_RES_SD_WRITE)) return;
+    editor.history.save(historyPath());
+    CommandExecutor::release(CMD_RES_SD_WRITE);
+}
+
+ShellSession* ShellSession::current() {
+    if(taskSession) {
+        return taskSession;
+    }
+    return defaultSession;
+}
+
+void ShellSession::setCurrent(ShellSession* session) {
+    taskSession = session;
+}
+
+void ShellSession::setDefault(ShellSession* session) {
+    defaultSession = session;
+}
+
+int ShellSession::count() {
+    int n = 0;
+    portENTER_CRITICAL(&registryLock);
+    for(int i = 0; i < MAX_SESSIONS; i++) {
+        if(sessions[i]) n++;
+    }
+    portEXIT_CRITICAL(&registryLock);
+    return n;
+}
+
+ShellSession* ShellSession::get(int index) {
+    ShellSession* result = nullptr;
+    portENTER_CRITICAL(&registryLock);
+    int n = 0;
+    for(int i = 0; i < MAX_SESSIONS; i++) {
+        if(sessions[i]) {
+            if(n == index) {
+                result = sessions[i];
+                break;
+            }
+            n++;
+        }
+    }
+    portEXIT_CRITICAL(&registryLock);
+    return result;
+}
@@ -0,0 +1,129 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * shellSession.h - Contexto por sesión (serial o telnet)
+ */
+
+#ifndef SHELL_SESSION_H
+#define SHELL_SESSION_H
+
+#include <Arduino.h>
+#include "shell.h"
+#include "lineEditor.h"
+#include "profiler.h"
+#include <freertos/semphr.h>
+
+class TelnetProtocol;
+
+// Número máximo de sesiones registradas (serial + telnet)
+#define MAX_SESSIONS 8
+// Entrada leída en bloque y pendiente de procesar
+#define SESSION_RX_BUFFER 128
+// Echo acumulado antes de enviarlo en una sola escritura
+#define SESSION_ECHO_BUFFER 64
+
+// Cada sesión tiene su propio directorio actual, buffer de línea,
+// salida y comando en ejecución. Los comandos acceden a la sesión
+// de la tarea que los ejecuta mediante ShellSession::current().
+class ShellSession {
+public:
+    enum SessionType {
+        SESSION_SERIAL,
+        SESSION_TELNET,
+        SESSION_JOB             // Trabajo en segundo plano (sin entrada)
+    };
+
+    SessionType type;
+    int id;
+    bool active;
+    bool echo;              // Hacer echo de la entrada (serial sí, telnet no)
+    char peer[24];          // Origen de la sesión (puerto o IP remota)
+
+    char currentPath[MAX_PATH_LENGTH];
+    LineEditor editor;      // Línea en edición e historial
+
+    Stream* in;             // Entrada de la sesión
+    Print* out;             // Salida de la sesión
+    TelnetProtocol* telnet; // Protocolo Telnet (nullptr en serial)
+
+    int termCols;           // Tamaño de terminal (NAWS en telnet)
+    int termRows;
+
+    const Command* volatile runningCommand;
+    unsigned long commandStart;
+    unsigned long lastActivity;
+    unsigned long commandsRun;
+    uint8_t scriptDepth;    // 'source' anidados en curso
+
+    // Bytes de la SD leídos / escritos por los comandos de la sesión
+    // y medición del último comando (para 'time')
+    uint32_t sdBytesRead;
+    uint32_t sdBytesWritten;
+    ProfileSample lastProfile;
+
+    // Cancelación cooperativa del comando en curso: Ctrl+C (visto por
+    // watchInput), 'kill' o el plazo de 'timeout'
+    volatile bool cancelled;
+    unsigned long deadline;  // millis() límite (0 = sin plazo)
+    bool timedOut;
+
+    ShellSession();
+
+    void open(SessionType sessionType, Stream* input, Print* output, const char* peerName);
+    void close();
+
+    // Entrada
+    InputResult feed(char c);
+    char* line() { return editor.line(); }
+    void resetLine();
+    int readInput();
+    bool hasBufferedInput() { return rxPos < rxLength; }
+
+    // Desde otra tarea mientras corre un comando: recoge la entrada
+    // pendiente y marca la cancelación si llega Ctrl+C
+    void watchInput();
+
+    // Para los bucles largos de los comandos
+    bool interrupted();
+    bool sleep(unsigned long ms);   // false si se interrumpe
+    void resetCancel();
+
+    // Salida
+    size_t write(const uint8_t* data, size_t len);
+    void echoBytes(const char* data, size_t len);
+    void flushEcho();
+    void flush();
+    int formatPrompt(char* buffer, size_t size);
+    void printPrompt();
+
+    // Historial persistente en la SD
+    const char* historyPath();
+    void loadHistory();
+    void saveHistory();
+
+    // Sesión asociada a la tarea actual (serial por defecto)
+    static ShellSession* current();
+    static void setCurrent(ShellSession* session);
+    static void setDefault(ShellSession* session);
+    static ShellSession* getDefault() { return defaultSession; }
+
+    // Registro de sesiones activas (para 'who')
+    static int count();
+    static ShellSession* get(int index);
+
+private:
+    uint8_t rxBuffer[SESSION_RX_BUFFER];
+    size_t rxPos;
+    size_t rxLength;
+    char echoBuffer[SESSION_ECHO_BUFFER];
+    size_t echoLength;
+    SemaphoreHandle_t inputLock;   // rxBuffer: comando y watchInput
+
+    size_t refill();
+
+    static ShellSession* defaultSession;
+    static ShellSession* sessions[MAX_SESSIONS];
+    static int nextId;
+    static portMUX_TYPE registryLock;
+};
+
+#endif
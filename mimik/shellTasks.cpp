@@ -5,36 +5,104 @@
 
 #include "shell.h"
 #include "sshServer.h"
+#include "jobManager.h"
+#include "shellSession.h"
+#include "metrics.h"
+#include "sdSpace.h"
+#include "commandExecutor.h"
+#include "tracer.h"
+#include "sysLog.h"
+#include "wifiScanner.h"
+#include "scriptEngine.h"
 #include <esp_task_wdt.h>
 
+// Stack de cada tarea en bytes ('stacks' muestra el uso real)
+#define SHELL_TASK_STACK 4096
+#define MONITOR_TASK_STACK 3072
+#define TELNET_TASK_STACK 4096
+#define TELNET_WORKER_STACK 8192  // Los comandos se ejecutan en este stack
+
 // Handles de las tareas
 TaskHandle_t shellTaskHandle = NULL;
 TaskHandle_t sdMonitorTaskHandle = NULL;
 TaskHandle_t telnetTaskHandle = NULL;
+TaskHandle_t telnetWorkerHandles[TELNET_WORKERS] = {NULL};
+
+// Lo activa setup() al terminar (ver startShell)
+static volatile bool shellStarted = false;
+
+// Callback del driver UART (se ejecuta en su tarea de eventos):
+// despierta a la tarea del shell cuando llegan datos. Si hay un comando
+// en curso, recoge la entrada para que Ctrl+C lo pueda cancelar.
+static void onSerialReceive() {
+    ShellSession* console = ShellSession::getDefault();
+    if(console && console->runningCommand) {
+        console->watchInput();
+    }
+    if(shellTaskHandle) {
+        xTaskNotifyGive(shellTaskHandle);
+    }
+}
 
 // Tarea principal del shell
 void shellTask(void* parameter) {
+    // El script de arranque corre aquí y no en setup(): con las tareas
+    // ya creadas funcionan Ctrl+C, 'kill' y los trabajos '&'. La entrada
+    // que llegue mientras tanto se procesa después.
+    while(!shellStarted) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    ScriptEngine::autorun();
+    shell.printPrompt();
+    
     while(true) {
         shell.processInput();
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        // Bloqueada hasta el siguiente evento de recepción UART.
+        // Las notificaciones se acumulan, así que no se pierde ninguna.
+        TRACE_BEGIN("wait.uart", 0);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        TRACE_END("wait.uart", 0);
     }
 }
 
-// Tarea de monitoreo de SD (opcional)
+// Tarea de monitoreo: muestrea los recursos para 'stats' y mantiene
+// al día el contador de espacio de la SD
 void sdMonitorTask(void* parameter) {
+    TickType_t lastWake = xTaskGetTickCount();
     while(true) {
-        // Obtener información de la tarjeta SD
-        uint64_t cardSize = SD_MMC.cardSize() / (1024 * 1024);
-        uint64_t usedSize = SD_MMC.usedBytes() / (1024 * 1024);
-        uint64_t totalSize = SD_MMC.totalBytes() / (1024 * 1024);
+        // Recorrer la FAT al arrancar y cada SDSPACE_RECONCILE_MS, solo
+        // si nadie está escribiendo (si no, se reintenta en la siguiente)
+        if(SdSpace::due() && CommandExecutor::tryAcquire(CMD_RES_SD_READ)) {
+            SdSpace::reconcile();
+            CommandExecutor::release(CMD_RES_SD_READ);
+        }
+        
+        // Uso de la tarjeta SD (contador, sin recorrer la FAT)
+        int32_t usedSize = -1;
+        if(SdSpace::known()) {
+            usedSize = SdSpace::used() / (1024 * 1024);
+        }
         
-        // Esta información se puede usar para estadísticas
+        Metrics::sample(usedSize);
         
-        vTaskDelay(10000 / portTICK_PERIOD_MS);
+        // Escaneo WiFi que nadie esperó (wifiscan cancelado): a la caché
+        WifiScanner::poll();
+        
+        vTaskDelayUntil(&lastWake, METRICS_INTERVAL_MS / portTICK_PERIOD_MS);
+    }
+}
+
+// Worker Telnet: atiende por turnos a todas las sesiones con entrada pendiente
+void telnetWorkerTask(void* parameter) {
+    while(true) {
+        if(!sshServer.serviceClients()) {
+            TraceScope trace("sleep", 10);
+            vTaskDelay(10 / portTICK_PERIOD_MS);
+        }
     }
 }
 
-// Tarea del servidor Telnet
+// Tarea del servidor Telnet (acepta y libera conexiones)
 void telnetTask(void* parameter) {
     // Esperar a que WiFi esté conectado
     //Serial.println("Telnet task: Waiting for WiFi connection...");
@@ -48,11 +116,33 @@ void telnetTask(void* parameter) {
     if(sshServer.begin()) {
         //Serial.println("Telnet server started successfully");
     } else {
-        Serial.println("Failed to start Telnet server");
+        SysLog::error("telnet", "Failed to start the Telnet server");
         vTaskDelete(NULL);
         return;
     }
     
+    // Crear los workers que ejecutan los comandos de las sesiones
+    for(int i = 0; i < TELNET_WORKERS; i++) {
+        // El nombre se conserva: lo usa 'stats'
+        static char names[TELNET_WORKERS][16];
+        char* name = names[i];
+        snprintf(name, sizeof(names[i]), "TelnetWork%d", i);
+        BaseType_t result = xTaskCreatePinnedToCore(
+            telnetWorkerTask,
+            name,
+            TELNET_WORKER_STACK,
+            NULL,
+            1,
+            &telnetWorkerHandles[i],
+            0  // Core 0
+        );
+        if(result != pdPASS) {
+            SysLog::warn("telnet", "Cannot create Telnet worker %d", i);
+        } else {
+            Metrics::watchTask(name, telnetWorkerHandles[i], TELNET_WORKER_STACK);
+        }
+    }
+    
     // Loop del servidor Telnet
     while(true) {
         sshServer.loop();
@@ -69,7 +159,7 @@ bool initShellTasks() {
     BaseType_t result = xTaskCreatePinnedToCore(
         shellTask,
         "ShellTask",
-        4096,
+        SHELL_TASK_STACK,
         NULL,
         1,
         &shellTaskHandle,
@@ -77,15 +167,29 @@ bool initShellTasks() {
     );
     
     if(result != pdPASS) {
-        Serial.println("ERROR: Cannot create shell task");
+        SysLog::error("tasks", "Cannot create shell task");
         return false;
     }
     
+    // Entrada serial por eventos en lugar de sondeo
+    Serial.onReceive(onSerialReceive);
+    
+    // Series de métricas para 'stats'
+    if(!Metrics::begin()) {
+        SysLog::warn("tasks", "Cannot allocate metrics buffers");
+    }
+    Metrics::watchTask("ShellTask", shellTaskHandle, SHELL_TASK_STACK);
+    
+    // Workers de trabajos en segundo plano (stack preasignado)
+    if(!JobManager::begin()) {
+        SysLog::warn("tasks", "Cannot create job queue");
+    }
+    
     // Crear tarea de monitoreo
     result = xTaskCreatePinnedToCore(
         sdMonitorTask,
         "SDMonitor",
-        2048,
+        MONITOR_TASK_STACK,
         NULL,
         0,
         &sdMonitorTaskHandle,
@@ -93,14 +197,16 @@ bool initShellTasks() {
     );
     
     if(result != pdPASS) {
-        Serial.println("WARNING: Cannot create monitor task");
+        SysLog::warn("tasks", "Cannot create monitor task");
+    } else {
+        Metrics::watchTask("SDMonitor", sdMonitorTaskHandle, MONITOR_TASK_STACK);
     }
     
     // Crear tarea Telnet
     result = xTaskCreatePinnedToCore(
         telnetTask,
         "TelnetTask",
-        8192,  // 8KB de stack es suficiente para Telnet
+        TELNET_TASK_STACK,  // Solo acepta conexiones; los comandos corren en los workers
         NULL,
         1,
         &telnetTaskHandle,
@@ -108,11 +214,24 @@ bool initShellTasks() {
     );
     
     if(result != pdPASS) {
-        Serial.println("WARNING: Cannot create Telnet task");
+        SysLog::warn("tasks", "Cannot create Telnet task");
     } else {
-        Serial.println("Telnet task created successfully");
+        Metrics::watchTask("TelnetTask", telnetTaskHandle, TELNET_TASK_STACK);
+    }
+    
+    // Volcado del registro a la SD
+    if(!SysLog::startWriter()) {
+        SysLog::warn("tasks", "Cannot create log writer task");
     }
     
-    Serial.println("mimik tasks initialized successfully");
+    SysLog::info("tasks", "mimik tasks initialized");
     return true;
+}
+
+// Fin de setup(): la consola pasa a la tarea del shell
+void startShell() {
+    shellStarted = true;
+    if(shellTaskHandle) {
+        xTaskNotifyGive(shellTaskHandle);
+    }
 }
\ No newline at end of file
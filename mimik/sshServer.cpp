@@ -4,19 +4,23 @@
  */
 
 #include "sshServer.h"
+#include "sysLog.h"
 #include <stdarg.h>
 
 SSHServer sshServer;
 
-// Inicializar variables estáticas de ShellOutput
-ShellOutput::OutputMode ShellOutput::currentMode = ShellOutput::MODE_SERIAL;
-SSHServer* ShellOutput::sshServer = nullptr;
+// Protege la asignación de conexiones a los workers
+static portMUX_TYPE slotLock = portMUX_INITIALIZER_UNLOCKED;
 
 SSHServer::SSHServer() {
     server = nullptr;
-    clientConnected = false;
-    cmdIndex = 0;
-    memset(cmdBuffer, 0, MAX_CMD_LENGTH);
+    nextSlot = 0;
+    
+    for(int i = 0; i < MAX_CLIENTS; i++) {
+        connections[i].inUse = false;
+        connections[i].busy = false;
+        connections[i].closing = false;
+    }
 }
 
 SSHServer::~SSHServer() {
@@ -25,195 +29,247 @@ SSHServer::~SSHServer() {
 
 bool SSHServer::begin() {
     if(WiFi.status() != WL_CONNECTED) {
-        Serial.println("ERROR: WiFi not connected. Cannot start Telnet server.");
+        SysLog::error("telnet", "WiFi not connected, cannot start the server");
         return false;
     }
     
     //Serial.println("Starting Telnet server...");
     
     // Crear servidor TCP
-    server = new WiFiServer(TELNET_PORT);
+    server = new WiFiServer(TELNET_PORT, MAX_CLIENTS);
     if(!server) {
-        Serial.println("ERROR: Cannot create WiFi server");
+        SysLog::error("telnet", "Cannot create the TCP server");
         return false;
     }
     
     server->begin();
     server->setNoDelay(true);  // Desactivar algoritmo Nagle para respuesta rápida
     
-    Serial.printf("Telnet server listening on %s:%d\n", 
-                  WiFi.localIP().toString().c_str(), TELNET_PORT);
+    IPAddress ip = WiFi.localIP();
+    SysLog::info("telnet", "Listening on %u.%u.%u.%u:%d (max %d sessions)",
+                 ip[0], ip[1], ip[2], ip[3], TELNET_PORT, MAX_CLIENTS);
     //Serial.println("Connect with: telnet " + WiFi.localIP().toString());
     
     return true;
 }
 
+// Llamado por la tarea Telnet: acepta clientes y libera los desconectados.
+// La entrada de los clientes la procesan los workers (serviceClients).
 void SSHServer::loop() {
     if(!server) return;
     
-    // Aceptar nuevos clientes
-    if(!clientConnected) {
-        if(server->hasClient()) {
-            // Desconectar cliente anterior si existe
-            if(client && client.connected()) {
-                client.stop();
-            }
-            
-            client = server->available();
-            if(client && client.connected()) {
-                Serial.println("Telnet: Client connected from " + client.remoteIP().toString());
-                clientConnected = true;
-                cmdIndex = 0;
-                memset(cmdBuffer, 0, MAX_CMD_LENGTH);
-                
-                // Cambiar modo de salida
-                ShellOutput::setMode(ShellOutput::MODE_SSH, this);
-                
-                // Enviar banner de bienvenida
-                sendString("\r\n");
-                sendString("===========================================\r\n");
-                sendString("  Welcome to mimik Telnet Shell\r\n");
-                sendString("  ESP32-CAM Remote Access\r\n");
-                sendString("===========================================\r\n");
-                sendString("\r\n");
-                sendPrompt();
-            }
+    acceptClients();
+    watchClients();
+    reapClients();
+}
+
+// Mientras un worker ejecuta un comando nadie lee el socket de esa
+// sesión: leerlo aquí permite que Ctrl+C lo cancele.
+void SSHServer::watchClients() {
+    for(int i = 0; i < MAX_CLIENTS; i++) {
+        TelnetConnection* conn = &connections[i];
+        if(conn->inUse && conn->busy && conn->session.runningCommand) {
+            conn->session.watchInput();
         }
-        return;
-    }
-    
-    // Manejar cliente conectado
-    if(client && client.connected()) {
-        handleClient();
-    } else {
-        // Cliente desconectado
-        Serial.println("Telnet: Client disconnected");
-        stop();
     }
 }
 
-void SSHServer::handleClient() {
-    while(client.available()) {
-        char c = client.read();
-        
-        // Filtrar caracteres de control Telnet (IAC = 255)
-        if((uint8_t)c == 255) {
-            // Ignorar secuencias de negociación Telnet
-            if(client.available()) client.read();
-            if(client.available()) client.read();
+void SSHServer::acceptClients() {
+    while(server->hasClient()) {
+        WiFiClient newClient = server->available();
+        if(!newClient || !newClient.connected()) {
             continue;
         }
         
-        // Procesar entrada
-        if(c == '\r' || c == '\n') {
-            if(cmdIndex > 0) {
-                sendString("\r\n");
-                cmdBuffer[cmdIndex] = '\0';
-                processCommand(cmdBuffer);
-                cmdIndex = 0;
-                memset(cmdBuffer, 0, MAX_CMD_LENGTH);
-                sendPrompt();
+        // Buscar un slot libre
+        TelnetConnection* conn = nullptr;
+        for(int i = 0; i < MAX_CLIENTS; i++) {
+            if(!connections[i].inUse) {
+                conn = &connections[i];
+                break;
             }
-        } else if(c == 127 || c == 8) { // Backspace
-            if(cmdIndex > 0) {
-                cmdIndex--;
-                sendString("\b \b");
-            }
-        } else if(c == 3) { // Ctrl+C
-            sendString("^C\r\n");
-            cmdIndex = 0;
-            memset(cmdBuffer, 0, MAX_CMD_LENGTH);
-            sendPrompt();
-        } else if(c == 4) { // Ctrl+D (EOF)
-            sendString("\r\nLogout\r\n");
-            stop();
-            return;
-        } else if(c >= 32 && c < 127 && cmdIndex < MAX_CMD_LENGTH - 1) {
-            // Solo caracteres imprimibles
-            cmdBuffer[cmdIndex++] = c;
-            // NO hacer echo - el cliente ya lo muestra
         }
+        
+        if(!conn) {
+            newClient.print("\r\nToo many sessions, try again later\r\n");
+            newClient.stop();
+            SysLog::warn("telnet", "Connection rejected (no free sessions)");
+            continue;
+        }
+        
+        conn->client = newClient;
+        conn->client.setNoDelay(true);
+        conn->busy = false;
+        conn->closing = false;
+        conn->session.open(ShellSession::SESSION_TELNET, &conn->telnet, &conn->telnet,
+                           conn->client.remoteIP().toString().c_str());
+        conn->telnet.begin(&conn->client, &conn->session);
+        conn->session.loadHistory();
+        
+        SysLog::info("telnet", "Client connected from %s (session %d)",
+                     conn->session.peer, conn->session.id);
+        
+        // Enviar banner de bienvenida
+        sendString(conn, "\r\n");
+        sendString(conn, "===========================================\r\n");
+        sendString(conn, "  Welcome to mimik Telnet Shell\r\n");
+        sendString(conn, "  ESP32-CAM Remote Access\r\n");
+        sendString(conn, "===========================================\r\n");
+        sendString(conn, "\r\n");
+        conn->session.printPrompt();
+        
+        // Visible para los workers a partir de aquí
+        conn->inUse = true;
+    }
+}
+
+void SSHServer::reapClients() {
+    for(int i = 0; i < MAX_CLIENTS; i++) {
+        TelnetConnection* conn = &connections[i];
+        
+        portENTER_CRITICAL(&slotLock);
+        bool claimed = conn->inUse && !conn->busy;
+        if(claimed) conn->busy = true;
+        portEXIT_CRITICAL(&slotLock);
+        
+        if(!claimed) continue;
+        
+        if(conn->closing || (!conn->client.connected() && !conn->telnet.hasInput())) {
+            closeConnection(conn);
+        }
+        releaseConnection(conn);
+    }
+}
+
+// Reclamar la siguiente conexión con entrada pendiente (round-robin)
+TelnetConnection* SSHServer::claimConnection() {
+    for(int n = 0; n < MAX_CLIENTS; n++) {
+        portENTER_CRITICAL(&slotLock);
+        TelnetConnection* conn = &connections[nextSlot];
+        nextSlot = (nextSlot + 1) % MAX_CLIENTS;
+        bool claimed = conn->inUse && !conn->busy && !conn->closing;
+        if(claimed) conn->busy = true;
+        portEXIT_CRITICAL(&slotLock);
+        
+        if(!claimed) continue;
+        
+        if(conn->session.hasBufferedInput() || conn->telnet.hasInput()) {
+            return conn;
+        }
+        releaseConnection(conn);
     }
+    return nullptr;
+}
+
+void SSHServer::releaseConnection(TelnetConnection* conn) {
+    portENTER_CRITICAL(&slotLock);
+    conn->busy = false;
+    portEXIT_CRITICAL(&slotLock);
 }
 
-void SSHServer::processCommand(const char* cmdLine) {
-    CommandArgs args;
-    char lineCopy[MAX_CMD_LENGTH];
-    strncpy(lineCopy, cmdLine, MAX_CMD_LENGTH - 1);
-    lineCopy[MAX_CMD_LENGTH - 1] = '\0';
+// Llamado por los workers. Devuelve false si no había trabajo pendiente.
+bool SSHServer::serviceClients() {
+    if(!server) return false;
     
-    // Parsear comando
-    args.argc = 0;
-    char* token = strtok(lineCopy, " \t\n\r");
+    TelnetConnection* conn = claimConnection();
+    if(!conn) return false;
     
-    while(token != NULL && args.argc < MAX_ARGS) {
-        args.argv[args.argc++] = token;
-        token = strtok(NULL, " \t\n\r");
-    }
+    ShellSession::setCurrent(&conn->session);
+    handleClient(conn);
+    ShellSession::setCurrent(nullptr);
+    
+    releaseConnection(conn);
+    return true;
+}
+
+// Procesa la entrada disponible hasta completar un comando, para que
+// una sesión muy activa no acapare al worker.
+void SSHServer::handleClient(TelnetConnection* conn) {
+    ShellSession& session = conn->session;
     
-    if(args.argc > 0) {
-        // Buscar y ejecutar comando
-        Command* cmd = shell.findCommand(args.argv[0]);
+    // La negociación Telnet se resuelve dentro de TelnetProtocol
+    int input;
+    while((input = session.readInput()) >= 0) {
+        char c = (char)input;
         
-        if(cmd != NULL) {
-            int argCount = args.argc - 1;
-            if(argCount < cmd->minArgs) {
-                ShellOutput::printf("ERROR: %s requires at least %d argument(s)\r\n", 
-                                   cmd->name, cmd->minArgs);
-            } else if(argCount > cmd->maxArgs) {
-                ShellOutput::printf("ERROR: %s accepts maximum %d argument(s)\r\n", 
-                                   cmd->name, cmd->maxArgs);
-            } else {
-                ShellError err = cmd->function(args);
-                if(err != SHELL_OK) {
-                    ShellOutput::printf("Error executing command (code: %d)\r\n", err);
-                }
-            }
-        } else {
-            ShellOutput::printf("Command not found: %s\r\n", args.argv[0]);
-            ShellOutput::println("Type 'help' to see available commands");
+        switch(session.feed(c)) {
+            case INPUT_LINE:
+                session.flushEcho();
+                if(!session.echo) sendString(conn, "\r\n");
+                session.resetCancel();
+                shell.executeLine(session.line());
+                session.resetLine();
+                session.printPrompt();
+                return;
+            case INPUT_CANCEL: // Ctrl+C
+                session.flushEcho();
+                sendString(conn, "^C\r\n");
+                session.resetLine();
+                session.printPrompt();
+                break;
+            case INPUT_EOF: // Ctrl+D
+                sendString(conn, "\r\nLogout\r\n");
+                conn->closing = true;
+                return;
+            default:
+                // Echo solo si el cliente aceptó WILL ECHO
+                break;
         }
     }
+    
+    // Enviar el echo pendiente (y vaciar el flujo comprimido)
+    session.flushEcho();
+    session.flush();
 }
 
-void SSHServer::sendPrompt() {
-    char prompt[MAX_PATH_LENGTH + 20];
-    snprintf(prompt, sizeof(prompt), "mimik:%s$ ", shell.getCurrentPath());
-    sendString(prompt);
+void SSHServer::closeConnection(TelnetConnection* conn) {
+    SysLog::info("telnet", "Client disconnected (session %d)", conn->session.id);
+    
+    conn->telnet.end();
+    conn->session.close();
+    if(conn->client.connected()) {
+        conn->client.stop();
+    }
+    conn->closing = false;
+    conn->inUse = false;
 }
 
-void SSHServer::sendString(const char* str) {
-    if(client && clientConnected && client.connected()) {
-        client.print(str);
-    }
+void SSHServer::sendString(TelnetConnection* conn, const char* str) {
+    conn->telnet.write((const uint8_t*)str, strlen(str));
 }
 
 void SSHServer::stop() {
-    ShellOutput::setMode(ShellOutput::MODE_SERIAL);
-    
-    if(client && client.connected()) {
-        client.stop();
+    for(int i = 0; i < MAX_CLIENTS; i++) {
+        if(connections[i].inUse) {
+            closeConnection(&connections[i]);
+        }
     }
     
-    clientConnected = false;
-    cmdIndex = 0;
+    if(server) {
+        server->end();
+        delete server;
+        server = nullptr;
+    }
+}
+
+int SSHServer::activeSessions() {
+    int n = 0;
+    for(int i = 0; i < MAX_CLIENTS; i++) {
+        if(connections[i].inUse) n++;
+    }
+    return n;
 }
 
 // ============================================
 // Implementación de ShellOutput
 // ============================================
 
-void ShellOutput::setMode(OutputMode mode, SSHServer* server) {
-    currentMode = mode;
-    sshServer = server;
+ShellOutput::OutputMode ShellOutput::getMode() {
+    return ShellSession::current()->type == ShellSession::SESSION_TELNET ? MODE_SSH : MODE_SERIAL;
 }
 
 void ShellOutput::print(const char* str) {
-    if(currentMode == MODE_SERIAL || !sshServer) {
-        Serial.print(str);
-    } else {
-        sshServer->sendString(str);
-    }
+    ShellSession::current()->write((const uint8_t*)str, strlen(str));
 }
 
 void ShellOutput::print(const String& str) {
@@ -239,11 +295,7 @@ void ShellOutput::print(char c) {
 
 void ShellOutput::println(const char* str) {
     print(str);
-    if(currentMode == MODE_SSH) {
-        print("\r\n");
-    } else {
-        Serial.println();
-    }
+    print("\r\n");
 }
 
 void ShellOutput::println(const String& str) {
@@ -257,11 +309,7 @@ void ShellOutput::println(int num) {
 }
 
 void ShellOutput::println() {
-    if(currentMode == MODE_SSH) {
-        print("\r\n");
-    } else {
-        Serial.println();
-    }
+    print("\r\n");
 }
 
 void ShellOutput::printf(const char* format, ...) {
@@ -274,5 +322,13 @@ void ShellOutput::printf(const char* format, ...) {
 }
 
 void ShellOutput::write(uint8_t c) {
-    print((char)c);
-}
\ No newline at end of file
+    ShellSession::current()->write(&c, 1);
+}
+
+void ShellOutput::write(const uint8_t* data, size_t len) {
+    ShellSession::current()->write(data, len);
+}
+
+void ShellOutput::flush() {
+    ShellSession::current()->flush();
+}
@@ -9,73 +9,87 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include "shell.h"
+#include "shellSession.h"
+#include "telnetProtocol.h"
 
 // Puerto Telnet (23 es estándar, pero puedes usar 22 también)
 #define TELNET_PORT 23
-#define MAX_CLIENTS 1
+#define MAX_CLIENTS 4
+
+// Tareas que atienden a todas las sesiones telnet
+#define TELNET_WORKERS 2
 
 // Forward declaration
 class ShellOutput;
 
+// Conexión telnet: socket + contexto de shell propio
+struct TelnetConnection {
+    WiFiClient client;
+    TelnetProtocol telnet;   // Entrada/salida con negociación Telnet
+    ShellSession session;
+    volatile bool inUse;     // Slot ocupado por un cliente
+    volatile bool busy;      // Reclamado por un worker
+    volatile bool closing;   // Pendiente de cierre
+};
+
 class SSHServer {  // Mantenemos el nombre para compatibilidad con código existente
 private:
     WiFiServer* server;
-    WiFiClient client;
-    bool clientConnected;
-    
-    char cmdBuffer[MAX_CMD_LENGTH];
-    int cmdIndex;
-    
+    TelnetConnection connections[MAX_CLIENTS];
+    int nextSlot;            // Round-robin entre workers
+
     // Métodos privados
-    void handleClient();
-    void processCommand(const char* cmdLine);
-    void sendPrompt();
-    void sendString(const char* str);
-    
+    void acceptClients();
+    void reapClients();
+    void watchClients();
+    TelnetConnection* claimConnection();
+    void releaseConnection(TelnetConnection* conn);
+    void handleClient(TelnetConnection* conn);
+    void closeConnection(TelnetConnection* conn);
+    void sendString(TelnetConnection* conn, const char* str);
+
 public:
     SSHServer();
     ~SSHServer();
-    
+
     bool begin();
     void loop();
+    bool serviceClients();
     void stop();
-    
-    bool isConnected() { return clientConnected; }
-    
+
+    int activeSessions();
+
     friend class ShellOutput;
 };
 
 // Clase para abstraer la salida (Serial o Telnet)
+// La salida va siempre a la sesión de la tarea que ejecuta el comando.
 class ShellOutput {
 public:
     enum OutputMode {
         MODE_SERIAL,
         MODE_SSH  // Mantenemos MODE_SSH por compatibilidad, pero es Telnet
     };
-    
-private:
-    static OutputMode currentMode;
-    static SSHServer* sshServer;
-    
-public:
-    static void setMode(OutputMode mode, SSHServer* server = nullptr);
-    static OutputMode getMode() { return currentMode; }
-    
+
+    static OutputMode getMode();
+
     static void print(const char* str);
     static void print(const String& str);
     static void print(int num);
     static void print(unsigned long num);
     static void print(char c);
-    
+
     static void println(const char* str);
     static void println(const String& str);
     static void println(int num);
     static void println();
-    
+
     static void printf(const char* format, ...);
     static void write(uint8_t c);
+    static void write(const uint8_t* data, size_t len);
+    static void flush();
 };
 
 extern SSHServer sshServer;
 
-#endif
\ No newline at end of file
+#endif
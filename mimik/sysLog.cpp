@@ -0,0 +1,254 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * sysLog.cpp - Implementación del registro del sistema
+ */
+
+#include "sysLog.h"
+#include "shell.h"
+#include "commandExecutor.h"
+#include "bufferPool.h"
+#include "completion.h"
+#include "sdSpace.h"
+#include "metrics.h"
+#include "tracer.h"
+
+LogEntry* SysLog::ring = nullptr;
+uint32_t SysLog::entries = 0;
+uint32_t SysLog::nextIndex = 0;
+uint32_t SysLog::clearedAt = 0;
+uint32_t SysLog::persisted = 0;
+uint32_t SysLog::lost = 0;
+volatile int SysLog::consoleLevel = SYSLOG_INFO;
+TaskHandle_t SysLog::writerTask = NULL;
+
+static const char* const levelNames = "EWID";
+
+bool SysLog::begin() {
+    if(ring) return true;
+    uint32_t count = psramFound() ? SYSLOG_ENTRIES_PSRAM : SYSLOG_ENTRIES_RAM;
+    size_t bytes = count * sizeof(LogEntry);
+    LogEntry* block = psramFound() ? (LogEntry*)ps_malloc(bytes) : (LogEntry*)malloc(bytes);
+    if(!block) {
+        return false;
+    }
+    memset(block, 0, bytes);
+    entries = count;
+    ring = block;
+    return true;
+}
+
+bool SysLog::startWriter() {
+    if(writerTask) return true;
+    BaseType_t result = xTaskCreatePinnedToCore(
+        writerLoop,
+        "LogWriter",
+        SYSLOG_TASK_STACK,
+        NULL,
+        0,
+        &writerTask,
+        0
+    );
+    if(result != pdPASS) {
+        writerTask = NULL;
+        return false;
+    }
+    Metrics::watchTask("LogWriter", writerTask, SYSLOG_TASK_STACK);
+    return true;
+}
+
+char SysLog::levelLetter(int level) {
+    return level >= SYSLOG_ERROR && level <= SYSLOG_DEBUG ? levelNames[level] : '?';
+}
+
+void SysLog::write(LogLevel level, const char* tag, const char* format, va_list args) {
+    if(!ring) {
+        // Antes de begin() solo queda la consola
+        char text[SYSLOG_TEXT];
+        vsnprintf(text, sizeof(text), format, args);
+        Serial.printf("%c %s: %s\n", levelLetter(level), tag, text);
+        return;
+    }
+
+    uint32_t index = __atomic_fetch_add(&nextIndex, 1, __ATOMIC_RELAXED);
+    LogEntry* entry = &ring[index & (entries - 1)];
+    __atomic_store_n(&entry->seq, 0, __ATOMIC_RELAXED);
+    entry->ms = millis();
+    entry->tag = tag;
+    entry->level = level;
+    vsnprintf(entry->text, sizeof(entry->text), format, args);
+    __atomic_store_n(&entry->seq, index + 1, __ATOMIC_RELEASE);
+
+    if(level <= consoleLevel) {
+        char line[SYSLOG_TEXT + 32];
+        SysLog::format(entry, line, sizeof(line));
+        Serial.print(line);
+    }
+
+    // Errores y buffer medio lleno: volcar sin esperar al periodo
+    if(writerTask && (level == SYSLOG_ERROR || index + 1 - persisted >= entries / 2)) {
+        xTaskNotifyGive(writerTask);
+    }
+}
+
+void SysLog::error(const char* tag, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    write(SYSLOG_ERROR, tag, format, args);
+    va_end(args);
+}
+
+void SysLog::warn(const char* tag, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    write(SYSLOG_WARN, tag, format, args);
+    va_end(args);
+}
+
+void SysLog::info(const char* tag, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    write(SYSLOG_INFO, tag, format, args);
+    va_end(args);
+}
+
+void SysLog::debug(const char* tag, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    write(SYSLOG_DEBUG, tag, format, args);
+    va_end(args);
+}
+
+uint32_t SysLog::first() {
+    uint32_t end = head();
+    uint32_t start = end > entries ? end - entries : 0;
+    return clearedAt > start ? clearedAt : start;
+}
+
+// Copia la entrada 'index' si está completa y nadie la ha sobrescrito
+// mientras se copiaba
+bool SysLog::read(uint32_t index, LogEntry* out) {
+    if(!ring) return false;
+    const LogEntry* entry = &ring[index & (entries - 1)];
+    uint32_t seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+    if(seq != index + 1) return false;
+    memcpy(out, entry, sizeof(LogEntry));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&entry->seq, __ATOMIC_RELAXED) != seq) return false;
+    out->text[SYSLOG_TEXT - 1] = '\0';
+    return true;
+}
+
+// "[   12.345] W wifi: texto\n"
+int SysLog::format(const LogEntry* entry, char* buffer, size_t size) {
+    int n = snprintf(buffer, size, "[%5lu.%03lu] %c %s: %s\n",
+                     (unsigned long)(entry->ms / 1000), (unsigned long)(entry->ms % 1000),
+                     levelLetter(entry->level), entry->tag, entry->text);
+    if(n < 0) return 0;
+    return n < (int)size ? n : (int)size - 1;
+}
+
+static void segmentPath(char* buffer, size_t size, int segment) {
+    snprintf(buffer, size, SYSLOG_DIR "/mimik%d.log", segment);
+}
+
+// mimik0 -> mimik1 -> ... ; el más antiguo se borra
+void SysLog::rotate() {
+    char from[32], to[32];
+    segmentPath(to, sizeof(to), SYSLOG_SEGMENTS - 1);
+    int64_t oldest = SdSpace::sizeOf(to);
+    if(oldest >= 0 && SD_MMC.remove(to)) {
+        SdSpace::adjust(-oldest);
+    }
+    for(int k = SYSLOG_SEGMENTS - 1; k > 0; k--) {
+        segmentPath(from, sizeof(from), k - 1);
+        segmentPath(to, sizeof(to), k);
+        if(SD_MMC.exists(from)) {
+            SD_MMC.rename(from, to);
+        }
+    }
+    DirCache::invalidate(to);
+}
+
+void SysLog::flush() {
+    uint32_t end = head();
+    if(!ring || persisted == end || SD_MMC.cardType() == CARD_NONE) {
+        return;
+    }
+    // Si un comando está escribiendo en la SD se reintenta en el siguiente ciclo
+    if(!CommandExecutor::tryAcquire(CMD_RES_SD_WRITE)) {
+        return;
+    }
+    TraceScope trace("log.flush", end - persisted);
+
+    uint32_t index = persisted;
+    if(end - index > entries) {
+        lost += end - index - entries;
+        index = end - entries;
+    }
+
+    size_t capacity = 0;
+    char* buffer = (char*)BufferPool::acquire(SYSLOG_WRITE_BUFFER, 1024, POOL_ANY, &capacity);
+    if(!buffer) {
+        CommandExecutor::release(CMD_RES_SD_WRITE);
+        return;
+    }
+
+    if(!SD_MMC.exists(SYSLOG_DIR)) {
+        SD_MMC.mkdir(SYSLOG_DIR);
+        DirCache::invalidate(SYSLOG_DIR);
+    }
+    char path[32];
+    segmentPath(path, sizeof(path), 0);
+    if(!SD_MMC.exists(path)) {
+        DirCache::invalidate(path);
+    }
+    File file = SD_MMC.open(path, FILE_APPEND);
+    if(!file) {
+        BufferPool::release(buffer);
+        CommandExecutor::release(CMD_RES_SD_WRITE);
+        return;
+    }
+
+    size_t length = 0;
+    size_t total = 0;
+    LogEntry entry;
+    for(; index != end; index++) {
+        if(!read(index, &entry)) {
+            // A medias (0, o aún la de la vuelta anterior si el escritor no
+            // ha llegado a marcarla): se volcará la próxima vez. Solo una
+            // secuencia posterior significa que se sobrescribió.
+            uint32_t seq = __atomic_load_n(&ring[index & (entries - 1)].seq, __ATOMIC_ACQUIRE);
+            if(seq == 0 || (int32_t)(seq - (index + 1)) < 0) break;
+            lost++;
+            continue;
+        }
+        if(capacity - length < SYSLOG_TEXT + 32) {
+            file.write((const uint8_t*)buffer, length);
+            total += length;
+            length = 0;
+        }
+        length += format(&entry, buffer + length, capacity - length);
+    }
+    if(length > 0) {
+        file.write((const uint8_t*)buffer, length);
+        total += length;
+    }
+    size_t segmentSize = file.size();
+    file.close();
+    persisted = index;
+    SdSpace::adjust(total);
+
+    if(segmentSize >= SYSLOG_SEGMENT_BYTES) {
+        rotate();
+    }
+
+    BufferPool::release(buffer);
+    CommandExecutor::release(CMD_RES_SD_WRITE);
+}
+
+void SysLog::writerLoop(void* parameter) {
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SYSLOG_FLUSH_MS));
+        flush();
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * sysLog.h - Registro del sistema por niveles (dmesg)
+ */
+
+#ifndef SYS_LOG_H
+#define SYS_LOG_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Entradas del buffer circular (potencia de 2)
+#define SYSLOG_ENTRIES_PSRAM 1024
+#define SYSLOG_ENTRIES_RAM 64
+#define SYSLOG_TEXT 100
+
+// Persistencia en la SD: segmentos rotativos escritos por bloques
+#define SYSLOG_DIR "/log"
+#define SYSLOG_SEGMENTS 4               // /log/mimik0.log (actual) .. mimik3.log
+#define SYSLOG_SEGMENT_BYTES 65536
+#define SYSLOG_FLUSH_MS 5000            // Como mucho este retraso hasta la SD
+#define SYSLOG_WRITE_BUFFER 8192
+#define SYSLOG_TASK_STACK 3072
+
+enum LogLevel {
+    SYSLOG_ERROR = 0,
+    SYSLOG_WARN,
+    SYSLOG_INFO,
+    SYSLOG_DEBUG
+};
+
+struct LogEntry {
+    uint32_t seq;           // índice + 1 cuando está completa (0: a medias)
+    uint32_t ms;
+    const char* tag;        // Cadena estática ("wifi", "telnet"...)
+    uint8_t level;
+    char text[SYSLOG_TEXT];
+};
+
+// Cualquier tarea puede registrar sin bloquearse: cada entrada reserva
+// su hueco con un incremento atómico y se marca como completa al final
+// (número de secuencia), así que los lectores descartan las que están a
+// medias o se han sobrescrito. Una tarea de fondo vuelca lo nuevo a la
+// SD en una sola escritura cada SYSLOG_FLUSH_MS (antes si se acumula o
+// hay un error). La consola serial solo recibe los niveles hasta
+// consoleLevel, para no mezclarse con lo que escribe el usuario.
+class SysLog {
+public:
+    // Buffer circular (lo antes posible en setup)
+    static bool begin();
+    // Tarea de volcado a la SD (con la SD montada)
+    static bool startWriter();
+
+    static void error(const char* tag, const char* format, ...);
+    static void warn(const char* tag, const char* format, ...);
+    static void info(const char* tag, const char* format, ...);
+    static void debug(const char* tag, const char* format, ...);
+    static void write(LogLevel level, const char* tag, const char* format, va_list args);
+
+    static void setConsoleLevel(int level) { consoleLevel = level; }
+
+    // Lectura (dmesg): índices absolutos en [first(), head())
+    static uint32_t head() { return __atomic_load_n(&nextIndex, __ATOMIC_ACQUIRE); }
+    static uint32_t first();
+    static bool read(uint32_t index, LogEntry* out);
+    static void clear() { clearedAt = head(); }
+    static int format(const LogEntry* entry, char* buffer, size_t size);
+    static char levelLetter(int level);
+
+    static uint32_t capacity() { return entries; }
+    static uint32_t persistedCount() { return persisted; }
+    static uint32_t lostCount() { return lost; }
+
+private:
+    static LogEntry* ring;
+    static uint32_t entries;
+    static uint32_t nextIndex;
+    static uint32_t clearedAt;
+    static uint32_t persisted;      // Primera entrada aún no volcada
+    static uint32_t lost;           // Sobrescritas antes de volcarse
+    static volatile int consoleLevel;
+    static TaskHandle_t writerTask;
+
+    static void writerLoop(void* parameter);
+    static void flush();
+    static void rotate();
+};
+
+#endif
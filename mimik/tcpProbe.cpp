@@ -0,0 +1,167 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * tcpProbe.cpp - Implementación de las conexiones TCP en paralelo
+ */
+
+#include "tcpProbe.h"
+#include <lwip/sockets.h>
+
+TcpProber::TcpProber(int window, uint32_t timeoutMs)
+    : window(constrain(window, 1, TCP_PROBE_MAX_WINDOW)), inUse(0), timeoutMs(timeoutMs) {
+    for(int i = 0; i < TCP_PROBE_MAX_WINDOW; i++) {
+        slots[i].fd = -1;
+    }
+}
+
+TcpProber::~TcpProber() {
+    for(int i = 0; i < TCP_PROBE_MAX_WINDOW; i++) {
+        if(slots[i].fd >= 0) {
+            close(slots[i].fd);
+            slots[i].fd = -1;
+        }
+    }
+}
+
+const char* TcpProber::stateName(uint8_t state) {
+    switch(state) {
+        case TCP_PROBE_OPEN:    return "open";
+        case TCP_PROBE_CLOSED:  return "closed";
+        case TCP_PROBE_TIMEOUT: return "filtered";
+        default:                return "error";
+    }
+}
+
+bool TcpProber::start(uint32_t addr, uint16_t port) {
+    if(inUse >= window) return false;
+    int index = -1;
+    for(int i = 0; i < window; i++) {
+        if(slots[i].fd < 0) {
+            index = i;
+            break;
+        }
+    }
+    if(index < 0) return false;
+
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(fd < 0) {
+        return false;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    Slot* slot = &slots[index];
+    slot->fd = fd;
+    slot->addr = addr;
+    slot->port = port;
+    slot->done = false;
+    slot->error = 0;
+    slot->connectUs = 0;
+    slot->startMs = millis();
+    slot->startUs = micros();
+    inUse++;
+
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = addr;
+    to.sin_port = htons(port);
+    if(connect(fd, (struct sockaddr*)&to, sizeof(to)) == 0) {
+        slot->done = true;
+        slot->state = TCP_PROBE_OPEN;
+        slot->connectUs = micros() - slot->startUs;
+    } else if(errno != EINPROGRESS) {
+        slot->done = true;
+        slot->error = errno;
+        slot->state = errno == ECONNREFUSED ? TCP_PROBE_CLOSED : TCP_PROBE_ERROR;
+        slot->connectUs = micros() - slot->startUs;
+    }
+    return true;
+}
+
+void TcpProber::finish(int index, uint8_t state, int error, TcpProbeResult* result) {
+    Slot* slot = &slots[index];
+    result->addr = slot->addr;
+    result->port = slot->port;
+    result->state = state;
+    result->error = error;
+    result->connectUs = slot->connectUs;
+
+    if(state == TCP_PROBE_OPEN) {
+        // Cerrar con RST: nada en TIME_WAIT
+        struct linger abort;
+        abort.l_onoff = 1;
+        abort.l_linger = 0;
+        setsockopt(slot->fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+    }
+    close(slot->fd);
+    slot->fd = -1;
+    inUse--;
+}
+
+bool TcpProber::poll(TcpProbeResult* result, uint32_t waitMs) {
+    unsigned long start = millis();
+
+    while(inUse > 0) {
+        // Resueltas en connect() y vencidas
+        unsigned long now = millis();
+        unsigned long wait = waitMs - min((unsigned long)waitMs, now - start);
+        fd_set writeSet;
+        FD_ZERO(&writeSet);
+        int maxFd = -1;
+        for(int i = 0; i < window; i++) {
+            Slot* slot = &slots[i];
+            if(slot->fd < 0) continue;
+            if(slot->done) {
+                finish(i, slot->state, slot->error, result);
+                return true;
+            }
+            unsigned long age = now - slot->startMs;
+            if(age >= timeoutMs) {
+                slot->connectUs = micros() - slot->startUs;
+                finish(i, TCP_PROBE_TIMEOUT, 0, result);
+                return true;
+            }
+            if(timeoutMs - age < wait) wait = timeoutMs - age;
+            FD_SET(slot->fd, &writeSet);
+            if(slot->fd > maxFd) maxFd = slot->fd;
+        }
+
+        struct timeval tv;
+        tv.tv_sec = wait / 1000;
+        tv.tv_usec = (wait % 1000) * 1000;
+        int ready = select(maxFd + 1, NULL, &writeSet, NULL, &tv);
+        if(ready > 0) {
+            uint32_t nowUs = micros();
+            for(int i = 0; i < window; i++) {
+                Slot* slot = &slots[i];
+                if(slot->fd < 0 || !FD_ISSET(slot->fd, &writeSet)) continue;
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(slot->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                slot->connectUs = nowUs - slot->startUs;
+                if(error == 0) {
+                    finish(i, TCP_PROBE_OPEN, 0, result);
+                } else {
+                    finish(i, error == ECONNREFUSED ? TCP_PROBE_CLOSED : TCP_PROBE_ERROR, error, result);
+                }
+                return true;
+            }
+        }
+        if(ready < 0 && errno != EINTR) {
+            return false;
+        }
+        if(millis() - start >= waitMs) {
+            // Una última vuelta recoge los vencidos
+            now = millis();
+            for(int i = 0; i < window; i++) {
+                if(slots[i].fd >= 0 && now - slots[i].startMs >= timeoutMs) {
+                    slots[i].connectUs = micros() - slots[i].startUs;
+                    finish(i, TCP_PROBE_TIMEOUT, 0, result);
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+    return false;
+}
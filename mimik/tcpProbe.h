@@ -0,0 +1,84 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * tcpProbe.h - Conexiones TCP no bloqueantes en paralelo (tcping, portscan)
+ */
+
+#ifndef TCP_PROBE_H
+#define TCP_PROBE_H
+
+#include <Arduino.h>
+
+// Conexiones simultáneas como máximo. lwIP tiene pocos sockets (el
+// servidor Telnet ya usa hasta 5), así que la ventana es pequeña.
+#define TCP_PROBE_MAX_WINDOW 8
+
+// tcping
+#define TCPING_COUNT 4
+#define TCPING_MAX_COUNT 10000
+#define TCPING_INTERVAL_MS 1000
+#define TCPING_TIMEOUT_MS 2000
+
+// portscan
+#define PORTSCAN_WINDOW 6
+#define PORTSCAN_TIMEOUT_MS 1500
+#define PORTSCAN_MAX_RANGES 16
+
+enum TcpProbeState {
+    TCP_PROBE_OPEN = 0,     // Conexión completada
+    TCP_PROBE_CLOSED,       // RST: el host está, el puerto no
+    TCP_PROBE_TIMEOUT,      // Sin respuesta (filtrado o host caído)
+    TCP_PROBE_ERROR         // Sin ruta, sin sockets...
+};
+
+struct TcpProbeResult {
+    uint32_t addr;          // Orden de red
+    uint16_t port;
+    uint8_t state;
+    int error;              // errno en TCP_PROBE_ERROR
+    uint32_t connectUs;     // Hasta el SYN-ACK (o el RST)
+};
+
+// Abre hasta 'window' connect() no bloqueantes a la vez y entrega cada
+// resultado en cuanto se sabe (select sobre escritura + SO_ERROR). Las
+// conexiones abiertas se cierran con RST (SO_LINGER 0) para no dejar
+// PCBs en TIME_WAIT ocupando la memoria de lwIP. Solo usa la API BSD,
+// así que en un PC se puede probar contra servidores en loopback.
+class TcpProber {
+public:
+    TcpProber(int window, uint32_t timeoutMs);
+    ~TcpProber();
+
+    // false si la ventana está llena o no quedan sockets (reintentar
+    // después de poll)
+    bool start(uint32_t addr, uint16_t port);
+
+    // Espera como mucho waitMs a que termine alguna conexión
+    bool poll(TcpProbeResult* result, uint32_t waitMs);
+
+    int active() const { return inUse; }
+    bool full() const { return inUse >= window; }
+
+    static const char* stateName(uint8_t state);
+
+private:
+    struct Slot {
+        int fd;
+        uint32_t addr;
+        uint16_t port;
+        bool done;              // Ya resuelta en el propio connect()
+        uint8_t state;
+        int error;
+        uint32_t startUs;
+        uint32_t connectUs;
+        unsigned long startMs;
+    };
+
+    Slot slots[TCP_PROBE_MAX_WINDOW];
+    int window;
+    int inUse;
+    uint32_t timeoutMs;
+
+    void finish(int index, uint8_t state, int error, TcpProbeResult* result);
+};
+
+#endif
@@ -0,0 +1,500 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * telnetProtocol.cpp - Implementación de la máquina de estados Telnet
+ */
+
+#include "telnetProtocol.h"
+#include "shellSession.h"
+#include "tracer.h"
+#include "bufferPool.h"
+#include <new>
+
+#define RING_MASK (TELNET_RX_RING - 1)
+
+TelnetProtocol::TelnetProtocol() {
+    client = nullptr;
+    session = nullptr;
+    deflate = nullptr;
+    fillLock = NULL;
+    end();
+}
+
+void TelnetProtocol::begin(WiFiClient* telnetClient, ShellSession* shellSession) {
+    end();
+    if(!fillLock) {
+        fillLock = xSemaphoreCreateMutex();
+    }
+    client = telnetClient;
+    session = shellSession;
+    if(session) session->telnet = this;
+
+    // Modo carácter a carácter con echo del servidor (edición de línea),
+    // tamaño de ventana y compresión. Los clientes que no conocen una
+    // opción responden DONT/WONT y siguen como antes.
+    requestLocal(TELOPT_ECHO, true);
+    requestLocal(TELOPT_SGA, true);
+    requestRemote(TELOPT_NAWS, true);
+    requestLocal(TELOPT_COMPRESS2, true);
+}
+
+void TelnetProtocol::end() {
+    stopCompression();
+    if(session && session->telnet == this) session->telnet = nullptr;
+    client = nullptr;
+    session = nullptr;
+    ringHead = 0;
+    ringTail = 0;
+    scanState = 0;
+    state = STATE_DATA;
+    pending = -1;
+    sbOption = 0;
+    sbLength = 0;
+    memset(options, 0, sizeof(options));
+    lastOut = 0;
+    bytesIn = 0;
+    bytesOut = 0;
+    compressedIn = 0;
+    compressedOut = 0;
+}
+
+// ============================================
+// Negociación de opciones
+// ============================================
+
+bool TelnetProtocol::supportsLocal(uint8_t option) {
+    return option == TELOPT_BINARY || option == TELOPT_ECHO || option == TELOPT_SGA ||
+           option == TELOPT_COMPRESS2;
+}
+
+bool TelnetProtocol::supportsRemote(uint8_t option) {
+    return option == TELOPT_BINARY || option == TELOPT_NAWS || option == TELOPT_SGA;
+}
+
+bool TelnetProtocol::localEnabled(uint8_t option) {
+    return option < TELNET_MAX_OPTION && (options[option] & OPT_LOCAL);
+}
+
+bool TelnetProtocol::remoteEnabled(uint8_t option) {
+    return option < TELNET_MAX_OPTION && (options[option] & OPT_REMOTE);
+}
+
+bool TelnetProtocol::binaryMode() {
+    return localEnabled(TELOPT_BINARY) && remoteEnabled(TELOPT_BINARY);
+}
+
+void TelnetProtocol::requestLocal(uint8_t option, bool enable) {
+    if(option >= TELNET_MAX_OPTION || (options[option] & OPT_LOCAL_PENDING)) return;
+
+    if(enable && !(options[option] & OPT_LOCAL)) {
+        options[option] |= OPT_LOCAL_PENDING;
+        sendCommand(TELNET_WILL, option);
+    } else if(!enable && (options[option] & OPT_LOCAL)) {
+        options[option] &= ~OPT_LOCAL;
+        options[option] |= OPT_LOCAL_PENDING;
+        sendCommand(TELNET_WONT, option);
+    }
+}
+
+void TelnetProtocol::requestRemote(uint8_t option, bool enable) {
+    if(option >= TELNET_MAX_OPTION || (options[option] & OPT_REMOTE_PENDING)) return;
+
+    if(enable && !(options[option] & OPT_REMOTE)) {
+        options[option] |= OPT_REMOTE_PENDING;
+        sendCommand(TELNET_DO, option);
+    } else if(!enable && (options[option] & OPT_REMOTE)) {
+        options[option] &= ~OPT_REMOTE;
+        options[option] |= OPT_REMOTE_PENDING;
+        sendCommand(TELNET_DONT, option);
+    }
+}
+
+// Las respuestas a nuestras propias peticiones (bits *_PENDING) no se
+// contestan, así se evitan los bucles de negociación (RFC 854, 1143).
+void TelnetProtocol::handleNegotiation(uint8_t command, uint8_t option) {
+    if(option >= TELNET_MAX_OPTION) {
+        if(command == TELNET_WILL) sendCommand(TELNET_DONT, option);
+        if(command == TELNET_DO) sendCommand(TELNET_WONT, option);
+        return;
+    }
+
+    uint8_t& opt = options[option];
+
+    switch(command) {
+        case TELNET_WILL:
+            if(opt & OPT_REMOTE) {
+                opt &= ~OPT_REMOTE_PENDING;
+            } else if(opt & OPT_REMOTE_PENDING) {
+                opt |= OPT_REMOTE;
+                opt &= ~OPT_REMOTE_PENDING;
+            } else if(supportsRemote(option)) {
+                opt |= OPT_REMOTE;
+                sendCommand(TELNET_DO, option);
+            } else {
+                sendCommand(TELNET_DONT, option);
+            }
+            break;
+
+        case TELNET_WONT:
+            if(opt & OPT_REMOTE) {
+                opt &= ~OPT_REMOTE;
+                if(!(opt & OPT_REMOTE_PENDING)) sendCommand(TELNET_DONT, option);
+            }
+            opt &= ~OPT_REMOTE_PENDING;
+            break;
+
+        case TELNET_DO:
+            if(opt & OPT_LOCAL) {
+                opt &= ~OPT_LOCAL_PENDING;
+            } else if(opt & OPT_LOCAL_PENDING) {
+                opt |= OPT_LOCAL;
+                opt &= ~OPT_LOCAL_PENDING;
+            } else if(supportsLocal(option)) {
+                opt |= OPT_LOCAL;
+                sendCommand(TELNET_WILL, option);
+            } else {
+                sendCommand(TELNET_WONT, option);
+            }
+            break;
+
+        case TELNET_DONT:
+            if(opt & OPT_LOCAL) {
+                opt &= ~OPT_LOCAL;
+                if(!(opt & OPT_LOCAL_PENDING)) sendCommand(TELNET_WONT, option);
+            }
+            opt &= ~OPT_LOCAL_PENDING;
+            break;
+    }
+
+    // Con WILL ECHO el servidor hace el echo de la entrada
+    if(option == TELOPT_ECHO && session) {
+        session->echo = localEnabled(TELOPT_ECHO);
+    }
+    
+    if(option == TELOPT_COMPRESS2) {
+        if(localEnabled(TELOPT_COMPRESS2)) startCompression();
+        else stopCompression();
+    }
+}
+
+// A partir de IAC SB COMPRESS2 IAC SE todo lo que envía el servidor
+// (incluidos los comandos Telnet) va dentro del flujo zlib.
+void TelnetProtocol::startCompression() {
+    if(deflate || !client) return;
+    
+    // El estado del compresor (~4 KB) va a PSRAM si la hay
+    void* memory = BufferPool::acquire(sizeof(DeflateStream), POOL_PSRAM);
+    DeflateStream* stream = memory ? new (memory) DeflateStream(client)
+                                   : new (std::nothrow) DeflateStream(client);
+    if(!stream) {
+        requestLocal(TELOPT_COMPRESS2, false);
+        return;
+    }
+    
+    uint8_t start[5] = {TELNET_IAC, TELNET_SB, TELOPT_COMPRESS2, TELNET_IAC, TELNET_SE};
+    client->write(start, sizeof(start));
+    bytesOut += sizeof(start);
+    
+    stream->begin();
+    deflate = stream;
+}
+
+void TelnetProtocol::stopCompression() {
+    if(!deflate) return;
+    
+    DeflateStream* stream = deflate;
+    deflate = nullptr;
+    
+    if(client && client->connected()) {
+        stream->finish();
+    }
+    compressedIn += stream->bytesIn;
+    compressedOut += stream->bytesOut;
+    if(BufferPool::owns(stream)) {
+        stream->~DeflateStream();
+        BufferPool::release(stream);
+    } else {
+        delete stream;
+    }
+}
+
+void TelnetProtocol::handleSubnegotiation() {
+    if(sbOption == TELOPT_NAWS && sbLength >= 4 && session) {
+        int cols = (sbBuffer[0] << 8) | sbBuffer[1];
+        int rows = (sbBuffer[2] << 8) | sbBuffer[3];
+        // 0 significa "desconocido" según RFC 1073
+        if(cols > 0) session->termCols = cols;
+        if(rows > 0) session->termRows = rows;
+    }
+}
+
+// Las respuestas de negociación no esperan al próximo prompt: con
+// compresión se vacían ya (la salida de los comandos no, va por write)
+void TelnetProtocol::sendCommand(uint8_t command, uint8_t option) {
+    uint8_t seq[3] = {TELNET_IAC, command, option};
+    sendRaw(seq, sizeof(seq));
+    flush();
+}
+
+void TelnetProtocol::sendRaw(const uint8_t* data, size_t len) {
+    if(!client || !client->connected()) return;
+    
+    if(deflate) {
+        deflate->write(data, len);
+    } else {
+        TraceScope trace("net.send", len);
+        client->write(data, len);
+        bytesOut += len;
+    }
+}
+
+// ============================================
+// Entrada
+// ============================================
+
+// Lectura en bloque del socket al buffer circular. La llaman el worker
+// (al leer) y la tarea Telnet (pollInterrupt) mientras corre un comando.
+size_t TelnetProtocol::fill() {
+    if(!client || !fillLock) return 0;
+
+    xSemaphoreTake(fillLock, portMAX_DELAY);
+    size_t start = ringHead;
+    size_t total = 0;
+    while(ringHead - ringTail < TELNET_RX_RING) {
+        int avail = client->available();
+        if(avail <= 0) break;
+
+        size_t head = ringHead & RING_MASK;
+        size_t space = TELNET_RX_RING - (ringHead - ringTail);
+        size_t contiguous = TELNET_RX_RING - head;
+        size_t len = min(min(space, contiguous), (size_t)avail);
+
+        int n = client->read(ring + head, len);
+        if(n <= 0) break;
+        ringHead += n;
+        bytesIn += n;
+        total += n;
+    }
+    scanInterrupt(start, ringHead);
+    xSemaphoreGive(fillLock);
+    if(total > 0) {
+        TRACE_INSTANT("net.recv", total);
+    }
+    return total;
+}
+
+void TelnetProtocol::pollInterrupt() {
+    fill();
+}
+
+// Busca Ctrl+C o IAC IP/BRK en los bytes recién recibidos, sin
+// decodificarlos (eso lo hace el lector). Se saltan las
+// sub-negociaciones, donde un 3 puede ser parte de NAWS.
+void TelnetProtocol::scanInterrupt(size_t from, size_t to) {
+    enum { SCAN_DATA, SCAN_IAC, SCAN_OPTION, SCAN_SB, SCAN_SB_IAC };
+
+    for(size_t i = from; i != to; i++) {
+        uint8_t b = ring[i & RING_MASK];
+        bool hit = false;
+
+        switch(scanState) {
+            case SCAN_DATA:
+                if(b == TELNET_IAC) scanState = SCAN_IAC;
+                else hit = (b == 3);
+                break;
+            case SCAN_IAC:
+                scanState = SCAN_DATA;
+                if(b == TELNET_IP || b == TELNET_BRK) hit = true;
+                else if(b == TELNET_SB) scanState = SCAN_SB;
+                else if(b >= TELNET_WILL && b <= TELNET_DONT) scanState = SCAN_OPTION;
+                break;
+            case SCAN_OPTION:
+                scanState = SCAN_DATA;
+                break;
+            case SCAN_SB:
+                if(b == TELNET_IAC) scanState = SCAN_SB_IAC;
+                break;
+            case SCAN_SB_IAC:
+                scanState = (b == TELNET_SE) ? SCAN_DATA : SCAN_SB;
+                break;
+        }
+
+        if(hit && session) {
+            session->cancelled = true;
+        }
+    }
+}
+
+// Decodifica un byte recibido. Devuelve el byte de datos o -1
+// si formaba parte de un comando Telnet.
+int TelnetProtocol::decode(uint8_t b) {
+    switch(state) {
+        case STATE_DATA:
+            if(b == TELNET_IAC) {
+                state = STATE_IAC;
+                return -1;
+            }
+            // En NVT, CR va seguido de LF o NUL
+            if(b == '\r' && !remoteEnabled(TELOPT_BINARY)) {
+                state = STATE_CR;
+            }
+            return b;
+
+        case STATE_CR:
+            state = STATE_DATA;
+            if(b == '\n' || b == '\0') return -1;
+            return decode(b);
+
+        case STATE_IAC:
+            state = STATE_DATA;
+            switch(b) {
+                case TELNET_IAC:  return TELNET_IAC;  // 255 literal
+                case TELNET_WILL: state = STATE_WILL; return -1;
+                case TELNET_WONT: state = STATE_WONT; return -1;
+                case TELNET_DO:   state = STATE_DO;   return -1;
+                case TELNET_DONT: state = STATE_DONT; return -1;
+                case TELNET_SB:   state = STATE_SB;   return -1;
+                case TELNET_IP:   return 3;           // Interrupt Process = Ctrl+C
+                case TELNET_BRK:  return 3;
+                case TELNET_EC:   return 8;           // Erase Character
+                case TELNET_EL:   return 21;          // Erase Line = Ctrl+U
+                case TELNET_AYT:
+                    sendRaw((const uint8_t*)"\r\n[mimik: yes]\r\n", 16);
+                    flush();
+                    return -1;
+                default:          return -1;          // NOP, DM, GA, AO
+            }
+
+        case STATE_WILL:
+        case STATE_WONT:
+        case STATE_DO:
+        case STATE_DONT: {
+            uint8_t command = state == STATE_WILL ? TELNET_WILL :
+                              state == STATE_WONT ? TELNET_WONT :
+                              state == STATE_DO ? TELNET_DO : TELNET_DONT;
+            state = STATE_DATA;
+            handleNegotiation(command, b);
+            return -1;
+        }
+
+        case STATE_SB:
+            sbOption = b;
+            sbLength = 0;
+            state = STATE_SB_DATA;
+            return -1;
+
+        case STATE_SB_DATA:
+            if(b == TELNET_IAC) {
+                state = STATE_SB_IAC;
+            } else if(sbLength < TELNET_SB_MAX) {
+                sbBuffer[sbLength++] = b;
+            }
+            return -1;
+
+        case STATE_SB_IAC:
+            if(b == TELNET_SE) {
+                state = STATE_DATA;
+                handleSubnegotiation();
+            } else if(b == TELNET_IAC) {
+                state = STATE_SB_DATA;
+                if(sbLength < TELNET_SB_MAX) sbBuffer[sbLength++] = TELNET_IAC;
+            } else {
+                // Sub-negociación mal formada: descartarla
+                state = STATE_DATA;
+            }
+            return -1;
+    }
+    return -1;
+}
+
+int TelnetProtocol::nextData() {
+    while(true) {
+        if(ringHead == ringTail && fill() == 0) {
+            return -1;
+        }
+        uint8_t b = ring[ringTail & RING_MASK];
+        ringTail++;
+
+        int data = decode(b);
+        if(data >= 0) return data;
+    }
+}
+
+unsigned long TelnetProtocol::zipIn() {
+    return compressedIn + (deflate ? deflate->bytesIn : 0);
+}
+
+unsigned long TelnetProtocol::zipOut() {
+    return compressedOut + (deflate ? deflate->bytesOut : 0);
+}
+
+bool TelnetProtocol::hasInput() {
+    return pending >= 0 || ringHead != ringTail || (client && client->available() > 0);
+}
+
+int TelnetProtocol::available() {
+    if(pending < 0) pending = nextData();
+    return pending >= 0 ? 1 + (int)(ringHead - ringTail) : 0;
+}
+
+int TelnetProtocol::read() {
+    if(pending >= 0) {
+        int data = pending;
+        pending = -1;
+        return data;
+    }
+    return nextData();
+}
+
+int TelnetProtocol::peek() {
+    if(pending < 0) pending = nextData();
+    return pending;
+}
+
+// ============================================
+// Salida
+// ============================================
+
+size_t TelnetProtocol::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t TelnetProtocol::write(const uint8_t* buffer, size_t size) {
+    if(!client || !client->connected()) {
+        return 0;
+    }
+
+    bool binary = localEnabled(TELOPT_BINARY);
+    uint8_t chunk[128];
+    size_t len = 0;
+
+    for(size_t i = 0; i < size; i++) {
+        uint8_t b = buffer[i];
+
+        if(b == TELNET_IAC) {
+            chunk[len++] = TELNET_IAC;
+            chunk[len++] = TELNET_IAC;
+        } else if(b == '\n' && !binary && lastOut != '\r') {
+            chunk[len++] = '\r';
+            chunk[len++] = '\n';
+        } else {
+            chunk[len++] = b;
+        }
+        lastOut = b;
+
+        if(len >= sizeof(chunk) - 2) {
+            sendRaw(chunk, len);
+            len = 0;
+        }
+    }
+    if(len > 0) sendRaw(chunk, len);
+
+    return size;
+}
+
+// Con compresión, hace llegar al cliente todo lo escrito hasta ahora.
+// Se llama en el prompt y en las esperas de comandos largos.
+void TelnetProtocol::flush() {
+    if(deflate && client && client->connected()) {
+        deflate->flush();
+    }
+}
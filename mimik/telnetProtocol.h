@@ -0,0 +1,147 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * telnetProtocol.h - Máquina de estados Telnet (RFC 854/855)
+ */
+
+#ifndef TELNET_PROTOCOL_H
+#define TELNET_PROTOCOL_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <freertos/semphr.h>
+#include "deflateStream.h"
+
+// Tamaño del buffer circular de recepción (potencia de 2)
+#define TELNET_RX_RING 1024
+// Tamaño máximo de una sub-negociación (IAC SB ... IAC SE)
+#define TELNET_SB_MAX 32
+// Opciones con estado propio (códigos < TELNET_MAX_OPTION)
+#define TELNET_MAX_OPTION 90
+
+// Comandos Telnet
+#define TELNET_SE    240
+#define TELNET_NOP   241
+#define TELNET_DM    242
+#define TELNET_BRK   243
+#define TELNET_IP    244
+#define TELNET_AO    245
+#define TELNET_AYT   246
+#define TELNET_EC    247
+#define TELNET_EL    248
+#define TELNET_GA    249
+#define TELNET_SB    250
+#define TELNET_WILL  251
+#define TELNET_WONT  252
+#define TELNET_DO    253
+#define TELNET_DONT  254
+#define TELNET_IAC   255
+
+// Opciones Telnet
+#define TELOPT_BINARY  0
+#define TELOPT_ECHO    1
+#define TELOPT_SGA     3
+#define TELOPT_TTYPE   24
+#define TELOPT_NAWS    31
+#define TELOPT_COMPRESS2 86   // MCCP v2: salida comprimida con zlib
+
+class ShellSession;
+
+// Flujo Telnet de una conexión: la entrada devuelve solo datos de usuario
+// (la negociación se resuelve internamente) y la salida escapa IAC y
+// convierte '\n' en "\r\n" mientras no haya modo binario.
+class TelnetProtocol : public Stream {
+public:
+    TelnetProtocol();
+
+    void begin(WiFiClient* client, ShellSession* session);
+    void end();
+
+    // Negociación de opciones
+    void requestLocal(uint8_t option, bool enable);   // WILL / WONT
+    void requestRemote(uint8_t option, bool enable);  // DO / DONT
+    bool localEnabled(uint8_t option);
+    bool remoteEnabled(uint8_t option);
+    bool binaryMode();
+
+    // Hay datos en el buffer o en el socket
+    bool hasInput();
+
+    // Leer el socket mientras corre un comando, para ver Ctrl+C / IAC IP
+    void pollInterrupt();
+
+    // Compresión de salida (MCCP2)
+    bool compressing() { return deflate != nullptr; }
+    unsigned long zipIn();    // Bytes antes de comprimir
+    unsigned long zipOut();   // Bytes comprimidos enviados al socket
+
+    // Stream
+    int available() override;
+    int read() override;
+    int peek() override;
+
+    // Print
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    void flush() override;
+
+    unsigned long bytesIn;    // Bytes recibidos del socket
+    unsigned long bytesOut;   // Bytes enviados sin comprimir
+
+private:
+    enum State {
+        STATE_DATA,
+        STATE_CR,
+        STATE_IAC,
+        STATE_WILL,
+        STATE_WONT,
+        STATE_DO,
+        STATE_DONT,
+        STATE_SB,
+        STATE_SB_DATA,
+        STATE_SB_IAC
+    };
+
+    // Bits de estado por opción
+    enum {
+        OPT_LOCAL = 0x01,          // Nosotros la tenemos activa (WILL aceptado)
+        OPT_REMOTE = 0x02,         // El cliente la tiene activa (DO aceptado)
+        OPT_LOCAL_PENDING = 0x04,  // Enviamos WILL/WONT y esperamos respuesta
+        OPT_REMOTE_PENDING = 0x08  // Enviamos DO/DONT y esperamos respuesta
+    };
+
+    WiFiClient* client;
+    ShellSession* session;
+    DeflateStream* deflate;
+    unsigned long compressedIn;
+    unsigned long compressedOut;
+
+    uint8_t ring[TELNET_RX_RING];
+    size_t ringHead;
+    size_t ringTail;
+    SemaphoreHandle_t fillLock;    // fill() desde el worker y el watcher
+    uint8_t scanState;             // Búsqueda de interrupciones en bruto
+
+    State state;
+    int pending;               // Siguiente byte de datos ya decodificado
+    uint8_t sbOption;
+    uint8_t sbBuffer[TELNET_SB_MAX];
+    size_t sbLength;
+    uint8_t options[TELNET_MAX_OPTION];
+    uint8_t lastOut;
+
+    size_t fill();
+    void scanInterrupt(size_t from, size_t to);
+    int nextData();
+    int decode(uint8_t b);
+    void handleNegotiation(uint8_t command, uint8_t option);
+    void handleSubnegotiation();
+    bool supportsLocal(uint8_t option);
+    bool supportsRemote(uint8_t option);
+    void sendCommand(uint8_t command, uint8_t option);
+    void sendRaw(const uint8_t* data, size_t len);
+    void startCompression();
+    void stopCompression();
+};
+
+#endif
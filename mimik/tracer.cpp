@@ -0,0 +1,170 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * tracer.cpp - Implementación del trazador de eventos
+ */
+
+#include "tracer.h"
+#include "bufferPool.h"
+
+volatile bool Tracer::active = false;
+TraceEvent* Tracer::rings[portNUM_PROCESSORS] = {nullptr};
+uint32_t Tracer::perCore = 0;
+uint32_t Tracer::heads[portNUM_PROCESSORS] = {0};
+int64_t Tracer::startUs = 0;
+
+bool Tracer::start() {
+    active = false;
+
+    // Los buffers se reservan la primera vez y se reutilizan
+    if(!rings[0]) {
+        uint32_t events = psramFound() ? TRACE_EVENTS_PSRAM : TRACE_EVENTS_RAM;
+        size_t bytes = events * sizeof(TraceEvent);
+        for(int c = 0; c < portNUM_PROCESSORS; c++) {
+            rings[c] = psramFound() ? (TraceEvent*)ps_malloc(bytes) : (TraceEvent*)malloc(bytes);
+            if(!rings[c]) {
+                for(int k = 0; k < c; k++) {
+                    free(rings[k]);
+                    rings[k] = nullptr;
+                }
+                return false;
+            }
+        }
+        perCore = events;
+    }
+
+    for(int c = 0; c < portNUM_PROCESSORS; c++) {
+        heads[c] = 0;
+    }
+    startUs = esp_timer_get_time();
+    active = true;
+    return true;
+}
+
+void Tracer::stop() {
+    active = false;
+}
+
+void Tracer::record(char phase, const char* name, uint32_t arg) {
+    int core = xPortGetCoreID();
+    uint32_t ts = (uint32_t)(esp_timer_get_time() - startUs);
+    uint32_t slot = __atomic_fetch_add(&heads[core], 1, __ATOMIC_RELAXED);
+
+    TraceEvent* event = &rings[core][slot % perCore];
+    event->ts = ts;
+    event->name = name;
+    event->task = xTaskGetCurrentTaskHandle();
+    event->arg = arg;
+    event->phase = phase;
+    event->core = core;
+}
+
+uint32_t Tracer::recorded() {
+    uint32_t n = 0;
+    for(int c = 0; c < portNUM_PROCESSORS; c++) {
+        n += min(heads[c], perCore);
+    }
+    return n;
+}
+
+uint32_t Tracer::overwritten() {
+    uint32_t n = 0;
+    for(int c = 0; c < portNUM_PROCESSORS; c++) {
+        if(heads[c] > perCore) n += heads[c] - perCore;
+    }
+    return n;
+}
+
+// Salida JSON por bloques (buffer del pool) para no escribir evento a
+// evento
+struct TraceWriter {
+    File* file;
+    char* buffer;
+    size_t capacity;
+    size_t length;
+
+    void append(const char* format, ...) {
+        char text[160];
+        va_list ap;
+        va_start(ap, format);
+        int n = vsnprintf(text, sizeof(text), format, ap);
+        va_end(ap);
+        if(n <= 0) return;
+        if(n >= (int)sizeof(text)) n = sizeof(text) - 1;
+        if(length + n > capacity) flush();
+        memcpy(buffer + length, text, n);
+        length += n;
+    }
+
+    void flush() {
+        if(length > 0) file->write((const uint8_t*)buffer, length);
+        length = 0;
+    }
+};
+
+long Tracer::dump(File& file) {
+    if(!rings[0]) {
+        return -1;
+    }
+
+    // Nombres de las tareas vivas; los eventos guardan solo el handle
+    UBaseType_t taskCount = 0;
+    TaskStatus_t* tasks = nullptr;
+#if configUSE_TRACE_FACILITY == 1
+    UBaseType_t maxTasks = uxTaskGetNumberOfTasks() + 4;
+    tasks = (TaskStatus_t*)malloc(maxTasks * sizeof(TaskStatus_t));
+    if(tasks) {
+        taskCount = uxTaskGetSystemState(tasks, maxTasks, NULL);
+    }
+#endif
+
+    TraceWriter out;
+    out.file = &file;
+    out.length = 0;
+    out.buffer = (char*)BufferPool::acquire(TRACE_WRITE_BUFFER, 512, POOL_ANY, &out.capacity);
+    if(!out.buffer) {
+        free(tasks);
+        return -1;
+    }
+    out.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    out.append("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"mimik\"}}");
+    for(UBaseType_t i = 0; i < taskCount; i++) {
+        out.append(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                   (unsigned)(uintptr_t)tasks[i].xHandle, tasks[i].pcTaskName);
+    }
+
+    // Mezclar los buffers de los cores por tiempo
+    uint32_t next[portNUM_PROCESSORS];
+    uint32_t end[portNUM_PROCESSORS];
+    for(int c = 0; c < portNUM_PROCESSORS; c++) {
+        end[c] = heads[c];
+        next[c] = end[c] > perCore ? end[c] - perCore : 0;
+    }
+
+    long written = 0;
+    while(true) {
+        int best = -1;
+        for(int c = 0; c < portNUM_PROCESSORS; c++) {
+            if(next[c] == end[c]) continue;
+            if(best < 0 || rings[c][next[c] % perCore].ts < rings[best][next[best] % perCore].ts) {
+                best = c;
+            }
+        }
+        if(best < 0) break;
+
+        const TraceEvent* e = &rings[best][next[best] % perCore];
+        next[best]++;
+
+        // tid: handle de la tarea (coincide con los metadatos thread_name)
+        out.append(",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%u,\"pid\":1,\"tid\":%u",
+                   e->name, e->phase, (unsigned)e->ts, (unsigned)(uintptr_t)e->task);
+        if(e->phase == 'i') out.append(",\"s\":\"t\"");
+        out.append(",\"args\":{\"core\":%u,\"arg\":%u}}", e->core, (unsigned)e->arg);
+        written++;
+    }
+
+    out.append("\n]}\n");
+    out.flush();
+    BufferPool::release(out.buffer);
+    free(tasks);
+    return written;
+}
@@ -0,0 +1,78 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * tracer.h - Trazas de eventos entre tareas (formato Chrome trace)
+ */
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <FS.h>
+
+// Eventos por core (en PSRAM si la hay; si no, menos)
+#define TRACE_EVENTS_PSRAM 4096
+#define TRACE_EVENTS_RAM 512
+// Buffer de escritura de 'trace dump'
+#define TRACE_WRITE_BUFFER 8192
+
+// Un evento. 'name' apunta siempre a una cadena estática (literal o
+// nombre de la tabla de comandos): no se copia nada al registrar.
+struct TraceEvent {
+    uint32_t ts;            // us desde 'trace start'
+    const char* name;
+    TaskHandle_t task;
+    uint32_t arg;           // bytes, ms... según el evento
+    char phase;             // 'B' inicio, 'E' fin, 'i' instantáneo
+    uint8_t core;
+};
+
+// Un buffer circular por core. Cada evento reserva su hueco con un
+// incremento atómico, sin locks ni secciones críticas; si el buffer se
+// llena se sobrescriben los más antiguos. Con la traza parada el coste
+// de cada punto de traza es leer 'active'.
+class Tracer {
+public:
+    static volatile bool active;
+
+    static bool start();
+    static void stop();
+
+    // Escribe la traza en formato Chrome trace-event JSON (Perfetto,
+    // chrome://tracing). Devuelve el número de eventos escritos o -1.
+    static long dump(File& file);
+
+    static void record(char phase, const char* name, uint32_t arg);
+
+    static uint32_t capacity() { return perCore; }
+    static uint32_t recorded();
+    static uint32_t overwritten();
+
+private:
+    static TraceEvent* rings[portNUM_PROCESSORS];
+    static uint32_t perCore;
+    static uint32_t heads[portNUM_PROCESSORS];
+    static int64_t startUs;
+};
+
+#define TRACE_BEGIN(name, arg)   do { if(Tracer::active) Tracer::record('B', (name), (arg)); } while(0)
+#define TRACE_END(name, arg)     do { if(Tracer::active) Tracer::record('E', (name), (arg)); } while(0)
+#define TRACE_INSTANT(name, arg) do { if(Tracer::active) Tracer::record('i', (name), (arg)); } while(0)
+
+// Span del ámbito actual
+class TraceScope {
+public:
+    TraceScope(const char* spanName, uint32_t arg = 0) : name(spanName) {
+        TRACE_BEGIN(name, arg);
+    }
+    ~TraceScope() {
+        TRACE_END(name, 0);
+    }
+
+private:
+    const char* name;
+};
+
+#endif
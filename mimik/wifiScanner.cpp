@@ -0,0 +1,211 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * wifiScanner.cpp - Implementación del escaneo WiFi en segundo plano
+ */
+
+#include "wifiScanner.h"
+#include "sysLog.h"
+#include <WiFi.h>
+#include <esp_wifi.h>
+
+WifiNetwork WifiScanner::networks[WIFI_SCAN_MAX];
+int WifiScanner::networkCount = 0;
+volatile bool WifiScanner::running = false;
+volatile bool WifiScanner::starting = false;
+bool WifiScanner::harvesting = false;
+uint32_t WifiScanner::startedMs = 0;
+uint32_t WifiScanner::lastScanMs = 0;
+uint8_t WifiScanner::scanChannel = 0;
+bool WifiScanner::scanPassive = false;
+
+static portMUX_TYPE scanLock = portMUX_INITIALIZER_UNLOCKED;
+
+bool WifiScanner::start(uint8_t channel, bool passive) {
+    // 'starting' reserva el escaneo; poll() no lo ve hasta que el driver
+    // lo ha aceptado (WiFi.mode() puede tardar cientos de ms)
+    portENTER_CRITICAL(&scanLock);
+    bool busy = running || starting;
+    if(!busy) starting = true;
+    portEXIT_CRITICAL(&scanLock);
+    if(busy) return true;       // Ya hay uno en marcha: se comparte
+
+    // Escanear necesita la interfaz de estación, pero sin desconectarla
+    wifi_mode_t mode = WiFi.getMode();
+    if(mode == WIFI_OFF) {
+        WiFi.mode(WIFI_STA);
+    } else if(mode == WIFI_AP) {
+        WiFi.mode(WIFI_AP_STA);
+    }
+
+    scanChannel = channel;
+    scanPassive = passive;
+    int16_t result = WiFi.scanNetworks(true, true, passive,
+                                       passive ? WIFI_SCAN_PASSIVE_MS : WIFI_SCAN_ACTIVE_MS,
+                                       channel);
+    portENTER_CRITICAL(&scanLock);
+    starting = false;
+    if(result != WIFI_SCAN_FAILED) {
+        running = true;
+        startedMs = millis();
+    }
+    portEXIT_CRITICAL(&scanLock);
+    if(result == WIFI_SCAN_FAILED) {
+        SysLog::warn("wifi", "Scan could not be started");
+        return false;
+    }
+    SysLog::debug("wifi", "Scan started (channel %u, %s)", channel, passive ? "passive" : "active");
+    return true;
+}
+
+bool WifiScanner::poll() {
+    portENTER_CRITICAL(&scanLock);
+    bool mine = running && !harvesting;
+    if(mine) harvesting = true;
+    portEXIT_CRITICAL(&scanLock);
+    if(!mine) return false;
+
+    int16_t found = WiFi.scanComplete();
+    if(found == WIFI_SCAN_RUNNING && millis() - startedMs < WIFI_SCAN_TIMEOUT_MS) {
+        harvesting = false;
+        return false;
+    }
+
+    bool fresh = found >= 0;
+    if(fresh) {
+        uint32_t now = millis();
+        for(int i = 0; i < found; i++) {
+            // Directamente del registro del driver (WiFi.SSID(i) crea un String)
+            wifi_ap_record_t* record = (wifi_ap_record_t*)WiFi.getScanInfoByIndex(i);
+            if(!record) continue;
+            WifiNetwork network;
+            memcpy(network.ssid, record->ssid, sizeof(network.ssid));
+            network.ssid[sizeof(network.ssid) - 1] = '\0';
+            memcpy(network.bssid, record->bssid, sizeof(network.bssid));
+            network.rssi = record->rssi;
+            network.channel = record->primary;
+            network.auth = record->authmode;
+            network.seenMs = now;
+            merge(&network);
+        }
+        portENTER_CRITICAL(&scanLock);
+        expire(now);
+        lastScanMs = now ? now : 1;
+        portEXIT_CRITICAL(&scanLock);
+        SysLog::debug("wifi", "Scan finished: %d access points", found);
+    } else {
+        SysLog::warn("wifi", "Scan failed or timed out");
+    }
+    WiFi.scanDelete();
+
+    portENTER_CRITICAL(&scanLock);
+    running = false;
+    harvesting = false;
+    portEXIT_CRITICAL(&scanLock);
+    return fresh;
+}
+
+// Actualiza por BSSID o añade; si no cabe, sustituye a la más débil.
+// Mantiene el orden por RSSI.
+void WifiScanner::merge(const WifiNetwork* network) {
+    portENTER_CRITICAL(&scanLock);
+    int slot = -1;
+    for(int i = 0; i < networkCount; i++) {
+        if(memcmp(networks[i].bssid, network->bssid, sizeof(network->bssid)) == 0) {
+            slot = i;
+            break;
+        }
+    }
+    if(slot < 0) {
+        if(networkCount < WIFI_SCAN_MAX) {
+            slot = networkCount++;
+        } else if(network->rssi > networks[networkCount - 1].rssi) {
+            slot = networkCount - 1;
+        }
+    }
+    if(slot >= 0) {
+        networks[slot] = *network;
+        // Subir o bajar hasta su sitio
+        while(slot > 0 && networks[slot].rssi > networks[slot - 1].rssi) {
+            WifiNetwork swap = networks[slot];
+            networks[slot] = networks[slot - 1];
+            networks[--slot] = swap;
+        }
+        while(slot < networkCount - 1 && networks[slot].rssi < networks[slot + 1].rssi) {
+            WifiNetwork swap = networks[slot];
+            networks[slot] = networks[slot + 1];
+            networks[++slot] = swap;
+        }
+    }
+    portEXIT_CRITICAL(&scanLock);
+}
+
+// Con scanLock tomado
+void WifiScanner::expire(uint32_t now) {
+    int kept = 0;
+    for(int i = 0; i < networkCount; i++) {
+        if(now - networks[i].seenMs < WIFI_SCAN_EXPIRE_MS) {
+            if(kept != i) networks[kept] = networks[i];
+            kept++;
+        }
+    }
+    networkCount = kept;
+}
+
+int WifiScanner::count() {
+    return networkCount;
+}
+
+bool WifiScanner::getNetwork(int index, WifiNetwork* out) {
+    portENTER_CRITICAL(&scanLock);
+    bool valid = index >= 0 && index < networkCount;
+    if(valid) *out = networks[index];
+    portEXIT_CRITICAL(&scanLock);
+    return valid;
+}
+
+bool WifiScanner::findBest(const char* ssid, WifiNetwork* out) {
+    uint32_t now = millis();
+    bool found = false;
+    portENTER_CRITICAL(&scanLock);
+    for(int i = 0; i < networkCount; i++) {
+        // La primera que coincide es la más fuerte (orden por RSSI)
+        if(strcmp(networks[i].ssid, ssid) == 0 && now - networks[i].seenMs < WIFI_SCAN_EXPIRE_MS) {
+            *out = networks[i];
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&scanLock);
+    return found;
+}
+
+// WiFi.begin() con BSSID lo deja fijado en la configuración del driver:
+// las reconexiones irían siempre a ese punto de acceso (visto hasta hace
+// 10 min) y nunca a otro de la misma red. Ya conectado se quita.
+void WifiScanner::unpinBssid() {
+    wifi_config_t config;
+    if(esp_wifi_get_config(WIFI_IF_STA, &config) != ESP_OK || !config.sta.bssid_set) {
+        return;
+    }
+    config.sta.bssid_set = false;
+    esp_wifi_set_config(WIFI_IF_STA, &config);
+}
+
+const char* WifiScanner::authName(uint8_t auth) {
+    switch(auth) {
+        case WIFI_AUTH_OPEN:            return "Open";
+        case WIFI_AUTH_WEP:             return "WEP";
+        case WIFI_AUTH_WPA_PSK:         return "WPA-PSK";
+        case WIFI_AUTH_WPA2_PSK:        return "WPA2-PSK";
+        case WIFI_AUTH_WPA_WPA2_PSK:    return "WPA/WPA2-PSK";
+        case WIFI_AUTH_WPA2_ENTERPRISE: return "WPA2-Enterprise";
+        case WIFI_AUTH_WPA3_PSK:        return "WPA3-PSK";
+        case WIFI_AUTH_WPA2_WPA3_PSK:   return "WPA2/WPA3-PSK";
+        default:                        return "Unknown";
+    }
+}
+
+void WifiScanner::formatBssid(const uint8_t* bssid, char* buffer, size_t size) {
+    snprintf(buffer, size, "%02x:%02x:%02x:%02x:%02x:%02x",
+             bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5]);
+}
@@ -0,0 +1,75 @@
+/*
+ * mimik - Mini Shell para ESP32-CAM
+ * wifiScanner.h - Escaneo WiFi en segundo plano con resultados en caché
+ */
+
+#ifndef WIFI_SCANNER_H
+#define WIFI_SCANNER_H
+
+#include <Arduino.h>
+
+#define WIFI_SCAN_MAX 32                // Puntos de acceso recordados
+#define WIFI_SCAN_ACTIVE_MS 120         // Por canal
+#define WIFI_SCAN_PASSIVE_MS 300        // Por canal (hay que oír un beacon)
+#define WIFI_SCAN_TIMEOUT_MS 10000      // Escaneo que no termina: se abandona
+#define WIFI_SCAN_EXPIRE_MS 600000      // Lo no visto en 10 min se olvida
+#define WIFI_SCAN_BOOT_WAIT_MS 4000     // Espera del escaneo de arranque
+
+struct WifiNetwork {
+    char ssid[33];          // "" en las redes ocultas
+    uint8_t bssid[6];
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t auth;           // wifi_auth_mode_t
+    uint32_t seenMs;        // millis() del escaneo que la vio por última vez
+};
+
+// El escaneo se lanza en modo asíncrono sin desconectar la estación:
+// el driver visita cada canal y vuelve al de la conexión entre uno y
+// otro, así que las sesiones Telnet siguen vivas. Quien espera (el
+// comando o la tarea de monitoreo) recoge los resultados con poll() y
+// se mezclan por BSSID con los anteriores, ordenados por RSSI. Así
+// 'wifiscan' responde al instante con lo último conocido y el
+// arranque elige el mejor punto de acceso de la red guardada.
+class WifiScanner {
+public:
+    // channel 0: todos. false si el driver no lo acepta.
+    static bool start(uint8_t channel = 0, bool passive = false);
+    static bool scanning() { return running || starting; }
+
+    // Recoge el escaneo si ha terminado; true si había resultados nuevos
+    static bool poll();
+
+    // Ordenadas de mayor a menor RSSI
+    static int count();
+    static bool getNetwork(int index, WifiNetwork* out);
+    static bool hasResults() { return lastScanMs != 0; }
+    static uint32_t lastScan() { return lastScanMs; }
+    static uint8_t lastChannel() { return scanChannel; }
+    static bool lastPassive() { return scanPassive; }
+
+    // El punto de acceso más fuerte con ese SSID visto recientemente
+    static bool findBest(const char* ssid, WifiNetwork* out);
+
+    // Tras conectar con WiFi.begin(..., bssid): reconectar por SSID
+    static void unpinBssid();
+
+    static const char* authName(uint8_t auth);
+    static void formatBssid(const uint8_t* bssid, char* buffer, size_t size);
+
+private:
+    static WifiNetwork networks[WIFI_SCAN_MAX];
+    static int networkCount;
+    static volatile bool running;
+    static volatile bool starting;
+    static bool harvesting;
+    static uint32_t startedMs;
+    static uint32_t lastScanMs;
+    static uint8_t scanChannel;
+    static bool scanPassive;
+
+    static void merge(const WifiNetwork* network);
+    static void expire(uint32_t now);
+};
+
+#endif